@@ -49,4 +49,67 @@ bool ReadLineFromFile(FILE *fp, char *buffer, unsigned int n, bool add_nl=true){
   return false;
 }
 
+/* batch version of ReadLineFromFile, a line longer than n is not the end of the
+ * input, the rest of it is skipped through to its newline and too_long is set so
+ * the caller can record it as one failed line and carry on. a last line ended 
+ * by a bare '\r' is still returned */
+bool ReadBatchLine(FILE *fp, char *buffer, unsigned int n, bool *too_long){
+  char *end = buffer+n;
+  char *ptr;
+  int ch;
+
+  *too_long = false;
+  ptr = buffer;
+  do {
+    ch = getc_unlocked(fp);
+    if (ch == '\n') {
+      *ptr = '\0';
+      return true;
+    }
+    if (ch == '\f') {
+      *ptr++ = '\n';
+      *ptr = '\0';
+      return true;
+    }
+
+    if (ch == '\r') {
+      *ptr++ = '\n';
+      *ptr = '\0';
+      ch = getc_unlocked(fp);
+      if (ch != '\n' && ch != -1)
+        ungetc(ch,fp);
+      return true;
+    }
+    if (ch == -1) {
+      *ptr++ = '\n';
+      *ptr = '\0';
+      return ptr-buffer > 1;
+    }
+    *ptr++ = ch;
+  } while (ptr < end);
+  *ptr = 0;
+
+  // exactly n characters, the line still fits
+  ch = getc_unlocked(fp);
+  if (ch == '\r') {
+    ch = getc_unlocked(fp);
+    if (ch != '\n' && ch != -1)
+      ungetc(ch,fp);
+    return true;
+  }
+  if (ch == '\n' || ch == '\f' || ch == -1)
+    return true;
+
+  *too_long = true;
+  while (ch != '\n' && ch != '\r' && ch != '\f' && ch != -1)
+    ch = getc_unlocked(fp);
+  
+  if (ch == '\r') {
+    ch = getc_unlocked(fp);
+    if (ch != '\n' && ch != -1)
+      ungetc(ch,fp);
+  }
+  return true;
+}
+
 #endif 
@@ -659,7 +659,38 @@ void BuildWLNFSM2(FSMAutomata *wln, bool charges_on=true){
 // ion charge are chunks
 
 
+#ifdef WLN_DFA_TABLE
+#include "wlndfa_table.h"
+
+/* rebuilds the machine from the tables wlndfagen wrote at build time, sizes
+ * leave room for callers that add their own transitions */
+FSMAutomata * LoadWLNDFA(unsigned int node_size, unsigned int edge_size){
+  if(node_size < WLN_DFA_STATES)
+    node_size = WLN_DFA_STATES;
+  if(edge_size < WLN_DFA_EDGES)
+    edge_size = WLN_DFA_EDGES;
+
+  FSMAutomata *wln = new FSMAutomata(node_size,edge_size);
+  for(unsigned int i=0;i<WLN_DFA_STATES;i++)
+    wln->AddState(wln_dfa_accept[i]);
+
+  for(unsigned int i=0;i<WLN_DFA_EDGES;i++){
+    const WLNDFAEdge &e = wln_dfa_edges[i];
+    wln->AddTransition(wln->states[e.from],wln->states[e.to],e.ch);
+  }
+
+  wln->type = DFA;
+  wln->InitJumpTable();
+  return wln;
+}
+#endif
+
 FSMAutomata * CreateWLNDFA(unsigned int node_size, unsigned int edge_size, bool charges_on=true){
+#ifdef WLN_DFA_TABLE
+  if(charges_on)
+    return LoadWLNDFA(node_size,edge_size);
+#endif
+
   FSMAutomata *wln = new FSMAutomata(node_size,edge_size);
   FSMAutomata *wlnDFA = 0;
   FSMAutomata *wlnMinimal = 0;
@@ -0,0 +1,126 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "rfsm.h"
+#include "wlndfa.h"
+
+/* build step, minimises the wln machine once and writes it out as constexpr tables
+ * so wlngrep, wlnzip and the reader never rebuild it at runtime */
+
+#define DFA_COLUMNS 128
+
+const char *filename;
+
+static void DisplayUsage()
+{
+  fprintf(stderr, "usage: wlndfagen <header>\n");
+  fprintf(stderr, "writes the minimal wln dfa as a c++ header\n");
+  exit(1);
+}
+
+static void ProcessCommandLine(int argc, char *argv[])
+{
+  filename = (const char *)0;
+  if(argc != 2 || argv[1][0] == '-')
+    DisplayUsage();
+
+  filename = argv[1];
+  return;
+}
+
+static bool WriteTables(FILE *fp, FSMAutomata *dfa)
+{
+  if(dfa->root != dfa->states[0]){
+    fprintf(stderr,"Error: dfa root is not state zero\n");
+    return false;
+  }
+
+  unsigned int edges = 0;
+  for(unsigned int i=0;i<dfa->num_states;i++){
+    for(FSMEdge *e=dfa->states[i]->transitions;e;e=e->nxt){
+      if(e->ch >= DFA_COLUMNS){
+        fprintf(stderr,"Error: transition on %d is outside the table\n",e->ch);
+        return false;
+      }
+      edges++;
+    }
+  }
+
+  fprintf(fp,"/* generated by wlndfagen from the machine in wlndfa.h, do not edit */\n\n");
+  fprintf(fp,"#ifndef WLN_DFA_TABLE_H\n");
+  fprintf(fp,"#define WLN_DFA_TABLE_H\n\n");
+  fprintf(fp,"#define WLN_DFA_STATES %u\n",dfa->num_states);
+  fprintf(fp,"#define WLN_DFA_EDGES %u\n",edges);
+  fprintf(fp,"#define WLN_DFA_COLUMNS %u\n",DFA_COLUMNS);
+  fprintf(fp,"#define WLN_DFA_DEAD 0xFFFF\n\n");
+
+  fprintf(fp,"struct WLNDFAEdge{\n");
+  fprintf(fp,"  unsigned short from;\n");
+  fprintf(fp,"  unsigned short to;\n");
+  fprintf(fp,"  unsigned char ch;\n");
+  fprintf(fp,"};\n\n");
+
+  fprintf(fp,"// accept flag per state, the root is state 0\n");
+  fprintf(fp,"static constexpr unsigned char wln_dfa_accept[WLN_DFA_STATES] = {");
+  for(unsigned int i=0;i<dfa->num_states;i++)
+    fprintf(fp,"%s%d",i % 32 ? ",":(i ? ",\n  ":"\n  "),dfa->states[i]->accept ? 1:0);
+  fprintf(fp,"\n};\n\n");
+
+  fprintf(fp,"// transitions in machine order, adding them back in order rebuilds the same automaton\n");
+  fprintf(fp,"static constexpr WLNDFAEdge wln_dfa_edges[WLN_DFA_EDGES] = {");
+  unsigned int n = 0;
+  for(unsigned int i=0;i<dfa->num_states;i++){
+    for(FSMEdge *e=dfa->states[i]->transitions;e;e=e->nxt)
+      fprintf(fp,"%s{%u,%u,%u}",n++ % 8 ? ",":(n>1 ? ",\n  ":"\n  "),i,e->dwn->id,e->ch);
+  }
+  fprintf(fp,"\n};\n\n");
+
+  fprintf(fp,"// dense next state table for matching, WLN_DFA_DEAD where there is no transition\n");
+  fprintf(fp,"static constexpr unsigned short wln_dfa_next[WLN_DFA_STATES][WLN_DFA_COLUMNS] = {\n");
+  for(unsigned int i=0;i<dfa->num_states;i++){
+    unsigned int next[DFA_COLUMNS];
+    for(unsigned int c=0;c<DFA_COLUMNS;c++)
+      next[c] = 0xFFFF;
+    for(FSMEdge *e=dfa->states[i]->transitions;e;e=e->nxt)
+      next[e->ch] = e->dwn->id;
+
+    fprintf(fp,"  {");
+    for(unsigned int c=0;c<DFA_COLUMNS;c++)
+      fprintf(fp,"%s%u",c ? ",":"",next[c]);
+    fprintf(fp,"}%s\n",i+1 < dfa->num_states ? ",":"");
+  }
+  fprintf(fp,"};\n\n");
+
+  fprintf(fp,"#endif\n");
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  ProcessCommandLine(argc,argv);
+
+  FSMAutomata *fsm = CreateWLNDFA(REASONABLE,REASONABLE);
+  if(!fsm || fsm->type != DFA){
+    fprintf(stderr,"Error: could not build the wln dfa\n");
+    return 1;
+  }
+
+  fsm->Reindex();
+
+  FILE *fp = fopen(filename,"w");
+  if(!fp){
+    fprintf(stderr,"Error: unable to open file at: %s\n",filename);
+    delete fsm;
+    return 1;
+  }
+
+  bool ok = WriteTables(fp,fsm);
+  fclose(fp);
+  if(!ok)
+    remove(filename);
+
+  delete fsm;
+  return ok ? 0:1;
+}
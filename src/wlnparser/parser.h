@@ -17,9 +17,75 @@ using namespace OpenBabel;
 
 #define MODERN 0
 #define OPT_DEBUG 0
+#ifndef WLN_STATS
+#define WLN_STATS 1 // 0 compiles the --stats timers out of the reader
+#endif
+
+// stage a string failed at in ValidateWLN
+enum WLNStatus{
+  WLN_VALID = 0,
+  WLN_PARSE_ERROR,
+  WLN_KEKULE_ERROR,
+  WLN_EXPAND_ERROR
+};
+
+// reader stages timed by --stats
+enum WLNStage{
+  WLN_STAGE_PARSE = 0,
+  WLN_STAGE_KEKULIZE,
+  WLN_STAGE_EXPAND,
+  WLN_STAGE_CONVERT,  // babel molecule, native smiles or hash
+  WLN_STAGE_SANITIZE,
+  WLN_STAGES
+};
+
+struct WLNValidation{
+  WLNStatus status;
+  unsigned int error_pos;   // character offset into the input
+  const char *error_msg;    // static string, never freed
+};
+
+// part of the writer a molecule failed in
+enum WLNWriteStage{
+  WLN_WRITE_STAGE_NONE = 0,
+  WLN_WRITE_STAGE_CHAIN,   // acyclic atoms and branches
+  WLN_WRITE_STAGE_RING,    // local sssr, locant path and ring atoms
+  WLN_WRITE_STAGE_LOCANT,  // locant lookup and writing
+  WLN_WRITE_STAGE_METAL    // pi bonded organometallics
+};
+
+// why WriteWLN failed
+enum WLNWriteCode{
+  WLN_WRITE_NONE = 0,
+  WLN_WRITE_DEAD_ATOM,      // null atom reached during the walk
+  WLN_WRITE_NOT_IN_PATH,    // ring atom missing from the locant path
+  WLN_WRITE_BROKEN_LOCANT,  // off path locant that cannot be written
+  WLN_WRITE_NO_SSSR,        // local ring set could not be built
+  WLN_WRITE_NO_PATH,        // no locant path for the ring system
+  WLN_WRITE_ELEMENT,        // atom with no wln symbol
+  WLN_WRITE_BRANCH,         // a nested chain or ring failed
+  WLN_WRITE_CHARGE          // charges do not balance the pi bonds
+};
+
+struct WLNWriteError{
+  WLNWriteStage stage;
+  WLNWriteCode code;
+  const char *error_msg;    // static string, never freed
+};
 
 bool ReadWLN(const char *ptr, OBMol* mol);
-bool WriteWLN(std::string &buffer, OBMol* mol, bool modern);
-bool NMReadWLN(const char *ptr, OpenBabel::OBMol* mol);
+bool WriteWLN(std::string &buffer, OBMol* mol, bool modern, WLNWriteError *error = 0);
+void WLNPathSearchStats(unsigned long *seeds, unsigned long *steps, unsigned long *scored, unsigned long *pruned);
+void WLNPathBound(bool on);
+bool NMReadWLN(const char *ptr, OpenBabel::OBMol* mol, unsigned int *error_pos = 0);
+unsigned int NMReadWLNBatch(const std::vector<std::string> &lines, OBConversion &conv, std::string &out, const char *fail_record);
 bool CanonicaliseWLN(const char *ptr, OBMol* mol);
+bool CanonicalWLN(const char *ptr, std::string &buffer);
+bool WLNToSmiles(const char *ptr, std::string &buffer);
+bool ValidateWLN(const char *ptr, WLNValidation *result);
+bool WLNGraphHash(const char *ptr, unsigned long long *hash);
+bool WLNSyntaxCheck(const char *ptr, unsigned int *pos);
+void WLNRingCacheStats(unsigned long *hits, unsigned long *misses, unsigned int *size);
+void WLNStatsEnable(bool on);
+void WLNStatsReport(FILE *fp);
 #endif 
@@ -4,6 +4,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_set>
+#include <unordered_map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
 #include "parser.h"
 
 #include <openbabel/mol.h>
@@ -18,18 +29,45 @@
 #include <openbabel/obmolecformat.h>
 #include <openbabel/graphsym.h>
 
+#include "read_file.h"
+
+#define BATCH_LINE_MAX 4096
+#define BATCH_ERROR "*error*"
+#define BATCH_CHUNK 512     // lines handed to a worker at a time
+#define BATCH_INFLIGHT 4    // chunks held per worker before the reader blocks
+
 const char *cli_inp;
+const char *file_inp;
 const char *format; 
 bool opt_old = false;
+bool opt_native = false;
+bool opt_unique = false;
+bool opt_stats = false;
+bool opt_syntax = false;
+unsigned int opt_check = 0; // check every nth hash against inchikey, 0 is off
+unsigned int opt_column = 1; // tab separated column holding the wln string
+unsigned int opt_threads = 1; 
 
 static void DisplayUsage()
 {
   fprintf(stderr, "readwln <options> -o<format> <input (escaped)>\n");
+  fprintf(stderr, "readwln <options> -o<format> -f <file>|-\n");
   fprintf(stderr, "<options>\n");
   fprintf(stderr, " -h                   show the help for executable usage\n");
-  fprintf(stderr, " -o                   choose output format (-osmi, -oinchi, -okey, -ocan, -owln *)\n");
+  fprintf(stderr, " -o                   choose output format (-osmi, -oinchi, -okey, -ocan, -owln *, -ovalid **, -ohash ***)\n");
   fprintf(stderr, "                      * selecting -owln will return the shortest possible wln string\n");
+  fprintf(stderr, "                      ** selecting -ovalid only checks the string, no molecule is built\n");
+  fprintf(stderr, "                      *** selecting -ohash writes a 128 bit molecule hash, no molecule is built\n");
+  fprintf(stderr, " -f <file>            read newline delimited wln from file, one output record per line\n");
+  fprintf(stderr, " -                    read newline delimited wln from stdin\n");
+  fprintf(stderr, " -c <n>               take the wln string from tab separated column n (default 1)\n");
+  fprintf(stderr, " -j <n>               convert a file on n worker threads, output keeps the input order\n");
   fprintf(stderr, " --old                use the old wln parser (nextmove software)\n");
+  fprintf(stderr, " --native             write -osmi straight from the wln graph, skips babel (non-canonical)\n");
+  fprintf(stderr, " --unique             with -owln and a file, only write the first of each canonical form\n");
+  fprintf(stderr, " --check <n>          with -ohash and a file, compare every nth hash against its inchikey\n");
+  fprintf(stderr, " --stats              report per stage timings, graph sizes and kekule matchers on stderr\n");
+  fprintf(stderr, " --syntax             fail strings the wlngrep machine rejects before parsing them\n");
   exit(1);
 }
 
@@ -51,6 +89,7 @@ static void ProcessCommandLine(int argc, char *argv[])
   unsigned int j = 0;
 
   cli_inp = (const char *)0;
+  file_inp = (const char *)0;
   format = (const char *)0;
 
   if (argc < 2)
@@ -61,6 +100,11 @@ static void ProcessCommandLine(int argc, char *argv[])
 
     ptr = argv[i];
 
+    if (ptr[0] == '-' && !ptr[1]){
+      file_inp = ptr; // stdin
+      continue;
+    }
+
     if (ptr[0] == '-' && ptr[1]){
 
       if(ptr[1] >= 'A' && ptr[1] <= 'Z' && !j){
@@ -75,6 +119,30 @@ static void ProcessCommandLine(int argc, char *argv[])
         case 'h':
           DisplayHelp();
 
+        case 'f':
+          if(i+1 >= argc){
+            fprintf(stderr,"Error: -f requires a file path\n");
+            DisplayUsage();
+          }
+          file_inp = argv[++i];
+          break;
+
+        case 'c':
+          if(i+1 >= argc || atoi(argv[i+1]) < 1){
+            fprintf(stderr,"Error: -c requires a column number > 0\n");
+            DisplayUsage();
+          }
+          opt_column = atoi(argv[++i]);
+          break;
+
+        case 'j':
+          if(i+1 >= argc || atoi(argv[i+1]) < 1){
+            fprintf(stderr,"Error: -j requires a thread count > 0\n");
+            DisplayUsage();
+          }
+          opt_threads = atoi(argv[++i]);
+          break;
+
         case 'o':
           if (!strcmp(ptr, "-osmi"))
           {
@@ -101,8 +169,18 @@ static void ProcessCommandLine(int argc, char *argv[])
             format  = "WLN";
             break;
           }
+          else if(!strcmp(ptr,"-ovalid"))
+          {
+            format  = "valid";
+            break;
+          }
+          else if(!strcmp(ptr,"-ohash"))
+          {
+            format  = "hash";
+            break;
+          }
           else{
-            fprintf(stderr,"Error: unrecognised format, choose between ['smi','inchi','can','key','wln']\n");
+            fprintf(stderr,"Error: unrecognised format, choose between ['smi','inchi','can','key','wln','valid','hash']\n");
             DisplayUsage();
           } 
         
@@ -111,6 +189,30 @@ static void ProcessCommandLine(int argc, char *argv[])
             opt_old = true;
             break;
           }
+          if(!strcmp(ptr, "--native")){
+            opt_native = true;
+            break;
+          }
+          if(!strcmp(ptr, "--unique")){
+            opt_unique = true;
+            break;
+          }
+          if(!strcmp(ptr, "--stats")){
+            opt_stats = true;
+            break;
+          }
+          if(!strcmp(ptr, "--syntax")){
+            opt_syntax = true;
+            break;
+          }
+          if(!strcmp(ptr, "--check")){
+            if(i+1 >= argc || atoi(argv[i+1]) < 1){
+              fprintf(stderr,"Error: --check requires a sample interval > 0\n");
+              DisplayUsage();
+            }
+            opt_check = atoi(argv[++i]);
+            break;
+          }
           
 
         default:
@@ -139,38 +241,584 @@ static void ProcessCommandLine(int argc, char *argv[])
     DisplayUsage();
   }
 
-  if(!cli_inp){
+  if(!cli_inp && !file_inp){
     fprintf(stderr,"Error: no input string entered\n");
     DisplayUsage();
   }
 
+  if(cli_inp && file_inp){
+    fprintf(stderr,"Error: choose either an input string or an input file\n");
+    DisplayUsage();
+  }
+
+  if(opt_threads > 1 && !file_inp){
+    fprintf(stderr,"Error: -j can only be used with file input\n");
+    DisplayUsage();
+  }
+
+  if(opt_old && (!strcmp(format,"valid") || !strcmp(format,"hash"))){
+    fprintf(stderr,"Error: -ovalid and -ohash use the new parser only\n");
+    DisplayUsage();
+  }
+
+  if(opt_check && (strcmp(format,"hash") || !file_inp || opt_threads > 1)){
+    fprintf(stderr,"Error: --check samples -ohash from a file on a single thread\n");
+    DisplayUsage();
+  }
+
+  if(opt_native && (strcmp(format,"smi") || opt_old)){
+    fprintf(stderr,"Error: --native only writes smiles (-osmi) from the new parser\n");
+    DisplayUsage();
+  }
+
+  if(opt_unique && (strcmp(format,"WLN") || !file_inp)){
+    fprintf(stderr,"Error: --unique deduplicates canonical wln (-owln) from a file\n");
+    DisplayUsage();
+  }
+
+  if(opt_stats && (opt_old || !strcmp(format,"valid"))){
+    fprintf(stderr,"Error: --stats times the new parser's conversions, not --old or -ovalid\n");
+    DisplayUsage();
+  }
+
+#ifndef WLN_DFA_TABLE
+  if(opt_syntax){
+    fprintf(stderr,"Error: --syntax needs the generated dfa table, build readwln through cmake\n");
+    DisplayUsage();
+  }
+#endif
+
   return;
 }
 
-int main(int argc, char *argv[])
+/* one record per string, "valid" or "invalid", the failing stage, the character 
+ * offset and the error message, tab separated */
+static bool AppendValidation(const char *wln, std::string &out)
 {
-  ProcessCommandLine(argc, argv);
+  static const char *stages[] = {"valid","parse","kekulize","expand"};
   
-  std::string res;
-  OBMol mol;
+  unsigned int pos = 0;
+  if(opt_syntax && !WLNSyntaxCheck(wln,&pos)){
+    char record[32];
+    snprintf(record,32,"\t%u\t",pos);
+    out += "invalid\tsyntax";
+    out += record;
+    out += "Error: rejected by the wln syntax machine\n";
+    return false;
+  }
+
+  WLNValidation result;
+  if(ValidateWLN(wln,&result)){
+    out += "valid\n";
+    return true;
+  }
+
+  char record[32];
+  snprintf(record,32,"\t%u\t",result.error_pos);
+  out += "invalid\t";
+  out += stages[result.status];
+  out += record;
+  out.append(result.error_msg,strcspn(result.error_msg,"\n")); // one line per record
+  out += '\n';
+  return false;
+}
+
+/* converts a single wln string into the selected format and appends it to out, 
+ * mol and conv are owned by the caller so they can be reused between lines. on 
+ * failure out is left as it was, except -ovalid which appends its invalid record */
+static bool ConvertWLN(const char *wln, OBMol *mol, OBConversion &conv, std::string &out)
+{
+  if(!strcmp(format,"valid"))
+    return AppendValidation(wln,out);
+
+  unsigned int pos = 0;
+  if(opt_syntax && !WLNSyntaxCheck(wln,&pos))
+    return false;
+
+  if(!strcmp(format,"hash")){
+    unsigned long long hash[2];
+    if(!WLNGraphHash(wln,hash))
+      return false;
+
+    char record[40];
+    snprintf(record,40,"%016llx%016llx\n",hash[0],hash[1]);
+    out += record;
+    return true;
+  }
+
+  if(opt_native){
+    size_t start = out.size();
+    if(!WLNToSmiles(wln,out)){
+      out.resize(start); // drop any partial smiles
+      return false;
+    }
+    out += '\n';
+    return true;
+  }
 
   if(opt_old){
-    if(!NMReadWLN(cli_inp,&mol))
-      return 1;
+    if(!NMReadWLN(wln,mol,file_inp ? &pos:0)) // quiet over files
+      return false;
   }
   else if(!strcmp(format, "WLN")){
-    if(!CanonicaliseWLN(cli_inp,&mol))
-      return 1;
+    size_t start = out.size();
+    if(!CanonicalWLN(wln,out)){
+      out.resize(start);
+      return false;
+    }
+    out += '\n';
+    return true;
   }
-  else{
-    if(!ReadWLN(cli_inp,&mol))
-      return 1;
+  else if(!ReadWLN(wln,mol))
+    return false;
+  
+  out += conv.WriteString(mol);
+  return true;
+}
+
+/* --unique, passes the first record of each canonical form, error records
+ * are never treated as duplicates */
+struct UniqueFilter{
+  std::unordered_set<std::string> seen; 
+  unsigned int duplicates;
+
+  UniqueFilter(){
+    duplicates = 0;
+  }
+
+  bool Admit(const std::string &record){
+    if(seen.insert(record).second)
+      return true;
+    duplicates++;
+    return false;
+  }
+
+  // filters a block of newline terminated records straight onto stdout
+  void Write(const std::string &block){
+    size_t pos = 0;
+    while(pos < block.size()){
+      size_t end = block.find('\n',pos);
+      end = (end == std::string::npos) ? block.size() : end+1;
+
+      std::string record = block.substr(pos,end-pos);
+      if(!record.compare(0,strlen(BATCH_ERROR),BATCH_ERROR) || Admit(record))
+        std::cout << record;
+      pos = end;
+    }
+  }
+
+  void Report(){
+    fprintf(stderr,"  unique: %u canonical forms, %u duplicates dropped\n",(unsigned int)seen.size(),duplicates);
+  }
+};
+
+/* --check, samples hashes against babels inchikey. a collision is one hash for 
+ * two keys, a split is one key for two hashes, mobile hydrogens and anything 
+ * else inchi normalises away will show as splits */
+struct HashCheck{
+  std::unordered_map<std::string,std::pair<std::string,std::string>> by_hash; // hash -> key, wln
+  std::unordered_map<std::string,std::pair<std::string,std::string>> by_key;  // key -> hash, wln
+  OBConversion conv;
+  unsigned int sampled;
+  unsigned int failed;
+  unsigned int collisions;
+  unsigned int splits;
+
+  HashCheck(){
+    sampled = failed = collisions = splits = 0;
+    conv.SetOutFormat("inchikey");
+  }
+
+  void Example(const char *kind, const std::string &a, const std::string &b, unsigned int count){
+    if(count <= 10)
+      fprintf(stderr,"  %s: %s | %s\n",kind,a.c_str(),b.c_str());
+  }
+
+  void Sample(const char *wln, const std::string &record, OBMol *mol){
+    mol->Clear();
+    if(!ReadWLN(wln,mol)){
+      failed++;
+      return;
+    }
+
+    std::string key = conv.WriteString(mol);
+    std::string hash = record;
+    while(!key.empty() && (key.back() == '\n' || key.back() == '\r'))
+      key.pop_back();
+    while(!hash.empty() && hash.back() == '\n')
+      hash.pop_back();
+    sampled++;
+
+    std::pair<std::string,std::string> &seen_key = by_hash.insert(std::make_pair(hash,std::make_pair(key,std::string(wln)))).first->second;
+    if(seen_key.first != key)
+      Example("collision",seen_key.second,wln,++collisions);
+
+    std::pair<std::string,std::string> &seen_hash = by_key.insert(std::make_pair(key,std::make_pair(hash,std::string(wln)))).first->second;
+    if(seen_hash.first != hash)
+      Example("split",seen_hash.second,wln,++splits);
+  }
+
+  void Report(){
+    fprintf(stderr,"  hash check: %u sampled, %u failed, %u collisions, %u splits\n",sampled,failed,collisions,splits);
+  }
+};
+
+/* moves the buffer onto the selected tab separated column, 
+ * returns null if the line does not have enough columns */
+static char *SelectColumn(char *buffer, unsigned int column)
+{
+  char *ptr = buffer;
+  for(unsigned int c=1;c<column;c++){
+    ptr = strchr(ptr,'\t');
+    if(!ptr)
+      return 0;
+    ptr++;
+  }
+
+  char *end = strchr(ptr,'\t');
+  if(end)
+    *end = '\0';
+  
+  end = ptr + strlen(ptr);
+  while(end > ptr && (end[-1] == '\n' || end[-1] == '\r'))
+    *(--end) = '\0';
+  return ptr;
+}
+
+/* ring blocks are cached across the whole run, report how well that went */
+static void ReportRingCache()
+{
+  unsigned long hits = 0;
+  unsigned long misses = 0;
+  unsigned int size = 0;
+  WLNRingCacheStats(&hits,&misses,&size);
+  fprintf(stderr,"  ring cache: %lu hits, %lu misses, %u templates\n",hits,misses,size);
+}
+
+/* streams a file of wln strings, babel plugins and the conversion object are 
+ * set up once, a failed line writes an error record rather than stopping */
+static bool ConvertFile(FILE *fp)
+{
+  unsigned int lines = 0;
+  unsigned int failed = 0;
+
+  char *buffer = (char*)malloc(sizeof(char) * BATCH_LINE_MAX+1);
+  memset(buffer,0,BATCH_LINE_MAX+1);
+
+  OBMol mol;
+  OBConversion conv;
+  conv.AddOption("h",OBConversion::OUTOPTIONS);
+  conv.SetOutFormat(format);
+
+  UniqueFilter unique;
+  HashCheck *check = opt_check ? new HashCheck : 0;
+  std::string out; 
+  bool too_long = false;
+  while(ReadBatchLine(fp,buffer,BATCH_LINE_MAX,&too_long)){
+    lines++;
+    mol.Clear();
+    out.clear();
+
+    if(too_long){
+      fprintf(stderr,"Warning: line %d is over %d characters, skipped\n",lines,BATCH_LINE_MAX);
+      std::cout << BATCH_ERROR << '\n';
+      failed++;
+      continue;
+    }
+
+    const char *wln = SelectColumn(buffer,opt_column);
+    if(!wln || !*wln || !ConvertWLN(wln,&mol,conv,out)){
+      if(out.empty())
+        std::cout << BATCH_ERROR << '\n';
+      else
+        std::cout << out; // -ovalid invalid record
+      failed++;
+      continue;
+    }
+    else if(!opt_unique || unique.Admit(out))
+      std::cout << out; 
+
+    if(check && lines % opt_check == 0)
+      check->Sample(wln,out,&mol);
+  }
+
+  std::cout.flush();
+  fprintf(stderr,"%d lines parsed, %d failed\n",lines,failed);
+  if(opt_unique)
+    unique.Report();
+  if(check){
+    check->Report();
+    delete check;
+  }
+  if(!opt_old)
+    ReportRingCache();
+  if(opt_stats)
+    WLNStatsReport(stderr);
+  free(buffer);
+  return true;
+}
+
+/**********************************************************************
+                         Threaded Batch Engine
+**********************************************************************/
+
+/* a block of consecutive input lines, converted as one unit of work */
+struct BatchChunk{
+  unsigned int id;
+  unsigned int failed;
+  std::vector<std::string> lines;
+  std::string out; 
+};
+
+struct WorkerStats{
+  unsigned int lines;
+  double seconds;  // time spent converting, excludes waiting on the queues
+};
+
+/* reader -> workers -> writer pipeline, the reader blocks once too many chunks
+ * are in flight so memory stays bounded regardless of file size */
+struct BatchEngine{
+  std::mutex lock;
+  std::condition_variable work_ready;
+  std::condition_variable done_ready;
+  std::condition_variable space_ready;
+
+  std::deque<BatchChunk*> work;
+  std::map<unsigned int,BatchChunk*> done; // reorder buffer, keyed on chunk id
+  
+  unsigned int in_flight;
+  unsigned int max_in_flight; 
+  unsigned int total_chunks;  // only valid once finished_reading is set
+  bool finished_reading;
+
+  std::vector<WorkerStats> stats;
+  UniqueFilter unique; // only touched by the writer
+
+  BatchEngine(unsigned int threads){
+    in_flight = 0;
+    max_in_flight = threads * BATCH_INFLIGHT;
+    total_chunks = 0;
+    finished_reading = false;
+    stats.resize(threads);
+  }
+
+  void Submit(BatchChunk *chunk){
+    std::unique_lock<std::mutex> guard(lock);
+    space_ready.wait(guard,[this]{return in_flight < max_in_flight;});
+    in_flight++;
+    work.push_back(chunk);
+    work_ready.notify_one();
+  }
+
+  void Close(unsigned int chunks){
+    std::lock_guard<std::mutex> guard(lock);
+    total_chunks = chunks;
+    finished_reading = true;
+    work_ready.notify_all();
+    done_ready.notify_one();
+  }
+
+  /* each worker owns its own babel objects, nothing is shared between threads */
+  void Worker(unsigned int w){
+    OBMol mol;
     OBConversion conv;
     conv.AddOption("h",OBConversion::OUTOPTIONS);
     conv.SetOutFormat(format);
 
-    res = conv.WriteString(&mol);
-    std::cout << res;
+    for(;;){
+      BatchChunk *chunk = 0; 
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        work_ready.wait(guard,[this]{return !work.empty() || finished_reading;});
+        if(work.empty())
+          return;
+        chunk = work.front();
+        work.pop_front();
+      }
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      if(opt_old && !opt_syntax)
+        chunk->failed += NMReadWLNBatch(chunk->lines,conv,chunk->out,BATCH_ERROR);
+      else{
+        for(unsigned int i=0;i<chunk->lines.size();i++){
+          mol.Clear();
+          const char *wln = chunk->lines[i].c_str();
+          size_t start = chunk->out.size();
+          if(!*wln || !ConvertWLN(wln,&mol,conv,chunk->out)){
+            if(chunk->out.size() == start){ // -ovalid writes its own invalid record
+              chunk->out += BATCH_ERROR;
+              chunk->out += '\n';
+            }
+            chunk->failed++;
+          }
+        }
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      std::lock_guard<std::mutex> guard(lock);
+      stats[w].lines += chunk->lines.size();
+      stats[w].seconds += elapsed.count();
+      done[chunk->id] = chunk;
+      done_ready.notify_one();
+    }
+  }
+
+  /* writes chunks strictly in input order, returns the failed line count */
+  unsigned int Writer(){
+    unsigned int next = 0;
+    unsigned int failed = 0;
+    for(;;){
+      BatchChunk *chunk = 0;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        done_ready.wait(guard,[this,next]{
+          return done.count(next) || (finished_reading && next == total_chunks);
+        });
+        if(!done.count(next))
+          return failed;
+        chunk = done[next];
+        done.erase(next);
+        in_flight--;
+        space_ready.notify_one();
+      }
+
+      if(opt_unique)
+        unique.Write(chunk->out);
+      else
+        std::cout << chunk->out;
+      failed += chunk->failed;
+      delete chunk;
+      next++;
+    }
+  }
+};
+
+/* threaded version of ConvertFile, lines are chunked onto a worker pool and 
+ * written back in input order */
+static bool ConvertFileThreaded(FILE *fp, unsigned int threads)
+{
+  unsigned int lines = 0;
+  unsigned int chunks = 0; 
+  unsigned int failed = 0;
+
+  char *buffer = (char*)malloc(sizeof(char) * BATCH_LINE_MAX+1);
+  memset(buffer,0,BATCH_LINE_MAX+1);
+
+  // babel loads its format plugins on first use, do that before any threads start
+  OBConversion warmup;
+  bool babel_out = strcmp(format,"valid") && strcmp(format,"hash") && (strcmp(format,"WLN") || opt_old); 
+  if(babel_out && !warmup.SetOutFormat(format)){
+    fprintf(stderr,"Error: babel could not load format %s\n",format);
+    free(buffer);
+    return false;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  WLNStatsEnable(opt_stats); // before the workers start
+
+  BatchEngine engine(threads);
+  std::vector<std::thread> pool;
+  for(unsigned int w=0;w<threads;w++)
+    pool.push_back(std::thread(&BatchEngine::Worker,&engine,w));
+  
+  std::thread writer([&engine,&failed]{ failed = engine.Writer(); });
+
+  BatchChunk *chunk = 0;
+  bool too_long = false;
+  while(ReadBatchLine(fp,buffer,BATCH_LINE_MAX,&too_long)){
+    lines++;
+    if(!chunk){
+      chunk = new BatchChunk;
+      chunk->failed = 0;
+      chunk->lines.reserve(BATCH_CHUNK);
+    }
+
+    // an empty line is written as a failed record by the workers, as in ConvertFile
+    const char *wln = 0;
+    if(too_long)
+      fprintf(stderr,"Warning: line %d is over %d characters, skipped\n",lines,BATCH_LINE_MAX);
+    else
+      wln = SelectColumn(buffer,opt_column);
+    chunk->lines.push_back(wln ? wln:"");
+    
+    if(chunk->lines.size() == BATCH_CHUNK){
+      chunk->id = chunks++;
+      engine.Submit(chunk);
+      chunk = 0;
+    }
   }
-  return 0;
+
+  if(chunk){
+    chunk->id = chunks++;
+    engine.Submit(chunk);
+  }
+
+  engine.Close(chunks);
+  for(unsigned int w=0;w<threads;w++)
+    pool[w].join();
+  writer.join();
+
+  std::cout.flush();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  
+  fprintf(stderr,"%d lines parsed, %d failed\n",lines,failed);
+  for(unsigned int w=0;w<threads;w++){
+    WorkerStats &ws = engine.stats[w];
+    fprintf(stderr,"  worker %d: %d lines, %.0f lines/sec\n",w,ws.lines, ws.seconds > 0 ? ws.lines/ws.seconds : 0.0);
+  }
+  fprintf(stderr,"  total: %.0f lines/sec over %.2f sec\n", elapsed.count() > 0 ? lines/elapsed.count() : 0.0,elapsed.count());
+  if(opt_unique)
+    engine.unique.Report();
+  if(!opt_old)
+    ReportRingCache();
+  if(opt_stats)
+    WLNStatsReport(stderr);
+
+  free(buffer);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  ProcessCommandLine(argc, argv);
+  
+  if(file_inp){
+    FILE *fp = stdin; 
+    if(strcmp(file_inp,"-")){
+      fp = fopen(file_inp,"r");
+      if(!fp){
+        fprintf(stderr,"Error: unable to open file at: %s\n",file_inp);
+        return 1; 
+      }
+    }
+
+    if(opt_threads > 1)
+      ConvertFileThreaded(fp,opt_threads);
+    else{
+      WLNStatsEnable(opt_stats);
+      ConvertFile(fp);
+    }
+    if(fp != stdin)
+      fclose(fp);
+    return 0;
+  }
+
+  OBMol mol;
+  OBConversion conv;
+  conv.AddOption("h",OBConversion::OUTOPTIONS);
+  conv.SetOutFormat(format);
+
+  std::string out;
+  if(!strcmp(format,"valid")){
+    bool valid = AppendValidation(cli_inp,out);
+    std::cout << out;
+    return valid ? 0:1;
+  }
+
+  WLNStatsEnable(opt_stats);
+  bool converted = ConvertWLN(cli_inp,&mol,conv,out);
+  std::cout << out;
+  if(opt_stats)
+    WLNStatsReport(stderr);
+  return converted ? 0:1;
 }
@@ -32,6 +32,11 @@ GNU General Public License for more details.
 
 #include <utility> // std::pair
 #include <iterator>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <chrono>
 
 #include <openbabel/mol.h>
 #include <openbabel/plugin.h>
@@ -51,15 +56,23 @@ GNU General Public License for more details.
 
 using namespace OpenBabel; 
 
-#define STRUCT_COUNT 1024
-#define MAX_EDGES 8
+#define SYMBOL_CHUNK 256  // arena chunk sizes, graphs grow a chunk at a time
+#define RING_CHUNK 32
+#define EDGE_CHUNK 256
+#define EDGE_BLOCK 4      // edges per pool block, covers most symbols in one block
+#define SPECIAL_SIZE 12   // inline special buffer, fits any element or chain length
 #define AMPERSAND_EXPAND 23
 #define BROKEN_TREE_LIMIT 6
+#define RING_CACHE_SIZE 4096 // solved ring blocks kept, oldest evicted first
+#ifndef DENSE_KEKULE_LIMIT
+#define DENSE_KEKULE_LIMIT 32 // larger rings kekulize over sparse adjacency
+#endif
+#define STATS_BUCKETS 40     // log2 nanosecond latency buckets
+#define STATS_CLASSES 5      // acyclic, 1, 2, 3, 4+ ring systems
 
 // --- DEV OPTIONS  ---
 #define OPT_CORRECT 0
 
-const char *wln_input;
 struct WLNSymbol;
 struct WLNEdge; 
 struct WLNRing;
@@ -83,12 +96,33 @@ int isNumber(const std::string& str)
 }
 
 
-bool Fatal(unsigned int pos, const char *message)
+/* per call parser state, each api call owns its own context so the reader
+ * holds no process globals and can be called from multiple threads */
+struct WLNContext{
+  const char *wln_input;    // full input string, used for error reporting
+  unsigned int len;
+  unsigned int error_pos;   // position of the last fatal error
+  const char *error_msg;
+  bool debug; 
+
+  WLNContext(const char *ptr){
+    wln_input = ptr; 
+    len       = ptr ? strlen(ptr):0;
+    error_pos = 0;
+    error_msg = 0;
+    debug     = OPT_DEBUG;
+  }
+};
+
+
+bool Fatal(WLNContext &ctx, unsigned int pos, const char *message)
 { 
+  ctx.error_pos = pos;
+  ctx.error_msg = message;
 
 #if ERRORS == 1
   fprintf(stderr,"%s\n",message);
-  fprintf(stderr, "Fatal: %s\n", wln_input);
+  fprintf(stderr, "Fatal: %s\n", ctx.wln_input);
   fprintf(stderr, "       ");
   for (unsigned int i = 0; i < pos; i++)
     fprintf(stderr, " ");
@@ -104,18 +138,52 @@ bool Fatal(unsigned int pos, const char *message)
                           STRUCT DEFINTIONS
 **********************************************************************/
  
+// chunked object pool, chunks are only freed when the arena dies so handed out 
+// pointers stay valid as it grows, reset() recycles every object for the next molecule
+template <typename T, unsigned int N>
+struct WLNArena
+{
+  std::vector<T*> chunks;
+  unsigned int used;
+
+  WLNArena(){
+    used = 0;
+  }
+
+  ~WLNArena(){
+    for (unsigned int i=0;i<chunks.size();i++)
+      delete [] chunks[i];
+  }
+
+  // objects come back in whatever state the last molecule left them, callers reset
+  T *next(){
+    unsigned int c = used / N;
+    if(c == chunks.size())
+      chunks.push_back(new T[N]);
+    
+    T *obj = &chunks[c][used % N];
+    used++;
+    return obj;
+  }
+
+  void reset(){
+    used = 0;
+  }
+};
+
 
 struct WLNEdge{
   WLNSymbol *parent;
   WLNSymbol *child;
   WLNEdge *reverse; // points to its backwards edge 
-  unsigned int order;
+  unsigned char order;
+  unsigned char stereo; // 0- none, 1 - descend, 2- accend
   bool aromatic;
-  unsigned int stereo; // 0- none, 1 - descend, 2- accend
 
   WLNEdge(){
     parent   = 0;
     child    = 0;
+    reverse  = 0;
     order    = 0;
     aromatic = 0;
     stereo = 0; 
@@ -124,15 +192,128 @@ struct WLNEdge{
 };
 
 
+// fixed block of edges in the graph edge pool, a symbol chains further blocks 
+// on when it outgrows the first. edges never move once made, so edge and 
+// reverse pointers stay valid while the graph is being built
+struct WLNEdgeBlock{
+  WLNEdge edges[EDGE_BLOCK];
+  WLNEdgeBlock *next;
+};
+
+typedef WLNArena<WLNEdgeBlock,EDGE_CHUNK> WLNEdgePool;
+
+
+// indexable view of a symbols edges, the count is held on the symbol
+struct WLNEdgeList{
+  WLNEdgeBlock *head;
+  WLNEdgeBlock *tail;
+
+  WLNEdge &operator[](unsigned int i){
+    WLNEdgeBlock *block = head;
+    while(i >= EDGE_BLOCK){
+      block = block->next;
+      i -= EDGE_BLOCK;
+    }
+    return block->edges[i];
+  }
+
+  void clear(){
+    head = 0;
+    tail = 0;
+  }
+
+  // returns a fresh edge for position n, taking a new block from the pool on a boundary
+  WLNEdge *append(unsigned int n, WLNEdgePool *pool){
+    if(n % EDGE_BLOCK == 0){
+      WLNEdgeBlock *block = pool->next();
+      block->next = 0;
+      if(tail)
+        tail->next = block;
+      else
+        head = block;
+      tail = block;
+    }
+    WLNEdge *edge = &tail->edges[n % EDGE_BLOCK];
+    *edge = WLNEdge();
+    return edge;
+  }
+};
+
+
+// small inline string for element codes and chain lengths, avoids a heap 
+// string per symbol 
+struct WLNSpecial{
+  char buf[SPECIAL_SIZE];
+  unsigned char len;
+
+  WLNSpecial(){
+    clear();
+  }
+
+  void clear(){
+    len = 0;
+    buf[0] = '\0';
+  }
+
+  bool empty() const{
+    return !len;
+  }
+
+  const char *c_str() const{
+    return buf;
+  }
+
+  void push_back(char ch){
+    if(len >= SPECIAL_SIZE-1){
+      fprintf(stderr,"Error: special symbol string is too long, truncating\n");
+      return;
+    }
+    buf[len++] = ch;
+    buf[len] = '\0';
+  }
+
+  char operator[](unsigned int i) const{
+    return buf[i];
+  }
+
+  WLNSpecial &operator+=(char ch){
+    push_back(ch);
+    return *this;
+  }
+
+  WLNSpecial &operator=(char ch){
+    clear();
+    push_back(ch);
+    return *this;
+  }
+
+  WLNSpecial &operator=(const std::string &str){
+    clear();
+    for(unsigned int i=0;i<str.size();i++)
+      push_back(str[i]);
+    return *this;
+  }
+
+  bool operator==(const char *str) const{
+    return !strcmp(buf,str);
+  }
+
+  bool operator!=(const char *str) const{
+    return strcmp(buf,str);
+  }
+};
+
+
+
 struct WLNSymbol
 {
-  unsigned short int id;
+  unsigned int id;
   unsigned int str_position; 
   short int charge;
   unsigned int explicit_H; // if explicit, take the value, else we calculate the fill valence?
 
   unsigned char ch;
-  std::string special; // string for element, or ring, if value = '*'
+  WLNSpecial special; // string for element, or ring, if value = '*'
   
   bool aromatic;
   bool spiro;
@@ -142,11 +323,25 @@ struct WLNSymbol
   
   unsigned char barr_n; // doesnt need to be large
   unsigned char parr_n; // doesnt need to be large
-  WLNEdge bond_array[MAX_EDGES]; // move to undirected 
-  WLNEdge prev_array[MAX_EDGES]; // points backwards 
+  WLNEdgeList bond_array; // move to undirected 
+  WLNEdgeList prev_array; // points backwards 
+  WLNEdgePool *edge_pool; // graph owned storage for both lists
+
+  // ring position, held for the ring that claimed the symbol first
+  WLNRing *locant_ring;
+  unsigned int ring_locant;
+  WLNRing *offset_ring;
+  unsigned int ring_offset;
 
   // if default needed
   WLNSymbol()
+  {
+    reset();
+  }
+  ~WLNSymbol(){};
+
+  // returns the symbol to its default state, its edge blocks go back with the graph pool
+  void reset()
   {
     id = 0;
     ch = '\0';
@@ -160,8 +355,15 @@ struct WLNSymbol
     str_position = 0; 
     barr_n = 0; 
     parr_n = 0; 
+    special.clear();
+    bond_array.clear();
+    prev_array.clear();
+    edge_pool = 0;
+    locant_ring = 0;
+    ring_locant = 0;
+    offset_ring = 0;
+    ring_offset = 0;
   }
-  ~WLNSymbol(){};
 
   void add_special(const char* ptr, unsigned int s, unsigned int e)
   {
@@ -171,19 +373,89 @@ struct WLNSymbol
 
 };
 
+// flat locant lookup, indexed by the locant value, broken locants sit above 128.
+// values past any real locant only come from bad locant arithmetic on malformed
+// input, they go to a map rather than growing the table to match
+#define LOCANT_TABLE_MAX 2048
+struct WLNLocantTable
+{
+  std::vector<WLNSymbol*> table;
+  std::map<unsigned int,WLNSymbol*> sparse;
+
+  WLNSymbol *&operator[](unsigned int loc){
+    if(loc >= LOCANT_TABLE_MAX)
+      return sparse[loc];
+    if(loc >= table.size())
+      table.resize(loc+1,(WLNSymbol*)0);
+    return table[loc];
+  }
+
+  void clear(){
+    table.clear();
+    sparse.clear();
+  }
+};
+
+// symbol to ring value, stored on the symbol itself. a symbol already holding a
+// value for another ring (spiro points) spills into the overflow map
+template <WLNRing* WLNSymbol::*OWNER, unsigned int WLNSymbol::*VALUE>
+struct WLNRingIndex
+{
+  WLNRing *ring;
+  std::vector<WLNSymbol*> claimed;
+  std::map<WLNSymbol*,unsigned int> overflow;
+
+  WLNRingIndex():ring(0){}
+
+  unsigned int &operator[](WLNSymbol *sym){
+    if(!sym)
+      return overflow[sym];
+    if(sym->*OWNER == ring)
+      return sym->*VALUE;
+    
+    if(!overflow.empty()){
+      std::map<WLNSymbol*,unsigned int>::iterator it = overflow.find(sym);
+      if(it != overflow.end())
+        return it->second;
+    }
+
+    // free, or only holding a zero from a lookup
+    if(!(sym->*OWNER) || !(sym->*VALUE)){
+      sym->*OWNER = ring;
+      sym->*VALUE = 0;
+      claimed.push_back(sym);
+      return sym->*VALUE;
+    }
+
+    return overflow[sym];
+  }
+
+  void clear(){
+    for (unsigned int i=0;i<claimed.size();i++){
+      if(claimed[i]->*OWNER == ring){
+        claimed[i]->*OWNER = 0;
+        claimed[i]->*VALUE = 0;
+      }
+    }
+    claimed.clear();
+    overflow.clear();
+  }
+};
+
 struct WLNRing
 {
   unsigned int rsize;
   unsigned int aromatic_atoms;
   unsigned int *adj_matrix; 
+  unsigned int adj_capacity; // allocated matrix entries, kept between molecules
   
   // quick ring perception
   std::vector<unsigned char> assignment_locants;
   std::vector<unsigned int>   assignment_digits;
   
-  std::map<unsigned int, WLNSymbol *>     locants; // int allows effectively infinite broken positions 
-  std::map<WLNSymbol*,unsigned int>       locants_ch;
-  std::map<WLNSymbol*,unsigned int>       position_offset; // gives hetero position in the string
+  WLNLocantTable locants; // int allows effectively infinite broken positions 
+  WLNRingIndex<&WLNSymbol::locant_ring,&WLNSymbol::ring_locant> locants_ch;
+  WLNRingIndex<&WLNSymbol::offset_ring,&WLNSymbol::ring_offset> position_offset; // gives hetero position in the string
 
   bool spiro;
   WLNEdge *macro_return;
@@ -197,9 +469,22 @@ struct WLNRing
   std::string str_notation; // used for write back
 
   WLNRing(){
+    adj_matrix = 0;
+    adj_capacity = 0;
+    locants_ch.ring = this;
+    position_offset.ring = this;
+    reset();
+  }
+  ~WLNRing(){
+    if(adj_matrix)
+      free(adj_matrix);
+    adj_matrix = 0;
+  };
+
+  // returns the ring to its default state, the adjacency buffer is kept for reuse
+  void reset(){
     rsize = 0;
     aromatic_atoms = 0;
-    adj_matrix = 0;
     spiro = 0;
     macro_return = 0; 
     multi_points = 0;
@@ -207,18 +492,23 @@ struct WLNRing
     bridge_points = 0; 
     loc_count = 0; 
     ranking = 0; 
+    assignment_locants.clear();
+    assignment_digits.clear();
+    locants.clear();
+    locants_ch.clear();
+    position_offset.clear();
+    str_notation.clear();
   }
-  ~WLNRing(){
-    if(adj_matrix)
-      free(adj_matrix);
-    adj_matrix = 0;
-  };
 
   bool FillAdjMatrix(){
     aromatic_atoms = 0;
-    adj_matrix = (unsigned int*)malloc(sizeof(unsigned int) * (rsize*rsize)); 
-    if(!adj_matrix)
-      return false;
+    if(rsize*rsize > adj_capacity){
+      unsigned int *resized = (unsigned int*)realloc(adj_matrix,sizeof(unsigned int) * (rsize*rsize)); 
+      if(!resized)
+        return false;
+      adj_matrix = resized;
+      adj_capacity = rsize*rsize;
+    }
     
     for (unsigned int i = 0; i< rsize;i++){
       for (unsigned int j=0; j < rsize;j++){
@@ -245,6 +535,8 @@ struct WLNRing
           if(csym->aromatic && redge->aromatic && csym->num_edges < csym->allowed_edges){
             unsigned char loc_b = locants_ch[csym];
             unsigned int c = LOCANT_TO_INT(loc_b-1);
+            if(c >= rsize)
+              continue; // off path locants sit outside the matrix
             adj_matrix[r * rsize + c] = 1; 
             adj_matrix[c * rsize + r] = 1; 
             aromatic_atoms++;
@@ -493,28 +785,283 @@ struct WLNGraph
   unsigned int symbol_count;
   unsigned int ring_count;
 
-  WLNSymbol *SYMBOLS[STRUCT_COUNT];
-  WLNRing   *RINGS  [STRUCT_COUNT];
+  std::vector<WLNSymbol*> SYMBOLS;
+  std::vector<WLNRing*>   RINGS;
+
+  WLNArena<WLNSymbol,SYMBOL_CHUNK>  symbol_arena;
+  WLNArena<WLNRing,RING_CHUNK>      ring_arena;
+  WLNEdgePool                       edge_pool;
   
   WLNGraph(){
     symbol_count    = 0;
     ring_count      = 0;
     root            = 0;
+    SYMBOLS.reserve(SYMBOL_CHUNK);
+    RINGS.reserve(RING_CHUNK);
+  };
+
+  ~WLNGraph(){};
+
+  // empties the graph but keeps all allocated symbols and rings for the next parse
+  void reset(){
+    symbol_count    = 0;
+    ring_count      = 0;
+    root            = 0;
+    SYMBOLS.clear();
+    RINGS.clear();
+    symbol_arena.reset();
+    ring_arena.reset();
+    edge_pool.reset();
+  }
+};
+
+
+/**********************************************************************
+                         Pipeline Statistics
+**********************************************************************/
+
+enum WLNMatcher{
+  WLN_MATCH_DENSE = 0,     // adjacency matrix, blossom
+  WLN_MATCH_SPARSE_BIPARTITE,
+  WLN_MATCH_SPARSE_BLOSSOM,
+  WLN_MATCHERS
+};
+
+static const char *stats_stages[WLN_STAGES] = {"parse","kekulize","expand","convert","sanitize"};
+static const char *stats_classes[STATS_CLASSES] = {"acyclic","1 ring","2 rings","3 rings","4+ rings"};
+static const char *stats_matchers[WLN_MATCHERS] = {"dense blossom","sparse bipartite","sparse blossom"};
+
+struct WLNStageStats{
+  unsigned long long calls;
+  unsigned long long failed;
+  unsigned long long ns;
+  unsigned long long hist[STATS_BUCKETS];
+};
+
+/* one per thread, owned by the registry so they outlive their thread for the report */
+struct WLNThreadStats{
+  WLNStageStats stage[WLN_STAGES];
+  unsigned long long strings;
+  unsigned long long failed;
+  unsigned long long symbols;
+  unsigned long long edges;
+  unsigned long long rings;
+  unsigned long long max_symbols;
+  unsigned long long matcher[WLN_MATCHERS];
+  unsigned long long class_strings[STATS_CLASSES];
+  unsigned long long class_failed[STATS_CLASSES];
+  unsigned long long class_ns[STATS_CLASSES];
+
+  WLNThreadStats(){
+    memset(this,0,sizeof(WLNThreadStats));
+  }
 
-    for (unsigned int i = 0; i < STRUCT_COUNT;i++){
-      SYMBOLS[i] = 0;
-      RINGS[i] = 0;
+  void Add(const WLNThreadStats &o){
+    for(unsigned int s=0;s<WLN_STAGES;s++){
+      stage[s].calls += o.stage[s].calls;
+      stage[s].failed += o.stage[s].failed;
+      stage[s].ns += o.stage[s].ns;
+      for(unsigned int b=0;b<STATS_BUCKETS;b++)
+        stage[s].hist[b] += o.stage[s].hist[b];
     }
-  };
+    strings += o.strings;
+    failed += o.failed;
+    symbols += o.symbols;
+    edges += o.edges;
+    rings += o.rings;
+    max_symbols = std::max(max_symbols,o.max_symbols);
+    for(unsigned int m=0;m<WLN_MATCHERS;m++)
+      matcher[m] += o.matcher[m];
+    for(unsigned int c=0;c<STATS_CLASSES;c++){
+      class_strings[c] += o.class_strings[c];
+      class_failed[c] += o.class_failed[c];
+      class_ns[c] += o.class_ns[c];
+    }
+  }
+};
+
+static bool stats_enabled = false; // set before any worker starts
+static std::mutex stats_lock;
+static std::vector<WLNThreadStats*> stats_threads;
+
+#if WLN_STATS
+
+static WLNThreadStats *ThreadStats(){
+  static thread_local WLNThreadStats *local = 0;
+  if(!local){
+    local = new WLNThreadStats;
+    std::lock_guard<std::mutex> guard(stats_lock);
+    stats_threads.push_back(local);
+  }
+  return local;
+}
+
+static inline unsigned long long StatsClock(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline void StatsMatcher(WLNMatcher m){
+  if(stats_enabled)
+    ThreadStats()->matcher[m]++;
+}
 
-  ~WLNGraph(){
-    for (unsigned int i = 0; i < STRUCT_COUNT;i++){
-      delete SYMBOLS[i];
-      delete RINGS[i];
+/* times each stage of one string, costs a single branch per call when --stats is off */
+struct WLNStatsTimer{
+  WLNThreadStats *stats;
+  unsigned long long start;
+  unsigned long long last;
+
+  WLNStatsTimer(){
+    stats = stats_enabled ? ThreadStats() : 0;
+    start = last = stats ? StatsClock() : 0;
+  }
+
+  void Lap(WLNStage s){
+    if(!stats)
+      return;
+    unsigned long long now = StatsClock();
+    unsigned long long ns = now - last;
+    last = now;
+
+    unsigned int bucket = 0;
+    while(bucket < STATS_BUCKETS-1 && (ns >> (bucket+1)))
+      bucket++;
+
+    stats->stage[s].calls++;
+    stats->stage[s].ns += ns;
+    stats->stage[s].hist[bucket]++;
+  }
+
+  void Done(WLNGraph &graph, bool ok){
+    if(!stats)
+      return;
+    unsigned int edges = 0;
+    for(unsigned int i=0;i<graph.symbol_count;i++)
+      edges += graph.SYMBOLS[i]->barr_n;
+    unsigned int c = std::min(graph.ring_count,(unsigned int)STATS_CLASSES-1);
+
+    stats->strings++;
+    stats->symbols += graph.symbol_count;
+    stats->edges += edges;
+    stats->rings += graph.ring_count;
+    stats->max_symbols = std::max(stats->max_symbols,(unsigned long long)graph.symbol_count);
+    stats->class_strings[c]++;
+    stats->class_ns[c] += StatsClock() - start;
+    if(!ok){
+      stats->failed++;
+      stats->class_failed[c]++;
+    }
+  }
+
+  bool Fail(WLNStage s, WLNGraph &graph){
+    if(stats){
+      Lap(s);
+      stats->stage[s].failed++;
+      Done(graph,false);
     }
+    return false;
   }
 };
 
+#else
+
+static inline void StatsMatcher(WLNMatcher m){}
+
+struct WLNStatsTimer{
+  void Lap(WLNStage s){}
+  void Done(WLNGraph &graph, bool ok){}
+  bool Fail(WLNStage s, WLNGraph &graph){ return false; }
+};
+
+#endif
+
+void WLNStatsEnable(bool on)
+{
+  stats_enabled = on && WLN_STATS;
+}
+
+static void StatsBucketLabel(unsigned int b, char *label){
+  if(b < 10)
+    snprintf(label,16,"%uns",1U << b);
+  else if(b < 20)
+    snprintf(label,16,"%uus",1U << (b-10));
+  else if(b < 30)
+    snprintf(label,16,"%ums",1U << (b-20));
+  else
+    snprintf(label,16,"%us",1U << (b-30));
+}
+
+/* aggregate report over every thread that has converted a string */
+void WLNStatsReport(FILE *fp)
+{
+  if(!WLN_STATS){
+    fprintf(fp,"stats: not compiled in, rebuild with WLN_STATS=1\n");
+    return;
+  }
+
+  WLNThreadStats all;
+  {
+    std::lock_guard<std::mutex> guard(stats_lock);
+    for(unsigned int t=0;t<stats_threads.size();t++)
+      all.Add(*stats_threads[t]);
+  }
+
+  unsigned long long total_ns = 0;
+  for(unsigned int c=0;c<STATS_CLASSES;c++)
+    total_ns += all.class_ns[c];
+
+  double n = all.strings ? (double)all.strings : 1.0;
+  fprintf(fp,"stats: %llu strings, %llu failed\n",all.strings,all.failed);
+  fprintf(fp,"  per string: %.1f symbols, %.1f edges, %.2f rings, largest %llu symbols\n",
+          all.symbols/n,all.edges/n,all.rings/n,all.max_symbols);
+  fprintf(fp,"  kekulize:");
+  for(unsigned int m=0;m<WLN_MATCHERS;m++)
+    fprintf(fp," %s %llu%s",stats_matchers[m],all.matcher[m],m+1 < WLN_MATCHERS ? ",":"\n");
+
+  fprintf(fp,"  %-10s %10s %10s %12s %10s\n","stage","calls","failed","total ms","mean us");
+  for(unsigned int s=0;s<WLN_STAGES;s++){
+    WLNStageStats &st = all.stage[s];
+    fprintf(fp,"  %-10s %10llu %10llu %12.2f %10.2f\n",stats_stages[s],st.calls,st.failed,
+            st.ns/1e6,st.calls ? st.ns/1e3/st.calls : 0.0);
+  }
+
+  // only print the bucket span that has any entries
+  unsigned int lo = STATS_BUCKETS;
+  unsigned int hi = 0;
+  for(unsigned int s=0;s<WLN_STAGES;s++){
+    for(unsigned int b=0;b<STATS_BUCKETS;b++){
+      if(all.stage[s].hist[b]){
+        lo = std::min(lo,b);
+        hi = std::max(hi,b);
+      }
+    }
+  }
+
+  if(lo <= hi){
+    char label[16];
+    fprintf(fp,"  %-10s","latency");
+    for(unsigned int b=lo;b<=hi;b++){
+      StatsBucketLabel(b,label);
+      fprintf(fp," %8s",label);
+    }
+    fprintf(fp,"\n");
+    for(unsigned int s=0;s<WLN_STAGES;s++){
+      fprintf(fp,"  %-10s",stats_stages[s]);
+      for(unsigned int b=lo;b<=hi;b++)
+        fprintf(fp," %8llu",all.stage[s].hist[b]);
+      fprintf(fp,"\n");
+    }
+  }
+
+  fprintf(fp,"  %-10s %10s %10s %10s %8s\n","class","strings","failed","mean us","time %");
+  for(unsigned int c=0;c<STATS_CLASSES;c++){
+    unsigned long long k = all.class_strings[c];
+    fprintf(fp,"  %-10s %10llu %10llu %10.2f %8.1f\n",stats_classes[c],k,all.class_failed[c],
+            k ? all.class_ns[c]/1e3/k : 0.0, total_ns ? 100.0*all.class_ns[c]/total_ns : 0.0);
+  }
+}
+
 
 // needs to be able to hold both a WLNSymbol and WLNRing for branch returns,
 // first is the WLNRing, second is the branching WLN symbol 
@@ -733,17 +1280,11 @@ bool WriteGraph(WLNGraph &graph,const char*filename){
 
 WLNSymbol *AllocateWLNSymbol(unsigned char ch, WLNGraph &graph)
 {
-
-  if(graph.symbol_count >= STRUCT_COUNT){
-#if ERRORS == 1
-    fprintf(stderr,"Error: creating more than 1024 wln symbols - is this reasonable?\n");
-#endif
-    return 0;
-  }
-
-  WLNSymbol *wln = new WLNSymbol;
+  WLNSymbol *wln = graph.symbol_arena.next();
+  wln->reset();
   wln->id = graph.symbol_count++;
-  graph.SYMBOLS[wln->id] = wln;
+  wln->edge_pool = &graph.edge_pool;
+  graph.SYMBOLS.push_back(wln);
   wln->ch = ch;
   return wln;
 }
@@ -1190,7 +1731,7 @@ WLNSymbol* define_element(unsigned char special_1, unsigned char special_2, WLNG
 
 
 /* checks are already made, this should just return*/
-unsigned int special_element_atm(std::string &special){
+unsigned int special_element_atm(const WLNSpecial &special){
 
   switch (special[0]){
 
@@ -1524,8 +2065,8 @@ WLNSymbol *return_object_symbol(ObjectStack &branch_stack){
                           WLNEdge Functions
 **********************************************************************/
 
-/* adds an edge between two symbols, arrays should be held by each symbol
- * symbols are malloced so address is stable */
+/* adds an edge between two symbols, edges come from the graph edge pool
+ * which never moves them, so returned addresses are stable */
 WLNEdge* AddEdge(WLNSymbol *child, WLNSymbol *parent)
 {
   if(!child || !parent || child == parent){
@@ -1539,11 +2080,6 @@ WLNEdge* AddEdge(WLNSymbol *child, WLNSymbol *parent)
       return &parent->bond_array[i]; 
   }
   
-  if(parent->barr_n >= MAX_EDGES){
-    fprintf(stderr,"Error: creating more %d bonds on a singular symbol - is this reasonable?\n",MAX_EDGES);
-    return 0;
-  }
-  
   if ( ((child->num_edges + 1) > child->allowed_edges)){
     fprintf(stderr, "Error: wln character[%c] is exceeding allowed connections %d/%d\n", child->ch,child->num_edges+1, child->allowed_edges);
     return 0;
@@ -1557,13 +2093,13 @@ WLNEdge* AddEdge(WLNSymbol *child, WLNSymbol *parent)
   child->num_edges++;
   parent->num_edges++;
   
-  WLNEdge *forward = &parent->bond_array[parent->barr_n];
+  WLNEdge *forward = parent->bond_array.append(parent->barr_n,parent->edge_pool);
   forward->child = child;
   forward->parent = parent;
   forward->order = 1; 
   parent->barr_n++;
   
-  WLNEdge *backward = &child->prev_array[child->parr_n]; 
+  WLNEdge *backward = child->prev_array.append(child->parr_n,child->edge_pool); 
   // store the reverse in the prev array
   backward->child = parent; 
   backward->parent = child; 
@@ -1752,11 +2288,10 @@ bool resolve_methyls(WLNSymbol *target, WLNGraph &graph){
 
 WLNRing *AllocateWLNRing(WLNGraph &graph)
 {
-  if(graph.ring_count >= STRUCT_COUNT)
-    return 0;
-  
-  WLNRing *wln_ring = new WLNRing;
-  graph.RINGS[graph.ring_count++] = wln_ring;
+  WLNRing *wln_ring = graph.ring_arena.next();
+  wln_ring->reset();
+  graph.RINGS.push_back(wln_ring);
+  graph.ring_count++;
   return wln_ring;
 }
 
@@ -1795,6 +2330,7 @@ unsigned int get_offbranch_tree_root(unsigned int locant){
  128 + (1 * 6) = 'B' node, 134 = B-, 135 = B-&, 136 = B--, 137 = B--&, 138 = B-&-, 139 = B-&&
  128 + (2 * 6) = 'C' node, 140... 
 */
+/* branch_locants must hold local_size * BROKEN_TREE_LIMIT entries */
 int OffPathLocants(WLNRing*ring, unsigned int local_size,
                             std::map<unsigned int,unsigned int> &bridge_locants,
                             LocantPos*branch_locants)
@@ -1811,11 +2347,6 @@ int OffPathLocants(WLNRing*ring, unsigned int local_size,
 
         if(bridge_locants[b+ 128 + (i * BROKEN_TREE_LIMIT)])
           branch_locants->allowed_connections --; 
-
-        if(b_locant == 32){
-          fprintf(stderr,"Error: branching locant exceed 32, is this even possible?\n");
-          return -1; 
-        }
       }
     }
   }
@@ -1899,7 +2430,7 @@ unsigned int BuildCyclic( std::vector<std::pair<unsigned int,unsigned int>>   &r
   // just use the contructors with new
   
   LocantPos *locant_path = new LocantPos[local_size];  
-  LocantPos *branch_locants = new LocantPos[32]; // anything over this would be excessive? even possible?   
+  LocantPos *branch_locants = new LocantPos[local_size * BROKEN_TREE_LIMIT]; // every broken position a path locant can hold
   unsigned int b_locant = OffPathLocants(ring,local_size, bridge_locants, branch_locants); 
   
   WLNSymbol *curr = 0; 
@@ -2314,6 +2845,12 @@ unsigned int PathSolverIII( std::vector<std::pair<unsigned int,unsigned int>>
   if(OPT_DEBUG)
     fputc('\n',stderr); 
 
+  // path locants are single characters below the broken locant range
+  if(!local_size || local_size >= LOCANT_TO_INT(128)){
+    fprintf(stderr,"Error: ring system size is outside the locant range (max %u path locants)\n",LOCANT_TO_INT(127));
+    return 0; 
+  }
+
   LocantPos *locant_path = new LocantPos[local_size];  
   if(!assign_locant_path_connections(ring, locant_path, local_size,bridge_locants, graph)){
     delete [] locant_path; 
@@ -2321,7 +2858,7 @@ unsigned int PathSolverIII( std::vector<std::pair<unsigned int,unsigned int>>
     return 0; 
   }
 
-  LocantPos *branch_locants = new LocantPos[32]; // anything over this would be excessive? even possible?   
+  LocantPos *branch_locants = new LocantPos[local_size * BROKEN_TREE_LIMIT]; // every broken position a path locant can hold
   int b_locant = OffPathLocants(ring,local_size, bridge_locants, branch_locants); 
   if(b_locant == -1){
     fprintf(stderr,"Error: couldn't assign off-path connections\n");
@@ -2358,6 +2895,13 @@ unsigned int PathSolverIII( std::vector<std::pair<unsigned int,unsigned int>>
     std::vector<WLNSymbol*> best_path;
     std::vector<WLNSymbol*> off_paths; // for arom only
     
+    if(start_char < 128 && (start_char < 'A' || start_char > max_locant)){
+      fprintf(stderr,"Error: ring assignment locant outside of the ring size\n");
+      delete [] locant_path;
+      delete [] branch_locants;
+      return 0; 
+    }
+
     if(start_char < 128){
       start_locant = &locant_path[ LOCANT_TO_INT(start_char-1) ]; 
       
@@ -2418,8 +2962,10 @@ unsigned int PathSolverIII( std::vector<std::pair<unsigned int,unsigned int>>
               // backtracking to maximise 
               if(highest_loc && path_size < comp_size-2)
                 backtrack_stack.push({edge_taken,path_size}); // push the old
-              else if(path_size < comp_size-2)
+              else if(path_size < comp_size-2 && b_locant && !total_highest)
                 backtrack_stack.push({&curr_locant->locant->bond_array[ei],path_size}); // push a new
+                // only a broken locant walk can differ when replayed from the edge it took,
+                // anywhere else the replay is identical and macrocycles went exponential
             
               highest_loc = child_loc;
               edge_taken = &curr_locant->locant->bond_array[ei];
@@ -2467,6 +3013,8 @@ unsigned int PathSolverIII( std::vector<std::pair<unsigned int,unsigned int>>
         }
         else {
           fprintf(stderr,"Error: locant traversal failure\n");
+          delete [] locant_path;
+          delete [] branch_locants;
           return 0; 
         }
       }
@@ -2490,6 +3038,8 @@ unsigned int PathSolverIII( std::vector<std::pair<unsigned int,unsigned int>>
         
         if(symbol_path.empty()){
           fprintf(stderr,"Error: %c could not be found in previous path\n", ring->locants_ch[back_edge->parent]);
+          delete [] locant_path;
+          delete [] branch_locants;
           return 0; 
         }
 
@@ -2499,6 +3049,12 @@ unsigned int PathSolverIII( std::vector<std::pair<unsigned int,unsigned int>>
     }while(!backtrack_stack.empty());  
 
     end_char = total_highest;
+    if(end_char < 'A' || (end_char < 128 && end_char > max_locant)){
+      fprintf(stderr,"Error: locant path overran the ring size\n");
+      delete [] locant_path;
+      delete [] branch_locants;
+      return 0; 
+    }
     if(end_char<128)
       curr_locant = &locant_path[LOCANT_TO_INT(end_char-1)];
     else
@@ -2536,6 +3092,8 @@ pseudo_jump:
       WLNEdge *new_edge = AddEdge(curr_locant->locant,start_locant->locant);  
       if(!new_edge){
         fprintf(stderr,"Error: failed to bond locant path edge from pseudo look back\n");    
+        delete [] locant_path;
+        delete [] branch_locants;
         return false;
       }
 
@@ -2613,6 +3171,8 @@ pseudo_jump:
           WLNEdge *new_edge = AddEdge(curr_locant->locant,start_locant->locant);  
           if(!new_edge){
             fprintf(stderr,"Error: failed to bond locant path edge\n");    
+            delete [] locant_path;
+            delete [] branch_locants;
             return false;
           }
 
@@ -2627,6 +3187,12 @@ pseudo_jump:
 
           // increase the start char and move the path locant
           start_char++;
+          if(start_char > max_locant){
+            fprintf(stderr,"Error: locant path overran the ring size\n");
+            delete [] locant_path;
+            delete [] branch_locants;
+            return 0; 
+          }
           start_locant = &locant_path[LOCANT_TO_INT(start_char-1)]; 
           
           best_path.insert(best_path.begin(),start_locant->locant);  
@@ -2647,6 +3213,12 @@ pseudo_jump:
             end_char = ring->locants_ch[best_path.back()]; 
           }
           
+          if(end_char < 'A' || end_char > max_locant){
+            fprintf(stderr,"Error: locant path overran the ring size\n");
+            delete [] locant_path;
+            delete [] branch_locants;
+            return 0; 
+          }
           curr_locant = &locant_path[LOCANT_TO_INT(end_char-1)]; 
         }
       }
@@ -2745,7 +3317,7 @@ unsigned int attach_offpath_locant( unsigned int positional_locant,unsigned int
 }
 
 /* parse the WLN ring block, use ignore for already predefined spiro atoms */
-bool FormWLNRing(WLNRing *ring, const char *wln_block,unsigned int i, unsigned int len,WLNGraph &graph,unsigned char spiro_atom='\0'){
+bool SolveWLNRing(WLNRing *ring, const char *wln_block,unsigned int i, unsigned int len,WLNGraph &graph,WLNContext &ctx,unsigned char spiro_atom){
 
   bool warned             = false;  // limit warning messages to console
   bool heterocyclic       = false;  // L|T designator can throw warnings
@@ -2809,7 +3381,7 @@ character_start_ring:
     switch(ch){
       case ' ':
         if(expected_locants)
-          return Fatal(i,"Error: not enough locants before space character");
+          return Fatal(ctx,i,"Error: not enough locants before space character");
         
         else if(state_multi == 1)
           state_multi = 2;
@@ -2817,7 +3389,7 @@ character_start_ring:
           state_pseudo = 0;
         else if(positional_locant && locant_attached){
           if(ring_components.empty())
-            return Fatal(i,"Error: assigning bridge locants without a ring");
+            return Fatal(ctx,i,"Error: assigning bridge locants without a ring");
           else
             bridge_locants[positional_locant] = true;
         }
@@ -2861,7 +3433,7 @@ character_start_ring:
                 locant_a = ring->locants[positional_locant]; 
               
               if(!AddEdge(locant_a,ring->locants[locant_attached]))
-                return Fatal(i,"Error: failure on attaching off path locant"); 
+                return Fatal(ctx,i,"Error: failure on attaching off path locant"); 
 
               if(state_pseudo)
                 pseudo_locants.back()=positional_locant; 
@@ -2881,7 +3453,7 @@ character_start_ring:
                 locant_b = ring->locants[positional_locant]; 
 
               if(!AddEdge(locant_b,locant_a))
-                return Fatal(i,"Error: failure on attaching off path locant");
+                return Fatal(ctx,i,"Error: failure on attaching off path locant");
 
               if(state_pseudo)
                 pseudo_locants.back()=positional_locant; 
@@ -2901,7 +3473,7 @@ character_start_ring:
 
       case '/':
         if(state_aromatics)
-          return Fatal(i,"Error: invalid character in the aromaticity assignment block");
+          return Fatal(ctx,i,"Error: invalid character in the aromaticity assignment block");
              
         expected_locants = 2; 
         state_pseudo = 1;
@@ -2943,7 +3515,7 @@ character_start_ring:
           if(wln_block[i+1] >= '0' && wln_block[i+1] <= '9' && wln_block[i+2] >= '0' && wln_block[i+2] <= '9'){
             unsigned int big_ring = ( (wln_block[i+1]-'0') * 10) + wln_block[i+2]-'0';
             if(!big_ring)
-              return Fatal(i,"Error: non numeric value entered as ring size");
+              return Fatal(ctx,i,"Error: non numeric value entered as ring size");
 
             ring_components.push_back({big_ring,positional_locant}); //big ring
             positional_locant = 'A';
@@ -2957,14 +3529,14 @@ character_start_ring:
               // must be a special element
               WLNSymbol *new_locant =  define_element(wln_block[i+1],wln_block[i+2],graph); 
               if(!new_locant)
-                return Fatal(i, "Error: could not create periodic code element");
+                return Fatal(ctx,i, "Error: could not create periodic code element");
 
               assign_locant(positional_locant,new_locant,ring);  // elemental definition
 
               new_locant->str_position = i + 2; // attaches directly to the starting letter
               ring->position_offset[new_locant] = i+1;
     
-              if(OPT_DEBUG)
+              if(ctx.debug)
                 fprintf(stderr,"  assigning element %c%c to position %c\n",
                                wln_block[i+1],wln_block[i+2],positional_locant);
               
@@ -2980,7 +3552,7 @@ character_start_ring:
             // must be a branching modifier - these are built in a tree, so must be bound to its previous
             positional_locant = attach_offpath_locant(positional_locant, locant_attached, ring, graph); 
             if(!positional_locant)
-              return Fatal(i, "Error: failed to attach off branch locant"); 
+              return Fatal(ctx,i, "Error: failed to attach off branch locant"); 
 
             if(state_pseudo)
               pseudo_locants.back() = positional_locant; 
@@ -2993,13 +3565,13 @@ character_start_ring:
             if(positional_locant != spiro_atom){
               WLNSymbol *new_locant = define_hypervalent_element(wln_block[i+1],graph); 
               if(!new_locant)
-                return Fatal(i, "Error: could not create hypervalent element");
+                return Fatal(ctx,i, "Error: could not create hypervalent element");
               
               assign_locant(positional_locant,new_locant,ring);
               
               new_locant->str_position = i+1+1;
               ring->position_offset[new_locant] = i+1;
-              if(OPT_DEBUG)
+              if(ctx.debug)
                 fprintf(stderr,"  assigning hypervalent %c to position %c\n",wln_block[i+1],positional_locant);
             }
             else 
@@ -3013,7 +3585,7 @@ character_start_ring:
             // this must also be branching modifier 
             positional_locant = attach_offpath_locant(positional_locant, locant_attached, ring, graph); 
             if(!positional_locant)
-              return Fatal(i, "Error: failed to attach off branch locant"); 
+              return Fatal(ctx,i, "Error: failed to attach off branch locant"); 
             
             if(state_pseudo)
               pseudo_locants.back() = positional_locant; 
@@ -3022,7 +3594,7 @@ character_start_ring:
         else{
           positional_locant = attach_offpath_locant(positional_locant, locant_attached, ring, graph); 
           if(!positional_locant)
-            return Fatal(i, "Error: failed to attach off branch locant"); 
+            return Fatal(ctx,i, "Error: failed to attach off branch locant"); 
            
           if(state_pseudo)
             pseudo_locants.back() = positional_locant; 
@@ -3034,7 +3606,7 @@ character_start_ring:
           if(!positional_locant)
             positional_locant = 'A';
 
-          if(OPT_DEBUG)
+          if(ctx.debug)
             fprintf(stderr,"  placing pi bond charge on locant - %c\n",positional_locant);
 
           
@@ -3058,7 +3630,7 @@ character_start_ring:
       case '8':
       case '9':
         if(state_aromatics)
-          return Fatal(i,"Error: invalid character in the aromaticity assignment block");
+          return Fatal(ctx,i,"Error: invalid character in the aromaticity assignment block");
         
         if (i > 1 && wln_block[i-1] == ' '){
 #if MODERN
@@ -3088,13 +3660,13 @@ character_start_ring:
           heterocyclic = true;
           ring_start = false; 
           
-          if(OPT_DEBUG)
+          if(ctx.debug)
             fprintf(stderr,"  opening chelating notation\n");
           break;
         }
 
         if(state_aromatics)
-          return Fatal(i,"Error: invalid character in the aromaticity assignment block");
+          return Fatal(ctx,i,"Error: invalid character in the aromaticity assignment block");
         
 
         if(expected_locants){
@@ -3103,7 +3675,7 @@ character_start_ring:
           else if (state_pseudo)
             pseudo_locants.push_back(ch);
           else
-            return Fatal(i,"Error: unhandled locant rule");
+            return Fatal(ctx,i,"Error: unhandled locant rule");
           
 
           positional_locant = ch; // use for look back
@@ -3144,7 +3716,7 @@ character_start_ring:
       case 'Y':
       case 'Z':
         if(state_aromatics)
-          return Fatal(i,"Error: invalid character in the aromaticity assignment block");
+          return Fatal(ctx,i,"Error: invalid character in the aromaticity assignment block");
         
         if(expected_locants){
           if(state_multi)
@@ -3152,7 +3724,7 @@ character_start_ring:
           else if (state_pseudo)
             pseudo_locants.push_back(ch);
           else
-            Fatal(i,"Error: unhandled locant rule");
+            Fatal(ctx,i,"Error: unhandled locant rule");
 
           positional_locant = ch; // use for look back
           locant_attached = ch;
@@ -3169,7 +3741,7 @@ character_start_ring:
         }
         else if (positional_locant){
           
-          if (OPT_DEBUG)
+          if (ctx.debug)
             fprintf(stderr,"  assigning WLNSymbol %c to position %c\n",ch,positional_locant);
 
           switch(ch){
@@ -3368,10 +3940,10 @@ character_start_ring:
               ring->position_offset[locant_b] = i; 
               edge = AddEdge(locant_b, locant_a); 
               if(!edge)
-                return Fatal(i,"Error: failed to create bond");
+                return Fatal(ctx,i,"Error: failed to create bond");
               edge = &locant_a->bond_array[locant_a->barr_n-1];  
               if(!unsaturate_edge(edge,2))
-                return Fatal(i,"Error: failed to unsaturate edge");
+                return Fatal(ctx,i,"Error: failed to unsaturate edge");
               
               positional_locant++; 
               break;
@@ -3389,14 +3961,14 @@ character_start_ring:
             }
 
             default:
-              return Fatal(i,"Error: invalid character in atom assignment within ring notation");
+              return Fatal(ctx,i,"Error: invalid character in atom assignment within ring notation");
           }
 
           locant_attached = 0; // locant is no longer primary
         }
         else if(i>0 && wln_block[i-1] == ' '){
           if(ring_size_specifier && ch > ring_size_specifier)
-            return Fatal(i, "Error: specifying locants outside of allowed range"); 
+            return Fatal(ctx,i, "Error: specifying locants outside of allowed range"); 
 
           positional_locant = ch;
           locant_attached = ch;
@@ -3411,7 +3983,7 @@ character_start_ring:
         }
 
         if(state_aromatics)
-          return Fatal(i,"Error: invalid character in the aromaticity assignment block");
+          return Fatal(ctx,i,"Error: invalid character in the aromaticity assignment block");
         
         if(expected_locants){
 
@@ -3420,7 +3992,7 @@ character_start_ring:
           else if (state_pseudo)
             pseudo_locants.push_back(ch);
           else
-            return Fatal(i,"Error: unhandled locant rule");
+            return Fatal(ctx,i,"Error: unhandled locant rule");
           
 
           positional_locant = ch; // use for look back
@@ -3435,13 +4007,13 @@ character_start_ring:
         else{
           if(i>0 && wln_block[i-1] == ' '){
             if(ring_size_specifier && ch > ring_size_specifier)
-              return Fatal(i, "Error: specifying locants outside of allowed range"); 
+              return Fatal(ctx,i, "Error: specifying locants outside of allowed range"); 
             
             positional_locant = ch;
             locant_attached = ch;
           }
           else
-            return Fatal(i,"Error: symbol is in an unhandled state, please raise issue if this notation is 100%% correct");
+            return Fatal(ctx,i,"Error: symbol is in an unhandled state, please raise issue if this notation is 100%% correct");
           
         }
       
@@ -3465,7 +4037,7 @@ character_start_ring:
           else if (state_pseudo)
             pseudo_locants.push_back(ch);
           else
-            return Fatal(i,"Error: unhandled locant rule");
+            return Fatal(ctx,i,"Error: unhandled locant rule");
           
 
           positional_locant = ch; // use for look back
@@ -3479,7 +4051,7 @@ character_start_ring:
         }
         else if(positional_locant && locant_attached){
           if(ring_components.empty())
-            return Fatal(i,"Error: assigning bridge locants without a ring");
+            return Fatal(ctx,i,"Error: assigning bridge locants without a ring");
           else
             bridge_locants[positional_locant] = true;
             
@@ -3489,7 +4061,7 @@ character_start_ring:
         else{
           if(i>0 && wln_block[i-1] == ' ' && wln_block[i+1] != 'J'){
             if(ring_size_specifier && ch > ring_size_specifier)
-              return Fatal(i, "Error: specifying locants outside of allowed range"); 
+              return Fatal(ctx,i, "Error: specifying locants outside of allowed range"); 
             
             positional_locant = ch;
             locant_attached = ch;
@@ -3511,7 +4083,7 @@ character_start_ring:
         if (i == len-1){
           
           if(ring_components.empty())
-            return Fatal(i,"Error: error in reading ring components, check numerals in ring notation");
+            return Fatal(ctx,i,"Error: error in reading ring components, check numerals in ring notation");
           
           if (aromaticity.size() == 1 && aromaticity[0] == false){
             while(aromaticity.size() < ring_components.size())
@@ -3524,7 +4096,7 @@ character_start_ring:
 
           // perform the aromatic denotion check
           if (ring_components.size() != aromaticity.size())
-            return Fatal(i,"Error: mismatch between number of rings and aromatic assignments");
+            return Fatal(ctx,i,"Error: mismatch between number of rings and aromatic assignments");
           
           break;
         }
@@ -3535,7 +4107,7 @@ character_start_ring:
           else if (state_pseudo)
             pseudo_locants.push_back(ch);
           else
-            return Fatal(i,"Error: unhandled locant rule");
+            return Fatal(ctx,i,"Error: unhandled locant rule");
         
           positional_locant = ch; // use for look back
           locant_attached = ch;
@@ -3548,7 +4120,7 @@ character_start_ring:
         }
         else if(positional_locant && locant_attached){
           if(ring_components.empty())
-            return Fatal(i,"Error: assigning bridge locants without a ring");
+            return Fatal(ctx,i,"Error: assigning bridge locants without a ring");
           
           else
             bridge_locants[positional_locant] = true;
@@ -3559,7 +4131,7 @@ character_start_ring:
             locant_attached = ch;
           }
           else
-            return Fatal(i,"Error: symbol is in an unhandled state, please raise issue if this notation is 100%% correct");
+            return Fatal(ctx,i,"Error: symbol is in an unhandled state, please raise issue if this notation is 100%% correct");
         }
         break;
 
@@ -3570,12 +4142,12 @@ character_start_ring:
     ch = wln_block[++i];
   }
 
-  if(OPT_DEBUG && warned)
+  if(ctx.debug && warned)
     fprintf(stderr,"Warning: heterocyclic ring notation required for inter atom assignment, change starting 'L' to 'T'\n");
   
 
   // debug here
-  if (OPT_DEBUG){
+  if (ctx.debug){
     
     fprintf(stderr,"  ring components: ");
     for (std::pair<unsigned int, unsigned char> comp : ring_components){
@@ -3651,55 +4223,314 @@ character_start_ring:
     } 
 
   if (!final_size)
-    return Fatal(i, "Error: failed to build WLN cycle unit");
+    return Fatal(ctx,i, "Error: failed to build WLN cycle unit");
   
   if(!post_bond_handling(bond_modifiers, final_size, ring))
-    return Fatal(i, "Error: failed on post ring bond (un)/saturation");
+    return Fatal(ctx,i, "Error: failed on post ring bond (un)/saturation");
   
   return true;
 }
 
-bool multiply_carbon(WLNSymbol *sym){
-  if(!sym->parr_n || !sym->barr_n)
-    return false;
-  
-  WLNSymbol *back     = sym->prev_array[0].child; 
-  WLNEdge   *fedge    = &sym->bond_array[0];
-  
-  WLNSymbol *forward  = fedge->child;
-  WLNEdge *bedge = 0;
-  for(unsigned int ei=0;ei<back->barr_n;ei++){      
-    if(back->bond_array[ei].child == sym){
-      bedge = &back->bond_array[ei];
-      break;
-    }
-  }
+/**********************************************************************
+                         Ring Template Cache
+**********************************************************************/
 
-  if(!forward||!bedge)
-    return false;
-  
-  unsigned int back_edges = back->allowed_edges - back->num_edges; 
-  unsigned int forward_edges = forward->allowed_edges - forward->num_edges;
+/* a solved ring block, symbols are local to the template and edges refer to them
+ * by index. positions are stored relative to the start of the block */
+struct WLNTemplateSymbol{
+  unsigned char ch;
+  WLNSpecial special;
+  short charge;
+  unsigned int explicit_H;
+  bool aromatic;
+  bool spiro;
+  bool in_ring;
+  unsigned char allowed_edges;
+  unsigned char num_edges;
+  unsigned int str_position;
+  unsigned int ring_locant;
+  unsigned int ring_offset;
+  unsigned int first_edge; // forward edges, then prev edges
+  unsigned char barr_n;
+  unsigned char parr_n;
+};
 
-  // it seems to be the convention
-  // that if the forward facing symbol can take a triple bond, we do it
-  
-  // this cannot be done for alkyl numbers, so.. turn off the chain edges
-  if(back->ch == '#')
-    back_edges = 1;
-  if(forward->ch == '#')
-    forward_edges = 1;
+struct WLNTemplateEdge{
+  unsigned int child;
+  unsigned int reverse; // index of the matching edge in the childs prev list
+  unsigned char order;
+  unsigned char stereo;
+  bool aromatic;
+};
 
-  // experimental rule, if a triple bond will completely saturate an, atom, 
-  // we should always take it. 
+struct WLNRingTemplate{
+  std::vector<WLNTemplateSymbol> symbols;
+  std::vector<WLNTemplateEdge>   edges;
+  std::vector<int>               locants; // locant -> local symbol, -1 if empty
 
-  if(forward->num_edges== 1 && forward->num_edges+2 == forward->allowed_edges){
-    if(!unsaturate_edge(fedge,2))
-      return false;
-  }
-  else if(back->num_edges == 1 && back->num_edges+2 == back->allowed_edges){
-    if(!unsaturate_edge(bedge,2))
-      return false;
+  unsigned int rsize;
+  unsigned int aromatic_atoms;
+  unsigned int multi_points;
+  unsigned int pseudo_points;
+  unsigned int bridge_points;
+  std::vector<unsigned char> assignment_locants;
+  std::vector<unsigned int>   assignment_digits;
+  std::string str_notation;
+};
+
+/* process wide, templates are immutable once inserted and handed out as shared 
+ * pointers, so eviction never pulls one from under a reader */
+struct WLNRingCache{
+  std::mutex lock;
+  std::unordered_map<std::string,std::shared_ptr<const WLNRingTemplate>> templates;
+  std::deque<std::string> order; // insertion order, oldest evicted first
+  std::atomic<unsigned long> hits;
+  std::atomic<unsigned long> misses;
+
+  WLNRingCache():hits(0),misses(0){}
+
+  std::shared_ptr<const WLNRingTemplate> Find(const std::string &key){
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<std::string,std::shared_ptr<const WLNRingTemplate>>::iterator it = templates.find(key);
+    if(it == templates.end())
+      return std::shared_ptr<const WLNRingTemplate>();
+    return it->second;
+  }
+
+  void Insert(const std::string &key, std::shared_ptr<const WLNRingTemplate> ring_template){
+    std::lock_guard<std::mutex> guard(lock);
+    if(!templates.insert({key,ring_template}).second)
+      return; // another thread solved it first
+    order.push_back(key);
+    if(order.size() > RING_CACHE_SIZE){
+      templates.erase(order.front());
+      order.pop_front();
+    }
+  }
+};
+
+static WLNRingCache ring_cache; 
+
+/* snapshots the symbols [first, symbol_count) a block just created, returns null 
+ * if the block reached outside of itself and cannot be replayed */
+WLNRingTemplate *SnapshotWLNRing(WLNRing *ring, WLNGraph &graph, unsigned int first, unsigned int start){
+  WLNRingTemplate *t = new WLNRingTemplate;
+  unsigned int count = graph.symbol_count - first;
+
+  for(unsigned int s=0;s<count;s++){
+    WLNSymbol *sym = graph.SYMBOLS[first+s];
+    if(sym->inRing && sym->inRing != ring){
+      delete t;
+      return 0;
+    }
+
+    WLNTemplateSymbol ts;
+    ts.ch = sym->ch;
+    ts.special = sym->special;
+    ts.charge = sym->charge;
+    ts.explicit_H = sym->explicit_H;
+    ts.aromatic = sym->aromatic;
+    ts.spiro = sym->spiro;
+    ts.in_ring = sym->inRing != 0;
+    ts.allowed_edges = sym->allowed_edges;
+    ts.num_edges = sym->num_edges;
+    ts.str_position = sym->str_position ? sym->str_position - start : 0;
+    ts.ring_locant = ring->locants_ch[sym];
+    ts.ring_offset = ring->position_offset[sym];
+    if(ts.ring_offset)
+      ts.ring_offset -= start;
+    ts.first_edge = t->edges.size();
+    ts.barr_n = sym->barr_n;
+    ts.parr_n = sym->parr_n;
+
+    for(unsigned int ei=0;ei<sym->barr_n + sym->parr_n;ei++){
+      WLNEdge *e = ei < sym->barr_n ? &sym->bond_array[ei] : &sym->prev_array[ei-sym->barr_n];
+      if(e->child->id < first || e->child->id >= graph.symbol_count){
+        delete t;
+        return 0;
+      }
+
+      WLNTemplateEdge te;
+      te.child = e->child->id - first;
+      te.reverse = 0;
+      te.order = e->order;
+      te.stereo = e->stereo;
+      te.aromatic = e->aromatic;
+      if(ei < sym->barr_n){
+        for(unsigned int r=0;r<e->child->parr_n;r++){
+          if(&e->child->prev_array[r] == e->reverse)
+            te.reverse = r;
+        }
+      }
+      t->edges.push_back(te);
+    }
+    t->symbols.push_back(ts);
+  }
+
+  if(!ring->locants.sparse.empty()){
+    delete t;
+    return 0;
+  }
+
+  for(unsigned int loc=0;loc<ring->locants.table.size();loc++){
+    WLNSymbol *sym = ring->locants.table[loc];
+    if(sym && (sym->id < first || sym->id >= graph.symbol_count)){
+      delete t;
+      return 0;
+    }
+    t->locants.push_back(sym ? (int)(sym->id - first) : -1);
+  }
+
+  t->rsize = ring->rsize;
+  t->aromatic_atoms = ring->aromatic_atoms;
+  t->multi_points = ring->multi_points;
+  t->pseudo_points = ring->pseudo_points;
+  t->bridge_points = ring->bridge_points;
+  t->assignment_locants = ring->assignment_locants;
+  t->assignment_digits = ring->assignment_digits;
+  t->str_notation = ring->str_notation;
+  return t;
+}
+
+/* rebuilds a cached block into the graph, in the same allocation and edge order 
+ * the solver would have produced */
+void InstantiateWLNRing(const WLNRingTemplate *t, WLNRing *ring, WLNGraph &graph, unsigned int start){
+  unsigned int first = graph.symbol_count;
+  for(unsigned int s=0;s<t->symbols.size();s++){
+    const WLNTemplateSymbol &ts = t->symbols[s];
+    WLNSymbol *sym = AllocateWLNSymbol(ts.ch,graph);
+    sym->special = ts.special;
+    sym->charge = ts.charge;
+    sym->explicit_H = ts.explicit_H;
+    sym->aromatic = ts.aromatic;
+    sym->spiro = ts.spiro;
+    sym->inRing = ts.in_ring ? ring : 0;
+    sym->allowed_edges = ts.allowed_edges;
+    sym->num_edges = ts.num_edges;
+    sym->str_position = ts.str_position ? ts.str_position + start : 0;
+  }
+
+  for(unsigned int s=0;s<t->symbols.size();s++){
+    const WLNTemplateSymbol &ts = t->symbols[s];
+    WLNSymbol *sym = graph.SYMBOLS[first+s];
+    
+    for(unsigned int ei=0;ei<ts.barr_n + ts.parr_n;ei++){
+      const WLNTemplateEdge &te = t->edges[ts.first_edge + ei];
+      WLNEdge *e = 0; 
+      if(ei < ts.barr_n)
+        e = sym->bond_array.append(sym->barr_n++,sym->edge_pool);
+      else
+        e = sym->prev_array.append(sym->parr_n++,sym->edge_pool);
+      e->parent = sym;
+      e->child = graph.SYMBOLS[first + te.child];
+      e->order = te.order;
+      e->stereo = te.stereo;
+      e->aromatic = te.aromatic;
+    }
+  }
+
+  // prev lists are complete, so forward edges can now find their reverse
+  for(unsigned int s=0;s<t->symbols.size();s++){
+    const WLNTemplateSymbol &ts = t->symbols[s];
+    WLNSymbol *sym = graph.SYMBOLS[first+s];
+    for(unsigned int ei=0;ei<ts.barr_n;ei++){
+      WLNEdge *e = &sym->bond_array[ei];
+      e->reverse = &e->child->prev_array[t->edges[ts.first_edge + ei].reverse];
+      e->reverse->reverse = e;
+    }
+  }
+
+  for(unsigned int loc=0;loc<t->locants.size();loc++){
+    if(t->locants[loc] >= 0)
+      ring->locants[loc] = graph.SYMBOLS[first + t->locants[loc]];
+  }
+
+  for(unsigned int s=0;s<t->symbols.size();s++){
+    const WLNTemplateSymbol &ts = t->symbols[s];
+    WLNSymbol *sym = graph.SYMBOLS[first+s];
+    if(ts.ring_locant)
+      ring->locants_ch[sym] = ts.ring_locant;
+    if(ts.ring_offset)
+      ring->position_offset[sym] = ts.ring_offset + start;
+  }
+
+  ring->rsize = t->rsize;
+  ring->aromatic_atoms = t->aromatic_atoms;
+  ring->multi_points = t->multi_points;
+  ring->pseudo_points = t->pseudo_points;
+  ring->bridge_points = t->bridge_points;
+  ring->assignment_locants = t->assignment_locants;
+  ring->assignment_digits = t->assignment_digits;
+  ring->str_notation = t->str_notation;
+}
+
+/* ring blocks recur constantly, so solved blocks are replayed from the cache. 
+ * spiro blocks share an atom with the previous ring and always go to the solver */
+bool FormWLNRing(WLNRing *ring, const char *wln_block,unsigned int i, unsigned int len,WLNGraph &graph,WLNContext &ctx,unsigned char spiro_atom='\0'){
+  if(spiro_atom || ctx.debug || len <= i)
+    return SolveWLNRing(ring,wln_block,i,len,graph,ctx,spiro_atom);
+
+  std::string key(wln_block+i,len-i);
+  std::shared_ptr<const WLNRingTemplate> cached = ring_cache.Find(key);
+  if(cached){
+    ring_cache.hits++;
+    InstantiateWLNRing(cached.get(),ring,graph,i);
+    return true;
+  }
+
+  ring_cache.misses++;
+  unsigned int first = graph.symbol_count;
+  if(!SolveWLNRing(ring,wln_block,i,len,graph,ctx,spiro_atom))
+    return false;
+
+  WLNRingTemplate *solved = SnapshotWLNRing(ring,graph,first,i);
+  if(solved)
+    ring_cache.Insert(key,std::shared_ptr<const WLNRingTemplate>(solved));
+  return true;
+}
+
+
+bool multiply_carbon(WLNSymbol *sym){
+  if(!sym->parr_n || !sym->barr_n)
+    return false;
+  
+  WLNSymbol *back     = sym->prev_array[0].child; 
+  WLNEdge   *fedge    = &sym->bond_array[0];
+  
+  WLNSymbol *forward  = fedge->child;
+  WLNEdge *bedge = 0;
+  for(unsigned int ei=0;ei<back->barr_n;ei++){      
+    if(back->bond_array[ei].child == sym){
+      bedge = &back->bond_array[ei];
+      break;
+    }
+  }
+
+  if(!forward||!bedge)
+    return false;
+  
+  unsigned int back_edges = back->allowed_edges - back->num_edges; 
+  unsigned int forward_edges = forward->allowed_edges - forward->num_edges;
+
+  // it seems to be the convention
+  // that if the forward facing symbol can take a triple bond, we do it
+  
+  // this cannot be done for alkyl numbers, so.. turn off the chain edges
+  if(back->ch == '#')
+    back_edges = 1;
+  if(forward->ch == '#')
+    forward_edges = 1;
+
+  // experimental rule, if a triple bond will completely saturate an, atom, 
+  // we should always take it. 
+
+  if(forward->num_edges== 1 && forward->num_edges+2 == forward->allowed_edges){
+    if(!unsaturate_edge(fedge,2))
+      return false;
+  }
+  else if(back->num_edges == 1 && back->num_edges+2 == back->allowed_edges){
+    if(!unsaturate_edge(bedge,2))
+      return false;
   }
   else{
     // first cases, forward edges force the triple
@@ -3771,20 +4602,20 @@ bool ResolveHangingBonds(WLNGraph &graph){
 
 
 /* must be performed before sending to obabel graph*/
-bool ExpandWLNSymbols(WLNGraph &graph, unsigned int len){
+bool ExpandWLNSymbols(WLNGraph &graph, WLNContext &ctx, unsigned int len){
 
   unsigned int stop = graph.symbol_count;
   // dioxo must be handled before 
   for (unsigned int i=0;i<stop;i++){
     WLNSymbol *sym = graph.SYMBOLS[i];
     if(sym->ch == 'W' && !add_dioxo(sym,graph))
-      return Fatal(len, "Error: failed on past handling of W dioxo symbol");
+      return Fatal(ctx,len, "Error: failed on past handling of W dioxo symbol");
 
     // unsaturated carbons with C
     if(sym->ch == 'c'){
       sym->ch = 'C';
       if(!multiply_carbon(sym))
-        return Fatal(len,"Error: failed on post handling of multiplier carbon");
+        return Fatal(ctx,len,"Error: failed on post handling of multiplier carbon");
     }
   }
 
@@ -3797,7 +4628,7 @@ bool ExpandWLNSymbols(WLNGraph &graph, unsigned int len){
       case 'X':
       case 'K':
         if(!resolve_methyls(sym,graph))
-          return Fatal(len,"Error: failed on post handling of undefined methyl groups");
+          return Fatal(ctx,len,"Error: failed on post handling of undefined methyl groups");
         break;
 
       case 'V':{
@@ -3809,10 +4640,10 @@ bool ExpandWLNSymbols(WLNGraph &graph, unsigned int len){
         
         WLNEdge *e = AddEdge(oxygen, sym);
         if(!e)
-          return Fatal(len,"Error: failed on post expansion on 'V' symbol - edge creation");
+          return Fatal(ctx,len,"Error: failed on post expansion on 'V' symbol - edge creation");
       
         if(!unsaturate_edge(e,1))
-          return Fatal(len,"Error: failed on post expansion on 'V' symbol - unsaturation");
+          return Fatal(ctx,len,"Error: failed on post expansion on 'V' symbol - unsaturation");
         
         break;
       }
@@ -3977,15 +4808,324 @@ bool WLNRingBPMaxMatching(WLNRing *ring, int *MatchR){
   return true;
 }
 
+/* sparse adjacency over the ring positions that can take a double bond, used for
+ * rings too large for the dense matrix. buffers live per thread and are only ever
+ * grown, so rings and molecules after the first allocate nothing */
+struct WLNKekuleGraph{
+  unsigned int n; 
+  std::vector<unsigned int> edges;  // pairs, flattened
+  std::vector<unsigned int> start;  // csr offsets into adj
+  std::vector<unsigned int> adj;
+  std::vector<int> mate;
+
+  // search state, shared by hopcroft-karp and the blossom
+  std::vector<int> dist;
+  std::vector<int> parent;
+  std::vector<int> base;
+  std::vector<unsigned int> queue; 
+  std::vector<unsigned int> stamp;
+  std::vector<bool> used;
+  std::vector<bool> blossom;
+  unsigned int epoch;
+
+  WLNKekuleGraph(){
+    n = 0;
+    epoch = 0;
+  }
+
+  /* same positions and bonds FillAdjMatrix would mark */
+  void Fill(WLNRing *ring){
+    n = ring->rsize;
+    edges.clear();
+    ring->aromatic_atoms = 0;
+
+    for (unsigned int r = 0; r< n;r++){
+      WLNSymbol *rsym = ring->locants[INT_TO_LOCANT(r+1)]; 
+      if(!rsym || rsym->ch == 'S' || !rsym->aromatic || rsym->num_edges >= rsym->allowed_edges)
+        continue;
+      
+      for(unsigned int ei = 0;ei < rsym->barr_n;ei++){
+        WLNEdge *redge = &rsym->bond_array[ei];
+        WLNSymbol *csym = redge->child; 
+        if(csym->ch == 'S' || redge->order > 1)
+          continue;
+        
+        if(csym->aromatic && redge->aromatic && csym->num_edges < csym->allowed_edges){
+          unsigned int c = LOCANT_TO_INT(ring->locants_ch[csym]-1);
+          if(c >= n)
+            continue;
+          edges.push_back(r);
+          edges.push_back(c);
+          ring->aromatic_atoms++;
+        }
+      }
+    }
+
+    start.assign(n+1,0);
+    for(unsigned int e=0;e<edges.size();e++)
+      start[edges[e]+1]++;
+    for(unsigned int u=0;u<n;u++)
+      start[u+1] += start[u];
+
+    adj.resize(edges.size());
+    stamp.assign(n,0); // fill positions
+    for(unsigned int e=0;e<edges.size();e+=2){
+      unsigned int u = edges[e];
+      unsigned int v = edges[e+1];
+      adj[start[u] + stamp[u]++] = v;
+      adj[start[v] + stamp[v]++] = u;
+    }
+
+    mate.assign(n,-1);
+    dist.resize(n);
+    parent.resize(n);
+    base.resize(n);
+    queue.resize(n);
+    used.resize(n);
+    blossom.resize(n);
+    stamp.assign(n,0);
+  }
+
+  /* two colours, -1 unseen, checked over every component */
+  bool Bipartite(){
+    for(unsigned int i=0;i<n;i++)
+      dist[i] = -1;
+    
+    for(unsigned int s=0;s<n;s++){
+      if(dist[s] >= 0)
+        continue;
+      unsigned int head = 0;
+      unsigned int tail = 0;
+      dist[s] = 0;
+      queue[tail++] = s;
+      while(head < tail){
+        unsigned int u = queue[head++];
+        for(unsigned int k=start[u];k<start[u+1];k++){
+          unsigned int v = adj[k];
+          if(dist[v] < 0){
+            dist[v] = 1 - dist[u];
+            queue[tail++] = v;
+          }
+          else if(dist[v] == dist[u])
+            return false;
+        }
+      }
+    }
+
+    // hopcroft-karp wants the colours, keep them in parent
+    for(unsigned int i=0;i<n;i++)
+      parent[i] = dist[i];
+    return true;
+  }
+
+  void Greedy(){
+    for(unsigned int u=0;u<n;u++){
+      if(mate[u] >= 0)
+        continue;
+      for(unsigned int k=start[u];k<start[u+1];k++){
+        unsigned int v = adj[k];
+        if(mate[v] < 0){
+          mate[u] = v;
+          mate[v] = u;
+          break;
+        }
+      }
+    }
+  }
+
+  /* layers free colour 0 vertices, true if a free colour 1 vertex is reachable */
+  bool HKLayer(){
+    unsigned int head = 0;
+    unsigned int tail = 0;
+    bool found = false;
+
+    for(unsigned int u=0;u<n;u++){
+      if(parent[u] == 0 && mate[u] < 0){
+        dist[u] = 0;
+        queue[tail++] = u;
+      }
+      else
+        dist[u] = -1;
+    }
+
+    while(head < tail){
+      unsigned int u = queue[head++];
+      for(unsigned int k=start[u];k<start[u+1];k++){
+        int w = mate[adj[k]];
+        if(w < 0)
+          found = true;
+        else if(dist[w] < 0){
+          dist[w] = dist[u] + 1;
+          queue[tail++] = w;
+        }
+      }
+    }
+    return found;
+  }
+
+  bool HKAugment(unsigned int u){
+    for(unsigned int k=start[u];k<start[u+1];k++){
+      unsigned int v = adj[k];
+      int w = mate[v];
+      if(w < 0 || (dist[w] == dist[u] + 1 && HKAugment(w))){
+        mate[u] = v;
+        mate[v] = u;
+        return true;
+      }
+    }
+    dist[u] = -1; // dead end for this phase
+    return false;
+  }
+
+  void HopcroftKarp(){
+    Greedy();
+    while(HKLayer()){
+      for(unsigned int u=0;u<n;u++){
+        if(parent[u] == 0 && mate[u] < 0)
+          HKAugment(u);
+      }
+    }
+  }
+
+  int LowestAncestor(int a, int b){
+    if(++epoch == 0){ // wrapped, Fill zeroes stamps so they would read as seen
+      std::fill(stamp.begin(),stamp.end(),0);
+      epoch = 1;
+    }
+    for(;;){
+      a = base[a];
+      stamp[a] = epoch;
+      if(mate[a] < 0)
+        break;
+      a = parent[mate[a]];
+    }
+    for(;;){
+      b = base[b];
+      if(stamp[b] == epoch)
+        return b;
+      b = parent[mate[b]];
+    }
+  }
+
+  void MarkPath(int v, int b, int child){
+    while(base[v] != b){
+      blossom[base[v]] = true;
+      blossom[base[mate[v]]] = true;
+      parent[v] = child;
+      child = mate[v];
+      v = parent[mate[v]];
+    }
+  }
+
+  /* edmonds search from one free vertex, returns the free end of an augmenting path */
+  int FindPath(unsigned int root){
+    for(unsigned int i=0;i<n;i++){
+      used[i] = false;
+      parent[i] = -1;
+      base[i] = i;
+    }
+
+    unsigned int head = 0;
+    unsigned int tail = 0;
+    used[root] = true;
+    queue[tail++] = root;
+
+    while(head < tail){
+      int v = queue[head++];
+      for(unsigned int k=start[v];k<start[v+1];k++){
+        int to = adj[k];
+        if(base[v] == base[to] || mate[v] == to)
+          continue;
+        
+        if(to == (int)root || (mate[to] >= 0 && parent[mate[to]] >= 0)){
+          int b = LowestAncestor(v,to);
+          for(unsigned int i=0;i<n;i++)
+            blossom[i] = false;
+          MarkPath(v,b,to);
+          MarkPath(to,b,v);
+          for(unsigned int i=0;i<n;i++){
+            if(blossom[base[i]]){
+              base[i] = b;
+              if(!used[i]){
+                used[i] = true;
+                queue[tail++] = i;
+              }
+            }
+          }
+        }
+        else if(parent[to] < 0){
+          parent[to] = v;
+          if(mate[to] < 0)
+            return to;
+          used[mate[to]] = true;
+          queue[tail++] = mate[to];
+        }
+      }
+    }
+    return -1;
+  }
+
+  void Blossom(){
+    Greedy();
+    for(unsigned int u=0;u<n;u++){
+      if(mate[u] >= 0)
+        continue;
+      int v = FindPath(u);
+      while(v >= 0){
+        int pv = parent[v];
+        int next = mate[pv];
+        mate[v] = pv;
+        mate[pv] = v;
+        v = next;
+      }
+    }
+  }
+
+  void Match(){
+    if(Bipartite()){
+      StatsMatcher(WLN_MATCH_SPARSE_BIPARTITE);
+      HopcroftKarp();
+    }
+    else{
+      StatsMatcher(WLN_MATCH_SPARSE_BLOSSOM);
+      Blossom();
+    }
+  }
+};
+
+/* sparse kekulize for a single ring, the maximum matching becomes the double bonds */
+bool WLNSparseKekulize(WLNRing *ring){
+  static thread_local WLNKekuleGraph kekule;
+  kekule.Fill(ring);
+  kekule.Match();
+
+  for(unsigned int u=0;u<kekule.n;u++){
+    if(kekule.mate[u] <= (int)u)
+      continue;
+    
+    WLNSymbol *f = ring->locants[INT_TO_LOCANT(u+1)];
+    WLNSymbol *s = ring->locants[INT_TO_LOCANT(kekule.mate[u]+1)];
+    WLNEdge *edge = search_edge(f,s);
+    if(edge && edge->order == 1 && !unsaturate_edge(edge,1))
+      return false;
+  }
+  return true;
+}
+
 /* provides methods for `kekulising` wln ring structures, using blossums to maximise pairs */
-bool WLNKekulize(WLNGraph &graph){
+bool WLNKekulize(WLNGraph &graph, WLNContext &ctx){
   for(unsigned int i=0;i<graph.ring_count;i++){
     WLNRing *wring = graph.RINGS[i]; 
-    if(wring->aromatic_atoms){
+    if(wring->aromatic_atoms && wring->rsize > DENSE_KEKULE_LIMIT){
+      if(!WLNSparseKekulize(wring))
+        return Fatal(ctx,ctx.len,"Error: failed to kekulize mol");
+    }
+    else if(wring->aromatic_atoms){
+      StatsMatcher(WLN_MATCH_DENSE);
 
       int   *MatchR = (int*)malloc(sizeof(int) * wring->rsize);
       if(!wring->FillAdjMatrix() || !MatchR)
-        return false;
+        return Fatal(ctx,ctx.len,"Error: failed to kekulize mol");
       
 
       for (unsigned int i=0;i<wring->rsize;i++)
@@ -3996,7 +5136,7 @@ bool WLNKekulize(WLNGraph &graph){
         if(MatchR)
           free(MatchR);
         MatchR = 0;
-        return false;
+        return Fatal(ctx,ctx.len,"Error: failed to kekulize mol");
       }
       else{
         WLNBlossom B(wring->rsize);
@@ -4028,10 +5168,11 @@ bool WLNKekulize(WLNGraph &graph){
           if(f && s){
             WLNEdge *edge = search_edge(f,s);
             if(edge && edge->order == 1 && !unsaturate_edge(edge,1))
-              return false;
+              return Fatal(ctx,ctx.len,"Error: failed to kekulize mol");
           }
         }
-        MatchR[MatchR[i]] = 0; // remove from matching
+        if(MatchR[i] >= 0)
+          MatchR[MatchR[i]] = 0; // remove from matching
       }
       
       if(MatchR)
@@ -4044,16 +5185,57 @@ bool WLNKekulize(WLNGraph &graph){
   return true;
 }
 
+/**********************************************************************
+                         Syntax Pre Check
+**********************************************************************/
+
+#ifdef WLN_DFA_TABLE
+#include "wlndfa_table.h" // written by wlndfagen at build time
+#endif
+
+/* walks the wlngrep machine baked in by wlndfagen, pos is where it stopped. 
+ * the machine is the grep grammar, a few notations the parser reads are 
+ * outside it, so this filters rather than validates. true when built without
+ * the table */
+bool WLNSyntaxCheck(const char *ptr, unsigned int *pos)
+{
+  *pos = 0;
+#ifdef WLN_DFA_TABLE
+  unsigned int state = 0;
+  unsigned int i = 0;
+  for(;ptr[i];i++){
+    unsigned char ch = ptr[i];
+    if(wln_dfa_next[state]['*'] != WLN_DFA_DEAD)
+      ch = '*'; // notes after ' &&' take anything
+    
+    unsigned int next = ch < WLN_DFA_COLUMNS ? wln_dfa_next[state][ch] : WLN_DFA_DEAD;
+    if(next == WLN_DFA_DEAD)
+      break;
+    state = next;
+  }
+
+  *pos = i;
+  if(ptr[i] || !wln_dfa_accept[state]){
+#if ERRORS == 1
+    fprintf(stderr,"Error: wln syntax %s at position %u\n",ptr[i] ? "rejected":"incomplete",i);
+#endif
+    return false;
+  }
+#endif
+  return true;
+}
+
+
 /**********************************************************************
                          High Level Parser Functions
 **********************************************************************/
 
 
 /* returns the head of the graph, parse all normal notation */
-bool ParseWLNString(const char *wln_ptr, WLNGraph &graph) 
+bool ParseWLNString(const char *wln_ptr, WLNGraph &graph, WLNContext &ctx) 
 {
   // keep the memory alive
-  if (OPT_DEBUG)
+  if (ctx.debug)
     fprintf(stderr, "Parsing WLN notation: %s\n",wln_ptr);
 
   ObjectStack branch_stack;   // access to both rings and symbols
@@ -4134,14 +5316,14 @@ character_start:
         
         edge = AddEdge(curr, prev); 
         if(!edge)
-          return Fatal(i, "Error: failed to bond to previous symbol");
+          return Fatal(ctx,i, "Error: failed to bond to previous symbol");
         
         edge->stereo = pending_stereo; 
         pending_stereo = 0; 
 
         if(inline_unsaturate){
           if(!unsaturate_edge(edge,inline_unsaturate))
-            return Fatal(i, "Error: failed to unsaturate bond"); 
+            return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
           inline_unsaturate = 0;
         }
       }
@@ -4185,7 +5367,7 @@ character_start:
       if(pending_J_closure){
         if(pending_locant_skips){
           if(d1 && d2 && d3)
-            return Fatal(i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
+            return Fatal(ctx,i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
           else if (d1 && d2)
             d3 = ch; 
           else if(d1)
@@ -4207,7 +5389,7 @@ character_start:
       }
       else if (pending_numbers || pending_negative_charge || cleared){
         if(d1 && d2 && d3)
-          return Fatal(i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
+          return Fatal(ctx,i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
         else if (d1 && d2)
           d3 = ch; 
         else if(d1)
@@ -4220,7 +5402,7 @@ character_start:
         break;
       }
       else
-        return Fatal(i,"Error: a lone zero mark is not allowed without positive numerals either side");
+        return Fatal(ctx,i,"Error: a lone zero mark is not allowed without positive numerals either side");
       
       break;
 
@@ -4241,7 +5423,7 @@ character_start:
         
         if(pending_locant_skips){
           if(d1 && d2 && d3)
-            return Fatal(i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
+            return Fatal(ctx,i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
           else if (d1 && d2)
             d3 = ch; 
           else if(d1)
@@ -4252,7 +5434,7 @@ character_start:
         break;
       }
       else if(pending_locant){  // handle all multiplier contractions
-        return Fatal(i,"Error: multipliers are not currently supported");
+        return Fatal(ctx,i,"Error: multipliers are not currently supported");
         pending_locant = false;
         on_locant = ch;
       }
@@ -4261,14 +5443,14 @@ character_start:
         if(on_locant != '0'){
           curr = wrap_ring->locants[on_locant];
           if(!curr)
-            return Fatal(i,"Error: cannot access looping ring structure");
+            return Fatal(ctx,i,"Error: cannot access looping ring structure");
           
           
           if(prev){
     
             edge = AddEdge(curr, prev); 
             if(!edge)
-              return Fatal(i, "Error: failed to bond to previous symbol");
+              return Fatal(ctx,i, "Error: failed to bond to previous symbol");
             
             wrap_ring->macro_return = edge; 
             
@@ -4277,13 +5459,13 @@ character_start:
 
             if(inline_unsaturate){
               if(!unsaturate_edge(edge,inline_unsaturate))
-                return Fatal(i, "Error: failed to unsaturate bond"); 
+                return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
               inline_unsaturate = 0;
             }
 
           }
           else
-            return Fatal(i,"Error: no previous symbol for inline ring defintion");
+            return Fatal(ctx,i,"Error: no previous symbol for inline ring defintion");
 
           on_locant = '\0';
         }
@@ -4302,7 +5484,7 @@ character_start:
       }
       else {
         if(d1 && d2 && d3)
-          return Fatal(i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
+          return Fatal(ctx,i, "Error: specifying a number greater than 3 digits - WLN isn't meant for this!");
         else if (d1 && d2)
           d3 = ch; 
         else if(d1)
@@ -4326,7 +5508,7 @@ character_start:
         break;
       }
       else if (pending_locant)
-        return Fatal(i,"Error: 'Y' cannot be a locant assignment, please expand [A-W] with &\n");
+        return Fatal(ctx,i,"Error: 'Y' cannot be a locant assignment, please expand [A-W] with &\n");
       else
       {
         on_locant = '\0';
@@ -4341,14 +5523,14 @@ character_start:
 
           edge =AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "Error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -4368,7 +5550,7 @@ character_start:
         break;
       }
       else if (pending_locant){
-        return Fatal(i, "Error: Wiswesser Uncertainities lead to runaway outcomings");
+        return Fatal(ctx,i, "Error: Wiswesser Uncertainities lead to runaway outcomings");
       }
       else
       {
@@ -4384,13 +5566,13 @@ character_start:
 
           edge = AddEdge(curr, prev);
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "Error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -4416,7 +5598,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           ring->loc_count++;  
           prev = curr;
           last = prev; 
@@ -4439,13 +5621,13 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "Error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -4468,7 +5650,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4493,13 +5675,13 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "Error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -4527,7 +5709,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4548,12 +5730,12 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           } 
         }
@@ -4576,7 +5758,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4599,15 +5781,15 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(!unsaturate_edge(edge, 2))
-            return Fatal(i, "Error: failed to attach W symbol"); 
+            return Fatal(ctx,i, "Error: failed to attach W symbol"); 
 
           if(inline_unsaturate)
-            return Fatal(i,"Error: a bond unsaturation followed by dioxo is undefined notation");
+            return Fatal(ctx,i,"Error: a bond unsaturation followed by dioxo is undefined notation");
         }
         else
           inline_unsaturate = 2;
@@ -4640,7 +5822,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4666,12 +5848,12 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -4697,7 +5879,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4721,12 +5903,12 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){ 
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -4751,7 +5933,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
         
           ring->loc_count++;  
           prev = curr;
@@ -4772,13 +5954,13 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
 
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
           
@@ -4803,7 +5985,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4825,12 +6007,12 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
           
@@ -4862,7 +6044,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4882,13 +6064,13 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -4916,7 +6098,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4939,12 +6121,12 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }         
@@ -4969,7 +6151,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -4996,12 +6178,12 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -5025,7 +6207,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -5052,13 +6234,13 @@ character_start:
           
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "Error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -5076,12 +6258,12 @@ character_start:
 
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "Error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -5106,7 +6288,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
 
           ring->loc_count++;  
           prev = curr;
@@ -5120,7 +6302,7 @@ character_start:
 #if MODERN
         pending_stereo = 2; 
 #else
-        return Fatal(i,"Error: locant only symbol used in atomic definition");
+        return Fatal(ctx,i,"Error: locant only symbol used in atomic definition");
 #endif
       }
       cleared = false;
@@ -5139,7 +6321,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -5167,7 +6349,7 @@ character_start:
           pending_inline_ring = true;
 
         if (!pending_inline_ring)
-          return Fatal(i,"Error: chelating ring notation started without '-' denotion");
+          return Fatal(ctx,i,"Error: chelating ring notation started without '-' denotion");
         
         
         pending_inline_ring = false;
@@ -5192,7 +6374,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -5220,7 +6402,7 @@ character_start:
           curr->str_position = i+1;
           curr->allowed_edges = 1;
           if(!AddEdge(curr, prev)) 
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           prev = curr; 
           last = curr; 
         }
@@ -5247,7 +6429,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           last = curr; 
@@ -5267,7 +6449,7 @@ character_start:
           if(pending_spiro){
             
             if(!prev)
-              Fatal(i,"Error: sprio notation opened without a previous atom");
+              Fatal(ctx,i,"Error: sprio notation opened without a previous atom");
             else{
               ring->locants[on_locant] = prev;
               ring->locants_ch[prev] = on_locant; 
@@ -5283,7 +6465,7 @@ character_start:
                 e = &prev->bond_array[ei];
                 if (e->order == 2){
                   if(!saturate_edge(e,1))
-                    return Fatal(i, "Error: could not shift aromaticity for spiro ring addition");
+                    return Fatal(ctx,i, "Error: could not shift aromaticity for spiro ring addition");
 
                   shift = e->child;
                   break;
@@ -5291,7 +6473,7 @@ character_start:
               }
 
               if(!branch_stack.ring)
-                return Fatal(i, "Error: ring stack is empty, nothing to fetch");
+                return Fatal(ctx,i, "Error: ring stack is empty, nothing to fetch");
 
               unsigned char next_loc = branch_stack.ring->locants_ch[shift]+1;
               if(!next_loc)
@@ -5299,15 +6481,15 @@ character_start:
 
               e = search_edge(branch_stack.ring->locants[next_loc],shift);
               if(!e && !unsaturate_edge(e, 1))
-                return Fatal(i, "Error: failed to re-aromatise previous ring");
+                return Fatal(ctx,i, "Error: failed to re-aromatise previous ring");
             }
             
             // +1 gets the J included
-            if(!FormWLNRing(ring,wln_ptr,block_start,i+1,graph,on_locant))
+            if(!FormWLNRing(ring,wln_ptr,block_start,i+1,graph,ctx,on_locant))
               return false;
           }
           else{
-            if(!FormWLNRing(ring,wln_ptr,block_start,i+1,graph))
+            if(!FormWLNRing(ring,wln_ptr,block_start,i+1,graph,ctx))
               return false;
           }
           
@@ -5328,19 +6510,19 @@ character_start:
                       
               edge = AddEdge(ring->locants[on_locant], prev); 
               if(!edge)
-                return Fatal(i, "Error: failed to bond to previous symbol");
+                return Fatal(ctx,i, "Error: failed to bond to previous symbol");
               edge->stereo = pending_stereo; 
               pending_stereo = 0; 
 
               if(inline_unsaturate){
                 if(!unsaturate_edge(edge,inline_unsaturate))
-                  return Fatal(i, "Error: failed to unsaturate bond"); 
+                  return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
                 inline_unsaturate = 0;
               }
               ring->loc_count++; //in-line locant assumed
             }   
             else
-              return Fatal(i,"Error: attaching inline ring with out of bounds locant assignment");
+              return Fatal(ctx,i,"Error: attaching inline ring with out of bounds locant assignment");
             
           }
           
@@ -5367,7 +6549,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -5393,7 +6575,7 @@ character_start:
           pending_inline_ring = true;
           
         if (!pending_inline_ring)
-          return Fatal(i,"Error: ring notation started without '-' denotion");
+          return Fatal(ctx,i,"Error: ring notation started without '-' denotion");
         
         
         pending_inline_ring = false;
@@ -5416,7 +6598,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -5431,20 +6613,20 @@ character_start:
         ring = AllocateWLNRing(graph);
 
         const char* benzyl = "L6J";
-        FormWLNRing(ring,benzyl,0,3,graph);
+        FormWLNRing(ring,benzyl,0,3,graph,ctx);
         branch_stack.push({ring,0});
 
         curr = ring->locants['A'];
         if(prev){
           edge = AddEdge(curr, prev); 
           if(!edge)
-            return Fatal(i, "Error: failed to bond to previous symbol");
+            return Fatal(ctx,i, "Error: failed to bond to previous symbol");
           edge->stereo = pending_stereo; 
           pending_stereo = 0; 
 
           if(inline_unsaturate){
             if(!unsaturate_edge(edge,inline_unsaturate))
-              return Fatal(i, "Error: failed to unsaturate bond"); 
+              return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
             inline_unsaturate = 0;
           }
         }
@@ -5470,7 +6652,7 @@ character_start:
           ring = branch_stack.ring;
           curr = ring->locants[ch];
           if(!curr)
-            return Fatal(i,"Error: accessing locants out of range");
+            return Fatal(ctx,i,"Error: accessing locants out of range");
           
           ring->loc_count++;  
           prev = curr;
@@ -5480,7 +6662,7 @@ character_start:
         on_locant = ch;
       }
       else if(cleared)
-        return Fatal(i, "Error: floating double bond after ionic clear");
+        return Fatal(ctx,i, "Error: floating double bond after ionic clear");
       
       else{
         on_locant = '\0';
@@ -5515,23 +6697,22 @@ character_start:
         d3=0;
         
         if(negative_index < 0)
-          return Fatal(i, "Error: assigning non-numerical value to charge index");
+          return Fatal(ctx,i, "Error: assigning non-numerical value to charge index");
         else if(negative_index != 0){
           // find the symbol and increment its charge + 1
           bool found = false;
           for(unsigned int cs = 0;cs<graph.symbol_count;cs++){
             if(graph.SYMBOLS[cs]->str_position == (unsigned int)negative_index){
               graph.SYMBOLS[cs]->charge--; 
-#if OPT_DEBUG
-              fprintf(stderr,"  assigning %c charge %d\n",graph.SYMBOLS[cs]->ch,graph.SYMBOLS[cs]->charge); 
-#endif
+              if(ctx.debug)
+                fprintf(stderr,"  assigning %c charge %d\n",graph.SYMBOLS[cs]->ch,graph.SYMBOLS[cs]->charge); 
               found = true;
               break;
             }
           }
           
           if(!found)
-            return Fatal(i, "Error: negative charge index out of range, check letter index");
+            return Fatal(ctx,i, "Error: negative charge index out of range, check letter index");
         }
         pending_negative_charge = false;
       }
@@ -5545,7 +6726,7 @@ character_start:
         // single letter methyl branches
         if(on_locant && !pending_inline_ring){
           if(!branch_stack.ring || !add_methyl(branch_stack.ring->locants[on_locant],graph))
-            return Fatal(i, "Error: could not attach implied methyl to ring");
+            return Fatal(ctx,i, "Error: could not attach implied methyl to ring");
           
           branch_stack.ring->loc_count++;  
           on_locant = '\0';
@@ -5553,7 +6734,7 @@ character_start:
         
       }
       else
-        return Fatal(i, "Error: space used outside ring and ionic notation");
+        return Fatal(ctx,i, "Error: space used outside ring and ionic notation");
       
       // only burn the stacks now on ionic clearance
       break;
@@ -5578,7 +6759,7 @@ character_start:
           on_locant += AMPERSAND_EXPAND;
           curr = ring->locants[on_locant];  
           if(!curr)
-            return Fatal(i, "Error: could not fetch expanded locant position - out of range");
+            return Fatal(ctx,i, "Error: could not fetch expanded locant position - out of range");
           
           prev = curr;
           last = curr; 
@@ -5607,7 +6788,7 @@ character_start:
               case 'K':
                 if( (prev->num_edges + prev->explicit_H) < prev->allowed_edges){
                   if(!add_methyl(prev,graph))
-                    return Fatal(i, "Error: failed to add methyl group on methyl contraction");
+                    return Fatal(ctx,i, "Error: failed to add methyl group on methyl contraction");
                 
                   prev = return_object_symbol(branch_stack); // if its the last one pop it 
                 }
@@ -5620,7 +6801,7 @@ character_start:
               case 'Y':
                 if(count_children(prev) < 3){
                   if(!add_methyl(prev,graph))
-                    return Fatal(i, "Error: failed to add methyl group on methyl contraction");
+                    return Fatal(ctx,i, "Error: failed to add methyl group on methyl contraction");
 
                   prev = return_object_symbol(branch_stack);
                 }
@@ -5646,11 +6827,11 @@ character_start:
           ring = branch_stack.ring; // assign the ring
         }
         else{
-          return Fatal(i, "Error: popping too many rings|symbols, check '&' count");
+          return Fatal(ctx,i, "Error: popping too many rings|symbols, check '&' count");
         }
       }
       else
-        return Fatal(i, "Error: popping too many rings|symbols, check '&' count");
+        return Fatal(ctx,i, "Error: popping too many rings|symbols, check '&' count");
       break;
 
     
@@ -5663,31 +6844,31 @@ character_start:
         
         // on-locant holds the char needed to wrap the ring back, 
         if(!wrap_ring)
-          return Fatal(i, "Error: wrap ring is not active");
+          return Fatal(ctx,i, "Error: wrap ring is not active");
         
         if(on_locant != '0'){
 
           curr = wrap_ring->locants[on_locant];
           if(!curr)
-            return Fatal(i, "Error: cannot access looping ring structure");
+            return Fatal(ctx,i, "Error: cannot access looping ring structure");
         
           if(prev){  
 
             edge = AddEdge(curr, prev); 
             if(!edge)
-              return Fatal(i, "Error: failed to bond to previous symbol");
+              return Fatal(ctx,i, "Error: failed to bond to previous symbol");
             edge->stereo = pending_stereo; 
             pending_stereo = 0;
 
             wrap_ring->macro_return = edge; 
             if(inline_unsaturate){
               if(!unsaturate_edge(edge,inline_unsaturate))
-                return Fatal(i, "Error: failed to unsaturate bond"); 
+                return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
               inline_unsaturate = 0;
             }
           }
           else
-            return Fatal(i,"Error: no previous symbol for inline ring defintion");
+            return Fatal(ctx,i,"Error: no previous symbol for inline ring defintion");
           
         }
 
@@ -5696,7 +6877,7 @@ character_start:
         else if(i+2 < len && wln_ptr[i+2] == '-')
           i+=2;
         else
-          return Fatal(i, "Error: macro-notation requires closure with the ring size in two dashes e.g -6-");
+          return Fatal(ctx,i, "Error: macro-notation requires closure with the ring size in two dashes e.g -6-");
 
         curr = prev; // set back to prev
         on_locant = '\0';
@@ -5723,7 +6904,7 @@ character_start:
 
           curr = define_element(wln_ptr[i+1],wln_ptr[i+2],graph);
           if(!curr)
-            return Fatal(i, "Error: failed to define periodic element"); 
+            return Fatal(ctx,i, "Error: failed to define periodic element"); 
           
           if(on_locant == '0'){
             curr->charge++;
@@ -5733,14 +6914,14 @@ character_start:
           if(prev){
             edge = AddEdge(curr, prev); 
             if(!edge)
-              return Fatal(i, "Error: failed to bond to previous symbol");
+              return Fatal(ctx,i, "Error: failed to bond to previous symbol");
             
             edge->stereo = pending_stereo; 
             pending_stereo = 0; 
 
             if(inline_unsaturate){
               if(!unsaturate_edge(edge,inline_unsaturate))
-                return Fatal(i, "Error: failed to unsaturate bond"); 
+                return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
               inline_unsaturate = 0;
             }
 
@@ -5760,19 +6941,19 @@ character_start:
           
           curr = define_hypervalent_element(wln_ptr[i+1],graph);
           if(!curr)
-            return Fatal(i, "Error: failed to define hypervalent element");
+            return Fatal(ctx,i, "Error: failed to define hypervalent element");
           
           if(prev){
             edge = AddEdge(curr, prev); 
             if(!edge)
-              return Fatal(i, "Error: failed to bond to previous symbol");
+              return Fatal(ctx,i, "Error: failed to bond to previous symbol");
             
             edge->stereo = pending_stereo; 
             pending_stereo = 0; 
 
             if(inline_unsaturate){
               if(!unsaturate_edge(edge,inline_unsaturate))
-                return Fatal(i, "Error: failed to unsaturate bond"); 
+                return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
               inline_unsaturate = 0;
             }
           }
@@ -5796,7 +6977,7 @@ character_start:
         else{
 
           if(pending_inline_ring)
-            return Fatal(i,"Error: previous in-line ring definition not finished\n");
+            return Fatal(ctx,i,"Error: previous in-line ring definition not finished\n");
 
           pending_inline_ring = true;
           return_object_symbol(branch_stack);
@@ -5821,7 +7002,7 @@ character_start:
       else if(pending_numbers){ // state that this must be a charge 
 
         if(!cleared)
-          return Fatal(i, "Error: opening post charge assignment without proper syntax [ &x/x ]");
+          return Fatal(ctx,i, "Error: opening post charge assignment without proper syntax [ &x/x ]");
         
         int positive_index = 0; 
         if(d3){
@@ -5841,9 +7022,8 @@ character_start:
         d3=0;
        
 
-#if OPT_DEBUG
-        fprintf(stderr,"  attempting +1 charge on index %d\n",positive_index); 
-#endif
+        if(ctx.debug)
+          fprintf(stderr,"  attempting +1 charge on index %d\n",positive_index); 
 
         if (positive_index != 0){
           // find the symbol and increment its charge + 1
@@ -5857,19 +7037,19 @@ character_start:
           }
           
           if(!found)
-            return Fatal(i, "Error: positive charge index out of range, check letter index");
+            return Fatal(ctx,i, "Error: positive charge index out of range, check letter index");
         }
 
         pending_numbers = false;
         pending_negative_charge = true;
       }
       else
-        return Fatal(i,"Error: multipliers are not currently supported");
+        return Fatal(ctx,i,"Error: multipliers are not currently supported");
       cleared = false;
       break;
 
     default:
-      return Fatal(i,"Error: unallowed character! - alphabet: [A-Z][0-1][&-/' ']");
+      return Fatal(ctx,i,"Error: unallowed character! - alphabet: [A-Z][0-1][&-/' ']");
     }
 
     ch = wln_ptr[++i];
@@ -5895,9 +7075,9 @@ character_start:
     d3=0;
 
     if(carbon_len < 0)
-      return Fatal(i, "Error: non-numeric value entered for carbon length");
+      return Fatal(ctx,i, "Error: non-numeric value entered for carbon length");
     else if (carbon_len > 100)
-      return Fatal(i,"Error: creating a carbon chain > 100 long, is this reasonable for WLN?");
+      return Fatal(ctx,i,"Error: creating a carbon chain > 100 long, is this reasonable for WLN?");
     
 
     // create the head 
@@ -5910,13 +7090,13 @@ character_start:
 
       edge = AddEdge(curr, prev); 
       if(!edge)
-        return Fatal(i, "Error: failed to bond to previous symbol");
+        return Fatal(ctx,i, "Error: failed to bond to previous symbol");
       edge->stereo = pending_stereo; 
       pending_stereo = 0; 
       
       if(inline_unsaturate){
         if(!unsaturate_edge(edge,inline_unsaturate))
-          return Fatal(i, "Error: failed to unsaturate bond"); 
+          return Fatal(ctx,i, "Error: failed to unsaturate bond"); 
         inline_unsaturate = 0;
       }
     }
@@ -5930,7 +7110,7 @@ character_start:
   // single letter methyl branches
   if(on_locant && on_locant != '0' && !pending_inline_ring && !branch_stack.empty()){
     if(!add_methyl(branch_stack.ring->locants[on_locant],graph))
-      return Fatal(i, "Error: could not attach implied methyl to ring");
+      return Fatal(ctx,i, "Error: could not attach implied methyl to ring");
     
     on_locant = 0;
   }
@@ -5954,40 +7134,39 @@ character_start:
     d3=0;
 
     if(negative_index < 0)
-      return Fatal(i, "Error: assigning non-numerical value to charge index");
+      return Fatal(ctx,i, "Error: assigning non-numerical value to charge index");
     else if (negative_index != 0){
       // find the symbol and increment its charge + 1
       bool found = false;
       for(unsigned int cs = 0;cs<graph.symbol_count;cs++){
         if(graph.SYMBOLS[cs]->str_position == (unsigned int)negative_index){
           graph.SYMBOLS[cs]->charge--; 
-#if OPT_DEBUG
-          fprintf(stderr,"  assigning %c charge %d\n",graph.SYMBOLS[cs]->ch,graph.SYMBOLS[cs]->charge); 
-#endif
+          if(ctx.debug)
+            fprintf(stderr,"  assigning %c charge %d\n",graph.SYMBOLS[cs]->ch,graph.SYMBOLS[cs]->charge); 
           found = true;
           break;
         }
       }
       
       if(!found)
-        return Fatal(i, "Error: negative charge index out of range, check letter index");
+        return Fatal(ctx,i, "Error: negative charge index out of range, check letter index");
     }
   }
 
   if (pending_J_closure)
-    return Fatal(len, "Error: ring open at end of notation, inproper closure");
+    return Fatal(ctx,len, "Error: ring open at end of notation, inproper closure");
   
 
   if (pending_locant)
-    return Fatal(len, "Error: locant open at end of notation, inproper closure");
+    return Fatal(ctx,len, "Error: locant open at end of notation, inproper closure");
   
 
   if (pending_inline_ring)
-    return Fatal(len, "Error: inline ring expected at end of notation, inproper closure");
+    return Fatal(ctx,len, "Error: inline ring expected at end of notation, inproper closure");
   
 
   if (pending_spiro)
-    return Fatal(len, "Error: spiro ring expected at end of notation, inproper closure");
+    return Fatal(ctx,len, "Error: spiro ring expected at end of notation, inproper closure");
 
     // use this for recursion on multipliers
   return true;
@@ -6002,28 +7181,174 @@ character_start:
 **********************************************************************/
 
 
-// holds all the functions for WLN graph conversion, mol object is assumed ALIVE AT ALL TIMES
-// uses old NM functions from previous methods: Copyright (C) NextMove Software 2019-present
-struct BabelGraph{
-
-  BabelGraph(){};
-  ~BabelGraph(){};
+/* element, charge and hydrogen count a symbol expands to, shared by the babel
+ * conversion and the native smiles writer */
+bool WLNSymbolAtom(WLNSymbol *sym, unsigned int &atomic_num, int &charge, unsigned int &hcount){
+  charge = 0; 
+  atomic_num = 0;
+  hcount = sym->explicit_H;
 
+  switch(sym->ch){
+    case 'H':
+      atomic_num = 1;
+      hcount = 0;
+      charge = sym->charge; 
+      break; 
 
-  OBAtom* NMOBMolNewAtom(OBMol* mol, unsigned int elem,int charge,unsigned int hcount)
-  {
-    OBAtom* result = mol->NewAtom();
-    if(!result)
-      return 0;
-
-    result->SetAtomicNum(elem);
-    result->SetFormalCharge(charge);
-    result->SetImplicitHCount(hcount);
-    return result;
-  }
+    case 'B':
+      atomic_num = 5;
+      charge = sym->charge; 
+      break;
 
+    case '1': 
+    case 'C':
+      atomic_num = 6;
+      hcount = 4- sym->num_edges;
+      charge = sym->charge; 
+      if(charge < 0)
+        hcount+= charge; 
+      break; 
 
-  OBBond* NMOBMolNewBond( OBMol* mol,
+      if(sym->charge < 0 && hcount > 0)
+        hcount--; 
+      break;
+    
+    case 'X':
+      atomic_num = 6;
+      charge = sym->charge; 
+      break;
+
+    case 'Y':
+      atomic_num = 6;
+      charge = sym->charge; 
+      hcount = 4 - sym->num_edges + sym->explicit_H;
+      if(charge > 0){
+        for(unsigned int c=0;c<charge;c++)
+          if(hcount > 0)
+            hcount--; 
+      }
+      break;
+
+    case 'N':
+      atomic_num = 7;
+      if(sym->inRing)
+        sym->allowed_edges = 3;
+      charge = sym->charge; 
+
+      if(!hcount && sym->aromatic && sym->num_edges < sym->allowed_edges && sym->charge==0)
+        hcount = 1; // allows allow 1 H in aromatic species 
+      break;
+
+    case 'M':
+      atomic_num = 7;
+      charge = sym->charge; 
+      break;
+
+    case 'Z':
+      atomic_num = 7; 
+      charge = sym->charge;
+      break;
+
+    case 'K':
+      atomic_num = 7;
+      charge = 1; 
+      break;
+
+    case 'O':
+      atomic_num = 8;
+      if(!sym->charge){
+        if(sym->num_edges==1 && !hcount)
+          charge = -1;
+        if(!sym->num_edges && !hcount)
+          charge = -2;
+      }
+      else {
+        charge = sym->charge; 
+      }
+      break;
+
+    case 'Q':
+      atomic_num = 8;
+      if(!sym->num_edges && hcount == 1)
+        charge = -1;
+      break;
+
+    case 'F':
+      atomic_num = 9;
+      if(!sym->num_edges && !hcount)
+        charge = -1;
+      break;
+    
+    case 'P':
+      atomic_num = 15; 
+      charge = sym->charge; 
+      if(!hcount && sym->aromatic && sym->num_edges < 3)
+        hcount = 3-sym->num_edges; // allows allow 1 H in aromatic species 
+      break;
+    
+    case 'S':
+      atomic_num = 16;
+      charge = sym->charge; 
+      if(!hcount && sym->aromatic && sym->num_edges < 2)
+        hcount = 2-sym->num_edges; // allows allow 1 H in aromatic species 
+      break;
+
+    case 'G':
+      atomic_num = 17;
+      if(!sym->num_edges && !hcount)
+        charge = -1;
+      break;
+
+    case 'E':
+      atomic_num = 35;
+      if(!sym->num_edges && !hcount)
+        charge = -1;
+      break;
+
+    case 'I':
+      atomic_num = 53;
+      if(!sym->num_edges && !hcount)
+        charge = -1;
+      break;
+  
+    case '*':
+      atomic_num = special_element_atm(sym->special);
+      charge = sym->charge; 
+      break;
+    
+    case '#': // should make a dummy atom
+      hcount = 0; 
+      break;
+
+    default:
+      return false;
+  }
+  return true;
+}
+
+
+// holds all the functions for WLN graph conversion, mol object is assumed ALIVE AT ALL TIMES
+// uses old NM functions from previous methods: Copyright (C) NextMove Software 2019-present
+struct BabelGraph{
+
+  BabelGraph(){};
+  ~BabelGraph(){};
+
+
+  OBAtom* NMOBMolNewAtom(OBMol* mol, unsigned int elem,int charge,unsigned int hcount)
+  {
+    OBAtom* result = mol->NewAtom();
+    if(!result)
+      return 0;
+
+    result->SetAtomicNum(elem);
+    result->SetFormalCharge(charge);
+    result->SetImplicitHCount(hcount);
+    return result;
+  }
+
+
+  OBBond* NMOBMolNewBond( OBMol* mol,
                           OBAtom* s,
                           OBAtom* e,
                           unsigned int order)
@@ -6082,151 +7407,17 @@ struct BabelGraph{
   OBAtom *WLNSymbolToAtom(OBMol* mol, WLNSymbol*sym){
     int charge = 0; 
     unsigned int atomic_num = 0;
-    unsigned int hcount = sym->explicit_H;
-
-    switch(sym->ch){
-      case 'H':
-        atomic_num = 1;
-        hcount = 0;
-        charge = sym->charge; 
-        break; 
-
-      case 'B':
-        atomic_num = 5;
-        charge = sym->charge; 
-        break;
-
-      case '1': 
-      case 'C':
-        atomic_num = 6;
-        hcount = 4- sym->num_edges;
-        charge = sym->charge; 
-        if(charge < 0)
-          hcount+= charge; 
-        break; 
-
-        if(sym->charge < 0 && hcount > 0)
-          hcount--; 
-        break;
-      
-      case 'X':
-        atomic_num = 6;
-        charge = sym->charge; 
-        break;
-
-      case 'Y':
-        atomic_num = 6;
-        charge = sym->charge; 
-        hcount = 4 - sym->num_edges + sym->explicit_H;
-        if(charge > 0){
-          for(unsigned int c=0;c<charge;c++)
-            if(hcount > 0)
-              hcount--; 
-        }
-        break;
-
-      case 'N':
-        atomic_num = 7;
-        if(sym->inRing)
-          sym->allowed_edges = 3;
-        charge = sym->charge; 
-
-        if(!hcount && sym->aromatic && sym->num_edges < sym->allowed_edges && sym->charge==0)
-          hcount = 1; // allows allow 1 H in aromatic species 
-        break;
-
-      case 'M':
-        atomic_num = 7;
-        charge = sym->charge; 
-        break;
-
-      case 'Z':
-        atomic_num = 7; 
-        charge = sym->charge;
-        break;
-
-      case 'K':
-        atomic_num = 7;
-        charge = 1; 
-        break;
-
-      case 'O':
-        atomic_num = 8;
-        if(!sym->charge){
-          if(sym->num_edges==1 && !hcount)
-            charge = -1;
-          if(!sym->num_edges && !hcount)
-            charge = -2;
-        }
-        else {
-          charge = sym->charge; 
-        }
-        break;
-
-      case 'Q':
-        atomic_num = 8;
-        if(!sym->num_edges && hcount == 1)
-          charge = -1;
-        break;
-
-      case 'F':
-        atomic_num = 9;
-        if(!sym->num_edges && !hcount)
-          charge = -1;
-        break;
-      
-      case 'P':
-        atomic_num = 15; 
-        charge = sym->charge; 
-        if(!hcount && sym->aromatic && sym->num_edges < 3)
-          hcount = 3-sym->num_edges; // allows allow 1 H in aromatic species 
-        break;
-      
-      case 'S':
-        atomic_num = 16;
-        charge = sym->charge; 
-        if(!hcount && sym->aromatic && sym->num_edges < 2)
-          hcount = 2-sym->num_edges; // allows allow 1 H in aromatic species 
-        break;
-
-      case 'G':
-        atomic_num = 17;
-        if(!sym->num_edges && !hcount)
-          charge = -1;
-        break;
-
-      case 'E':
-        atomic_num = 35;
-        if(!sym->num_edges && !hcount)
-          charge = -1;
-        break;
-
-      case 'I':
-        atomic_num = 53;
-        if(!sym->num_edges && !hcount)
-          charge = -1;
-        break;
-    
-      case '*':
-        atomic_num = special_element_atm(sym->special);
-        charge = sym->charge; 
-        break;
-      
-      case '#': // should make a dummy atom
-        hcount = 0; 
-        break;
+    unsigned int hcount = 0;
+    if(!WLNSymbolAtom(sym,atomic_num,charge,hcount))
+      return 0;
 
-      default:
-        return 0;
-    }
-    
     OBAtom *atom = NMOBMolNewAtom(mol,atomic_num,charge,hcount);
     return atom; 
   }
 
 
-  bool ConvertFromWLN(OBMol* mol,WLNGraph &graph, unsigned int len){
-    if(OPT_DEBUG)
+  bool ConvertFromWLN(OBMol* mol,WLNGraph &graph, WLNContext &ctx){
+    if(ctx.debug)
       fprintf(stderr,"Converting wln to obabel mol object: \n");
     // doing this depth first might make more sense now
     
@@ -6237,9 +7428,9 @@ struct BabelGraph{
       WLNSymbol *sym = graph.SYMBOLS[i];
       
       // handle any '#' carbon chains
-      if(sym->ch == '#' && isNumber(sym->special) > 1 ){
+      if(sym->ch == '#' && isNumber(sym->special.c_str()) > 1 ){
         OBAtom *chain_head = NMOBMolNewAtom(mol, 6, 0, 0); // might need to be upped if terminal
-        OBAtom *chain_end = OBMolCarbonChain(mol, chain_head, isNumber(sym->special)-1);  
+        OBAtom *chain_end = OBMolCarbonChain(mol, chain_head, isNumber(sym->special.c_str())-1);  
         
         int order = 3; 
         for(unsigned int h=0;h<sym->parr_n;h++){
@@ -6299,7 +7490,7 @@ struct BabelGraph{
             bptr->SetWedge(); 
           }
           
-          if(bptr->IsWedge())
+          if(ctx.debug && bptr->IsWedge())
             fprintf(stderr,"stereo - set\n"); 
 
           if(!bptr)  
@@ -6317,10 +7508,456 @@ struct BabelGraph{
 
 
 
+/**********************************************************************
+                         Native SMILES Writer
+**********************************************************************/
+
+/* element symbols by atomic number, 0 is the dummy atom */
+static const char *smiles_elements[] = {
+  "*","H","He","Li","Be","B","C","N","O","F","Ne","Na","Mg","Al","Si","P","S","Cl","Ar",
+  "K","Ca","Sc","Ti","V","Cr","Mn","Fe","Co","Ni","Cu","Zn","Ga","Ge","As","Se","Br","Kr",
+  "Rb","Sr","Y","Zr","Nb","Mo","Tc","Ru","Rh","Pd","Ag","Cd","In","Sn","Sb","Te","I","Xe",
+  "Cs","Ba","La","Ce","Pr","Nd","Pm","Sm","Eu","Gd","Tb","Dy","Ho","Er","Tm","Yb","Lu",
+  "Hf","Ta","W","Re","Os","Ir","Pt","Au","Hg","Tl","Pb","Bi","Po","At","Rn",
+  "Fr","Ra","Ac","Th","Pa","U","Np","Pu","Am","Cm","Bk","Cf","Es","Fm","Md","No","Lr",
+  "Rf","Db","Sg","Bh","Hs","Mt","Ds","Rg","Cn","Nh","Fl","Mc","Lv","Ts","Og"
+};
+
+#define SMILES_ELEMENTS 119
+#define SMILES_DIGITS 100
+
+/* implicit hydrogens a bare organic subset atom would get, -1 if the 
+ * element has to be written in brackets regardless */
+static int smiles_implicit_h(unsigned int atomic_num, unsigned int valence){
+  static const unsigned int none[]     = {0};
+  static const unsigned int boron[]    = {3,0};
+  static const unsigned int carbon[]   = {4,0};
+  static const unsigned int nitrogen[] = {3,5,0};
+  static const unsigned int oxygen[]   = {2,0};
+  static const unsigned int sulphur[]  = {2,4,6,0};
+  static const unsigned int halogen[]  = {1,0};
+
+  const unsigned int *allowed = none;
+  switch(atomic_num){
+    case 5:  allowed = boron; break;
+    case 6:  allowed = carbon; break;
+    case 7:
+    case 15: allowed = nitrogen; break;
+    case 8:  allowed = oxygen; break;
+    case 16: allowed = sulphur; break;
+    case 9:
+    case 17:
+    case 35:
+    case 53: allowed = halogen; break;
+    default:
+      return -1;
+  }
+
+  for(unsigned int i=0;allowed[i];i++){
+    if(valence <= allowed[i])
+      return allowed[i] - valence;
+  }
+  return 0;
+}
+
+struct SmilesAtom{
+  unsigned int atomic_num;
+  int charge;
+  unsigned int hcount;
+  bool removed; // suppressed hydrogen, folded into its neighbour
+};
+
+struct SmilesBond{
+  unsigned int a;
+  unsigned int b;
+  unsigned char order;
+};
+
+struct SmilesRing{
+  unsigned int from;
+  unsigned int to; 
+  unsigned int digit;
+};
+
+// explicit dfs stack entry, long chains would overflow the call stack
+struct SmilesFrame{
+  unsigned int atom;
+  unsigned int n;        // next neighbour slot to look at
+  unsigned int children; // tree children still to write
+  bool branch;           // written inside brackets
+};
+
+/* flat molecule built straight from the expanded wln graph, holds the same atoms 
+ * and bonds ConvertFromWLN hands to babel, then writes a kekule smiles by dfs */
+struct SmilesGraph{
+  std::vector<SmilesAtom> atoms;
+  std::vector<SmilesBond> bonds;
+  std::vector<unsigned int> nbr_start; // csr offsets into nbr_bond, per atom
+  std::vector<unsigned int> nbr_bond;
+  std::vector<unsigned int> sym_head;  // first and last atom of each symbol, differ for '#' chains
+  std::vector<unsigned int> sym_end;
+  std::vector<unsigned int> visit;     // dfs discovery order, 0 is unseen
+  std::vector<unsigned int> parent_bond; // tree bond into each atom + 1, 0 for a root
+  std::vector<SmilesRing> open_rings;
+  std::vector<SmilesFrame> stack;
+  bool digits[SMILES_DIGITS];
+
+  void reset(){
+    atoms.clear();
+    bonds.clear();
+    nbr_start.clear();
+    nbr_bond.clear();
+    sym_head.clear();
+    sym_end.clear();
+    visit.clear();
+    parent_bond.clear();
+    open_rings.clear();
+    stack.clear();
+    memset(digits,0,sizeof(bool)*SMILES_DIGITS);
+  }
+
+  unsigned int AddAtom(unsigned int atomic_num, int charge, unsigned int hcount){
+    SmilesAtom atom;
+    atom.atomic_num = atomic_num;
+    atom.charge = charge;
+    atom.hcount = hcount;
+    atom.removed = false;
+    atoms.push_back(atom);
+    return atoms.size()-1;
+  }
+
+  void AddBond(unsigned int a, unsigned int b, unsigned char order){
+    SmilesBond bond;
+    bond.a = a;
+    bond.b = b;
+    bond.order = order;
+    bonds.push_back(bond);
+  }
+
+  unsigned int Other(unsigned int bond, unsigned int atom){
+    return bonds[bond].a == atom ? bonds[bond].b : bonds[bond].a;
+  }
+
+  /* mirrors ConvertFromWLN, including the '#' chain expansion */
+  bool Build(WLNGraph &graph){
+    sym_head.resize(graph.symbol_count);
+    sym_end.resize(graph.symbol_count);
+
+    for (unsigned int i=0; i<graph.symbol_count;i++){
+      WLNSymbol *sym = graph.SYMBOLS[i];
+      
+      if(sym->ch == '#' && isNumber(sym->special.c_str()) > 1 ){
+        unsigned int size = isNumber(sym->special.c_str());
+        unsigned int head = AddAtom(6,0,0);
+        unsigned int prev = head;
+        for(unsigned int c=1;c<size;c++){
+          unsigned int carbon = AddAtom(6,0,2);
+          AddBond(prev,carbon,1);
+          prev = carbon;
+        }
+        atoms[prev].hcount = 0;
+
+        int order = 3; 
+        for(unsigned int h=0;h<sym->parr_n;h++)
+          order -= sym->prev_array[h].order;
+        if(order >= 0)
+          atoms[head].hcount = order; 
+
+        order = 3;
+        for(unsigned int h=0;h<sym->barr_n;h++)
+          order -= sym->bond_array[h].order;
+        if(order >= 0)
+          atoms[prev].hcount = order; 
+
+        sym_head[sym->id] = head;
+        sym_end[sym->id] = prev;
+        continue;
+      }
+      
+      if (sym->ch == '#')
+        sym->ch = '1';
+
+      int charge = 0; 
+      unsigned int atomic_num = 0;
+      unsigned int hcount = 0;
+      if(!WLNSymbolAtom(sym,atomic_num,charge,hcount) || atomic_num >= SMILES_ELEMENTS)
+        return false;
+
+      sym_head[sym->id] = AddAtom(atomic_num,charge,hcount);
+      sym_end[sym->id] = sym_head[sym->id];
+    }
+
+    for(unsigned int i=0;i<graph.symbol_count;i++){
+      WLNSymbol *parent = graph.SYMBOLS[i];
+      for (unsigned int ei=0;ei<parent->barr_n;ei++){
+        WLNEdge *e = &parent->bond_array[ei];
+        AddBond(sym_end[parent->id],sym_head[e->child->id],e->order);
+      }
+    }
+
+    // csr adjacency, keeps bond insertion order per atom
+    nbr_start.assign(atoms.size()+1,0);
+    for(unsigned int b=0;b<bonds.size();b++){
+      nbr_start[bonds[b].a+1]++;
+      nbr_start[bonds[b].b+1]++;
+    }
+    for(unsigned int a=0;a<atoms.size();a++)
+      nbr_start[a+1] += nbr_start[a];
+    
+    nbr_bond.resize(bonds.size()*2);
+    visit.assign(atoms.size(),0); // borrowed as the fill position
+    for(unsigned int b=0;b<bonds.size();b++){
+      nbr_bond[nbr_start[bonds[b].a] + visit[bonds[b].a]++] = b;
+      nbr_bond[nbr_start[bonds[b].b] + visit[bonds[b].b]++] = b;
+    }
+
+    // same rule as babels DeleteHydrogens, neutral singly bonded hydrogens fold away 
+    for(unsigned int a=0;a<atoms.size();a++){
+      if(atoms[a].atomic_num != 1 || atoms[a].charge || nbr_start[a+1] - nbr_start[a] != 1)
+        continue;
+      unsigned int nbr = Other(nbr_bond[nbr_start[a]],a);
+      if(atoms[nbr].atomic_num == 1)
+        continue;
+      atoms[a].removed = true;
+      atoms[nbr].hcount++;
+    }
+
+    return true;
+  }
+
+  void Push(unsigned int atom, unsigned int children, bool branch){
+    SmilesFrame frame;
+    frame.atom = atom;
+    frame.n = nbr_start[atom];
+    frame.children = children;
+    frame.branch = branch;
+    stack.push_back(frame);
+  }
+
+  /* dfs pass, fixes the spanning tree so ring closures are known before writing */
+  void Order(unsigned int root, unsigned int &count){
+    visit[root] = ++count;
+    Push(root,0,false);
+    while(!stack.empty()){
+      SmilesFrame &f = stack.back();
+      if(f.n == nbr_start[f.atom+1]){
+        stack.pop_back();
+        continue;
+      }
+
+      unsigned int n = f.n++;
+      unsigned int w = Other(nbr_bond[n],f.atom);
+      if(atoms[w].removed || visit[w])
+        continue;
+      parent_bond[w] = nbr_bond[n]+1;
+      visit[w] = ++count;
+      Push(w,0,false);
+    }
+  }
+
+  void WriteBond(unsigned char order, std::string &buffer){
+    switch(order){
+      case 2: buffer += '='; break;
+      case 3: buffer += '#'; break;
+      case 4: buffer += '$'; break;
+    }
+  }
+
+  bool WriteDigit(unsigned int digit, std::string &buffer){
+    if(digit >= SMILES_DIGITS)
+      return false;
+    if(digit > 9){
+      buffer += '%';
+      buffer += '0' + digit/10;
+    }
+    buffer += '0' + digit%10;
+    return true;
+  }
+
+  void WriteAtom(unsigned int atom, std::string &buffer){
+    SmilesAtom &a = atoms[atom];
+    unsigned int valence = 0;
+    for(unsigned int n=nbr_start[atom];n<nbr_start[atom+1];n++){
+      if(!atoms[Other(nbr_bond[n],atom)].removed)
+        valence += bonds[nbr_bond[n]].order;
+    }
+
+    int implicit = smiles_implicit_h(a.atomic_num,valence);
+    if(!a.charge && implicit >= 0 && (unsigned int)implicit == a.hcount){
+      buffer += smiles_elements[a.atomic_num];
+      return;
+    }
+
+    if(!a.atomic_num && !a.charge && !a.hcount){
+      buffer += '*';
+      return;
+    }
+
+    buffer += '[';
+    buffer += smiles_elements[a.atomic_num];
+    if(a.hcount){
+      buffer += 'H';
+      if(a.hcount > 1)
+        buffer += std::to_string(a.hcount);
+    }
+    if(a.charge){
+      buffer += a.charge > 0 ? '+':'-';
+      if(abs(a.charge) > 1)
+        buffer += std::to_string(abs(a.charge));
+    }
+    buffer += ']';
+  }
+
+  /* writes the atom and its ring digits, counts the tree children left to write */
+  bool Open(unsigned int atom, unsigned int &children, std::string &buffer){
+    WriteAtom(atom,buffer);
+
+    bool closed = false;
+    children = 0;
+    for(unsigned int n=nbr_start[atom];n<nbr_start[atom+1];n++){
+      unsigned int b = nbr_bond[n];
+      unsigned int w = Other(b,atom);
+      if(atoms[w].removed || parent_bond[atom] == b+1)
+        continue;
+      
+      if(parent_bond[w] == b+1)
+        children++;
+      else if(visit[w] < visit[atom]){
+        for(unsigned int r=0;r<open_rings.size();r++){
+          if(open_rings[r].from == w && open_rings[r].to == atom){
+            WriteBond(bonds[b].order,buffer);
+            if(!WriteDigit(open_rings[r].digit,buffer))
+              return false;
+            
+            // released after this atom, stops a digit closing and reopening in place
+            closed = true; 
+            open_rings[r].to = atom;
+            open_rings[r].from = atom;
+            break;
+          }
+        }
+      }
+      else{
+        unsigned int digit = 1;
+        while(digit < SMILES_DIGITS && digits[digit])
+          digit++;
+        if(digit == SMILES_DIGITS)
+          return false;
+        digits[digit] = true;
+
+        SmilesRing ring;
+        ring.from = atom;
+        ring.to = w;
+        ring.digit = digit;
+        open_rings.push_back(ring);
+        WriteDigit(digit,buffer);
+      }
+    }
+
+    if(closed){
+      for(unsigned int r=0;r<open_rings.size();){
+        if(open_rings[r].from == atom && open_rings[r].to == atom){
+          digits[open_rings[r].digit] = false;
+          open_rings[r] = open_rings.back();
+          open_rings.pop_back();
+        }
+        else
+          r++;
+      }
+    }
+
+    return true;
+  }
+
+  /* every child but the last goes in brackets */
+  bool Write(unsigned int root, std::string &buffer){
+    unsigned int children = 0;
+    if(!Open(root,children,buffer))
+      return false;
+    Push(root,children,false);
+
+    while(!stack.empty()){
+      SmilesFrame &f = stack.back();
+      if(f.n == nbr_start[f.atom+1]){
+        if(f.branch)
+          buffer += ')';
+        stack.pop_back();
+        continue;
+      }
+
+      unsigned int b = nbr_bond[f.n++];
+      unsigned int w = Other(b,f.atom);
+      if(atoms[w].removed || parent_bond[w] != b+1)
+        continue;
+
+      bool branch = --f.children > 0;
+      if(branch)
+        buffer += '(';
+      WriteBond(bonds[b].order,buffer);
+      if(!Open(w,children,buffer)){
+        stack.clear();
+        return false;
+      }
+      Push(w,children,branch);
+    }
+    return true;
+  }
+
+  /* appends a non-canonical kekule smiles, components separated by '.' */
+  bool WriteSmiles(std::string &buffer){
+    unsigned int count = 0;
+    visit.assign(atoms.size(),0);
+    parent_bond.assign(atoms.size(),0);
+    
+    bool first = true;
+    for(unsigned int a=0;a<atoms.size();a++){
+      if(atoms[a].removed || visit[a])
+        continue;
+      Order(a,count);
+      if(!first)
+        buffer += '.';
+      first = false;
+      if(!Write(a,buffer))
+        return false;
+    }
+    return true;
+  }
+};
+
+
 /**********************************************************************
                           Canonical Algorithms
 **********************************************************************/
 
+/* visited flags indexed by symbol id, replaces the pointer keyed maps */
+struct WLNSymbolSet{
+  std::vector<bool> bits; // ids from base, a ring only spans its own locants
+  unsigned int base;
+
+  WLNSymbolSet(){
+    base = 0;
+  }
+
+  std::vector<bool>::reference operator[](WLNSymbol *sym){
+    if(bits.empty())
+      base = sym->id;
+    else if(sym->id < base){
+      // grow downwards at least doubling, walks from a high id stay linear
+      unsigned int grow = std::min(base,std::max(base - sym->id,(unsigned int)bits.size()));
+      bits.insert(bits.begin(),grow,false);
+      base -= grow;
+    }
+
+    if(sym->id - base >= bits.size())
+      bits.resize(sym->id - base + 1,false);
+    return bits[sym->id - base];
+  }
+
+  bool test(WLNSymbol *sym) const{
+    return sym->id >= base && sym->id - base < bits.size() && bits[sym->id - base];
+  }
+};
+
 
 unsigned int methyl_contract(WLNSymbol *sym){
   // methyl contraction 
@@ -6357,7 +7994,7 @@ unsigned int methyl_contract(WLNSymbol *sym){
 // unfortuantely quite expensive, dioxo will always be forward facing
 // 0 - none, 1 = (=O)(=O), 2 = ([O-])(=O)
 // if the symbol is not saturated and type 2, return 0, as this cannot be implied
-unsigned int check_dioxo_type(WLNSymbol *node, std::map<WLNSymbol*,bool> &seen_symbols, std::string &buffer){
+unsigned int check_dioxo_type(WLNSymbol *node, WLNSymbolSet &seen_symbols, std::string &buffer){
   WLNSymbol* double_oxygen_1 = 0; 
   WLNSymbol* double_oxygen_2 = 0; 
   WLNSymbol *oxo_ion = 0; 
@@ -6410,14 +8047,50 @@ struct ChainScore{
   bool terminates;
   unsigned int ring_ranking; 
   bool has_branch; 
+  std::vector<WLNSymbol*> probes; // seen lookups the run depended on
+  std::vector<bool> probe_seen; 
 };
 
 struct SortedEdges{
-  WLNEdge *edges[MAX_EDGES*2];
-  unsigned char e_n;
-  unsigned char e_max;
+  std::vector<WLNEdge*> edges; // a null edge forces a branch pop
+  unsigned int e_n;
+  unsigned int e_max;
+
+  SortedEdges(){
+    e_n = 0;
+    e_max = 0;
+  }
+
+  void push_back(WLNEdge *e){
+    edges.push_back(e);
+    e_max++;
+  }
+};
+
+/* scratch for one canonicalisation call. acyclic parts are trees and a run stops
+ * at the first ring atom, so a run depends only on the edge it leaves by and is 
+ * scored once per call, scores come from a recycled pool */
+struct WLNChainMemo{
+  WLNArena<ChainScore,64> scores;
+  std::unordered_map<WLNEdge*,ChainScore*> runs; 
+  std::vector<unsigned int> walked; // symbols on the current run, by epoch
+  unsigned int epoch;
+
+  WLNChainMemo(){
+    epoch = 0;
+  }
+
+  void reset(){
+    scores.reset();
+    runs.clear();
+  }
 };
 
+static WLNChainMemo &ChainMemo(){
+  static thread_local WLNChainMemo memo;
+  return memo;
+}
+
 
 void debug_score(ChainScore *score){
   fprintf(stderr,"%c --> %c: %s",score->e->parent->ch, score->e->child->ch,score->chunk.c_str()); 
@@ -6518,13 +8191,43 @@ void SortByRule2(ChainScore **arr,unsigned int len){
 }
 
 
+static bool ChainSeen(WLNSymbol *sym, const WLNSymbolSet &seen, WLNChainMemo &memo, ChainScore *score){
+  if(sym->id < memo.walked.size() && memo.walked[sym->id] == memo.epoch)
+    return true;
+  bool r = seen.test(sym); 
+  score->probes.push_back(sym);
+  score->probe_seen.push_back(r);
+  return r;
+}
+
+/* a stored run is only reusable if every seen lookup it made still agrees */
+static bool ChainScoreValid(ChainScore *score, const WLNSymbolSet &seen){
+  for(unsigned int i=0;i<score->probes.size();i++){
+    if(seen.test(score->probes[i]) != score->probe_seen[i])
+      return false;
+  }
+  return true;
+}
+
 /* run the chain until either a ring atom/branch point/EOC is seen,
- * prototype does have a map copy which is irrating */
-ChainScore *RunChain(WLNEdge *edge,std::map<WLNSymbol*,bool> seen){
-  
-  ChainScore *score = new ChainScore; // must use new for string 
+ * memoised per edge, the walk is stamped by epoch rather than copying seen */
+ChainScore *RunChain(WLNEdge *edge,const WLNSymbolSet &seen){
+  WLNChainMemo &memo = ChainMemo();
+  std::unordered_map<WLNEdge*,ChainScore*>::iterator hit = memo.runs.find(edge);
+  if(hit != memo.runs.end() && ChainScoreValid(hit->second,seen))
+    return hit->second;
+
+  ChainScore *score = memo.scores.next();
+  memo.runs[edge] = score;
+  if(++memo.epoch == 0){ // wrapped, stale stamps could alias
+    memo.walked.assign(memo.walked.size(),0);
+    memo.epoch = 1;
+  }
+
+  score->probes.clear();
+  score->probe_seen.clear();
   score->e = edge;
-  score->chunk = ""; 
+  score->chunk.clear(); 
   score->terminates = 0;
   score->ring_ranking = 0; // these should be placed last when possible 
   score->has_branch = 0; // also takes a lower priority?
@@ -6532,7 +8235,9 @@ ChainScore *RunChain(WLNEdge *edge,std::map<WLNSymbol*,bool> seen){
   WLNSymbol *node = edge->child; 
   // no stack needed as looking ahead in a linear fashion
   for(;;){
-    seen[node] = true;
+    if(node->id >= memo.walked.size())
+      memo.walked.resize(node->id+1,0);
+    memo.walked[node->id] = memo.epoch;
     if(node->inRing){
       score->ring_ranking = node->inRing->ranking;
       return score; // immediate
@@ -6540,7 +8245,7 @@ ChainScore *RunChain(WLNEdge *edge,std::map<WLNSymbol*,bool> seen){
 
     switch(node->ch){
     case '#':
-      score->chunk += node->special;  
+      score->chunk += node->special.c_str();  
       break;
 
       // these must branch
@@ -6576,13 +8281,13 @@ ChainScore *RunChain(WLNEdge *edge,std::map<WLNSymbol*,bool> seen){
         score->chunk += node->ch; 
     }
    
-    if(node->barr_n && !seen[node->bond_array[0].child]){
+    if(node->barr_n && !ChainSeen(node->bond_array[0].child,seen,memo,score)){
       for(unsigned int i=1;i<node->bond_array[0].order;i++) // let symbol orderer sort here
         score->chunk += 'U';
 
       node = node->bond_array[0].child; // no need to iterate, it should only have 1.
     }
-    else if (node->parr_n && !seen[node->prev_array[0].child]){
+    else if (node->parr_n && !ChainSeen(node->prev_array[0].child,seen,memo,score)){
       for(unsigned int i=1;i<node->prev_array[0].order;i++) // let symbol orderer sort here
         score->chunk += 'U';
 
@@ -6604,57 +8309,52 @@ bool CanonicalWLNRing(WLNSymbol *node, WLNGraph &graph, WLNSymbol *ignore, std::
 
 /* sorts the bonds of any given chain, function will look through both previous and forward bonds in order to continue the parse, 
 as such, it requires a seen map to avoid looping back to areas its previously been  */
-SortedEdges* ArrangeBonds( WLNSymbol *sym, std::map<WLNSymbol*,bool> &seen, WLNSymbol *ignore)
+SortedEdges* ArrangeBonds( WLNSymbol *sym, WLNSymbolSet &seen, WLNSymbol *ignore)
 {
-  SortedEdges *se = (SortedEdges*)malloc(sizeof(SortedEdges));
-  for(unsigned int i=0;i<MAX_EDGES*2;i++)
-    se->edges[i] = 0; 
+  SortedEdges *se = new SortedEdges;
+  se->edges.reserve(sym->barr_n + sym->parr_n + 2);
 
   unsigned int l = 0;
-  ChainScore *scores[64] = {0};
+  std::vector<ChainScore*> scores(sym->barr_n + sym->parr_n);
   
   for(unsigned int ei=0;ei<sym->barr_n;ei++){
     WLNEdge *e =  &sym->bond_array[ei]; 
-    if(!seen[e->child] && e->child != ignore)
+    if(!seen.test(e->child) && e->child != ignore)
       scores[l++] = RunChain(e,seen); // score each chain run
   }
 
   for(unsigned int ei=0;ei<sym->parr_n;ei++){
     WLNEdge *e =  &sym->prev_array[ei];
-    if(!seen[e->child] && e->child != ignore)
+    if(!seen.test(e->child) && e->child != ignore)
       scores[l++] = RunChain(e,seen); // score each chain run
   }
 
-  SortByRule2(scores, l); 
-  SortByBranch(scores, l); 
-  SortByTerminal(scores, l); // sort by terminals, prefer them
-  SortByRing(scores, l); 
+  SortByRule2(scores.data(), l); 
+  SortByBranch(scores.data(), l); 
+  SortByTerminal(scores.data(), l); // sort by terminals, prefer them
+  SortByRing(scores.data(), l); 
   
-  unsigned char a = 0; 
   for(int i=l-1;i>=0;i--){ // sort the chains (radix style) to get high priorities first
-    se->edges[a++] = scores[i]->e; 
-    delete scores[i];
+    se->push_back(scores[i]->e); 
   }
     
 
   // this all valence full by definition
   if(sym->ch != 'X' && sym->ch != 'K' && sym->ch != 'Y'){
     if(IsBranching(sym) && sym->num_edges < sym->allowed_edges)
-      scores[a++] = 0; // adds a forcable pop 
+      se->push_back(0); // adds a forcable pop 
   }
 
-  se->e_n = 0; 
-  se->e_max = a;
   return se; 
 }
 
-SortedEdges* ArrangeRingBonds( WLNSymbol *locant,WLNRing *ring, std::map<WLNSymbol*,bool> seen,WLNSymbol *ignore)
+SortedEdges* ArrangeRingBonds( WLNSymbol *locant,WLNRing *ring, const WLNSymbolSet &seen,WLNSymbol *ignore)
 {
 
-  SortedEdges *se = (SortedEdges*)malloc(sizeof(SortedEdges));
+  SortedEdges *se = new SortedEdges;
 
   unsigned int l = 0;
-  ChainScore *scores[64] = {0};
+  std::vector<ChainScore*> scores(locant->barr_n + locant->parr_n);
   
   for (unsigned int ei=0;ei<locant->barr_n;ei++){
     WLNEdge *fe = &locant->bond_array[ei];
@@ -6662,7 +8362,7 @@ SortedEdges* ArrangeRingBonds( WLNSymbol *locant,WLNRing *ring, std::map<WLNSymb
 
     if( fe->child->inRing != ring 
         && fe->child != ignore 
-        && !seen[fe->child])
+        && !seen.test(fe->child))
     {
       if(fe->child->ch == 'H' && !locant->explicit_H)
         ;
@@ -6673,7 +8373,7 @@ SortedEdges* ArrangeRingBonds( WLNSymbol *locant,WLNRing *ring, std::map<WLNSymb
 
   for (unsigned int ei=0;ei<locant->parr_n;ei++){
     WLNEdge *be = &locant->prev_array[ei];
-    if(be->child->inRing != ring && be->child != ignore && !seen[be->child]){
+    if(be->child->inRing != ring && be->child != ignore && !seen.test(be->child)){
 
       if(be->child->ch == 'H' && !locant->explicit_H)
         ;
@@ -6682,31 +8382,26 @@ SortedEdges* ArrangeRingBonds( WLNSymbol *locant,WLNRing *ring, std::map<WLNSymb
     }
   }
 
-  SortByRule2(scores, l); 
-  SortByBranch(scores, l); 
-  SortByRing(scores, l); 
+  SortByRule2(scores.data(), l); 
+  SortByBranch(scores.data(), l); 
+  SortByRing(scores.data(), l); 
 
   // sort by ring will cluster the spiro rings together, remove 1
   if(locant->spiro){
-    for(unsigned int i=0;i<l-1;i++){
+    for(unsigned int i=0;i+1<l;i++){
       if(scores[i]->ring_ranking == scores[i+1]->ring_ranking){
-        delete scores[i];
-        scores[i] = 0;
+        scores[i] = 0; // pool owned
         break;
       }
     }
   }
 
-  unsigned char a = 0; 
   for(int i=l-1;i>=0;i--){ // sort the chains (radix style) to get high priorities first
     if(scores[i]){
-      se->edges[a++] = scores[i]->e; 
-      delete scores[i];
+      se->push_back(scores[i]->e); 
     }
   }
 
-  se->e_n = 0; 
-  se->e_max = a; 
   return se; 
 }
 
@@ -6734,13 +8429,13 @@ void WriteCharacter(WLNSymbol *sym, std::string &buffer, WLNGraph &graph){
     
     case '#': 
       sym->str_position = buffer.size()+1; // place on first number 
-      buffer += sym->special;
+      buffer += sym->special.c_str();
       break;
 
     case '*':
       buffer += '-';
       sym->str_position = buffer.size()+1; // place on first letter
-      buffer += sym->special;
+      buffer += sym->special.c_str();
       buffer += '-';
       break;
 
@@ -6835,24 +8530,55 @@ void WriteCharacter(WLNSymbol *sym, std::string &buffer, WLNGraph &graph){
 
 
 
-bool CanonicalWLNChain(WLNSymbol *node, WLNGraph &graph, WLNSymbol *ignore, std::string &buffer){
+/* the chain writer as a resumable walk, each Step() is one move of the dfs so
+ * several start points can be written side by side and compared as they grow */
+struct WLNChainWriter{
   std::map<WLNSymbol*,SortedEdges*> sorted_edges;
-  std::set<SortedEdges*> se_memory_hold; 
-  std::map<WLNSymbol*,bool> seen_symbols; 
+  WLNSymbolSet seen_symbols; 
   std::stack<WLNSymbol*> branching_symbols;
 
-  WLNEdge *edge = 0;
-  SortedEdges *se = 0; 
+  WLNSymbol *node;
+  WLNGraph &graph;
+  WLNSymbol *ignore;
+  std::string &buffer;
+
+  const std::vector<unsigned int> *costs; // minimum characters per symbol, optional
+  unsigned int written; 
+
+  WLNChainWriter(WLNSymbol *start, WLNGraph &g, WLNSymbol *ign, std::string &buf, const std::vector<unsigned int> *c = 0)
+    : node(start), graph(g), ignore(ign), buffer(buf), costs(c)
+  {
+    written = 0; 
+    Start();
+  }
+
+  ~WLNChainWriter(){
+    // each symbol is arranged once, this also frees those never stepped from
+    for(std::map<WLNSymbol*,SortedEdges*>::iterator miter=sorted_edges.begin();miter!=sorted_edges.end();miter++)
+      delete miter->second;
+  }
+
+  void Visit(WLNSymbol *sym){
+    seen_symbols[sym] = true;
+    if(costs)
+      written += (*costs)[sym->id];
+  }
+
+  void Start();
+  bool Step(); 
+};
 
+
+void WLNChainWriter::Start(){
   WriteCharacter(node,buffer,graph);
   unsigned int dioxo_write = check_dioxo_type(node,seen_symbols,buffer); 
 
-  seen_symbols[node] = true;
+  Visit(node);
   sorted_edges[node] = ArrangeBonds(node, seen_symbols, ignore);
 
   if(IsBranching(node)){
     if(dioxo_write == 1)
-      sorted_edges[node]->edges[sorted_edges[node]->e_max++] = 0; // adds pop since W will go from 4 to 3  
+      sorted_edges[node]->push_back(0); // adds pop since W will go from 4 to 3  
     
     if(dioxo_write==2 && node->allowed_edges==4){
       dioxo_write = 0;
@@ -6860,165 +8586,166 @@ bool CanonicalWLNChain(WLNSymbol *node, WLNGraph &graph, WLNSymbol *ignore, std:
     else
       branching_symbols.push(node);
   }
+}
 
-  for(;;){
-    if(!node)
-      break;
-    
+/* false once the walk has finished */
+bool WLNChainWriter::Step(){
+  if(!node)
+    return false;
 
-    se = sorted_edges[node];
-    se_memory_hold.insert(se); 
-    if(se->e_max > 0 && se->e_n < se->e_max){
-      edge = se->edges[se->e_n++];
+  WLNEdge *edge = 0;
+  SortedEdges *se = sorted_edges[node];
+  if(se->e_max > 0 && se->e_n < se->e_max){
+    edge = se->edges[se->e_n++];
 
-      if(!edge){
-        if(!branching_symbols.empty()){
-          buffer += '&';
-          branching_symbols.pop(); 
+    if(!edge){
+      if(!branching_symbols.empty()){
+        buffer += '&';
+        branching_symbols.pop(); 
+      }
+
+      while(  !branching_symbols.empty() && 
+              sorted_edges[branching_symbols.top()]->e_n == sorted_edges[branching_symbols.top()]->e_max)
+      {
+        branching_symbols.pop(); 
+      }
+
+      if(!branching_symbols.empty())
+        node = branching_symbols.top();
+      else 
+        node = 0; 
+    }
+    else{ 
+      for(unsigned int i=1;i<edge->order;i++)
+        buffer += 'U';
+
+      // benzene special case; 
+      if(edge->child->inRing && edge->child->inRing->str_notation == "L6J"){
+        // incoming == 'A' locant need to be rearranged          
+        
+        // locants are rotated from the incoming position, C = A, therefore D = B etc
+        unsigned char incoming_char = edge->child->inRing->locants_ch[edge->child]; 
+        
+        std::vector<std::pair<WLNSymbol*,unsigned char>> new_positions; 
+        if(incoming_char != 'A'){
+        // wrap the locants around 
+          WLNRing * benzene =edge->child->inRing;
+          for (unsigned char ch = 'A'; ch <= 'F'; ch++){
+            if(ch < incoming_char){
+              unsigned char new_loc = (ch-incoming_char) + 'F'+1;   
+              new_positions.push_back({benzene->locants[ch],new_loc}); 
+            }
+            else{
+              unsigned char new_loc = (ch-incoming_char) + 'A';   
+              new_positions.push_back({benzene->locants[ch],new_loc}); 
+            }
+          }
+          
+          // seems a bit like bullying, but does work
+          benzene->locants.clear();
+          benzene->locants_ch.clear(); 
+          for (std::pair<WLNSymbol*,unsigned char> p : new_positions){
+            benzene->locants[p.second] = p.first;
+            benzene->locants_ch[p.first] = p.second; 
+          }
         }
 
+        CanonicalWLNRing(edge->child, graph, edge->parent, buffer);
         while(  !branching_symbols.empty() && 
                 sorted_edges[branching_symbols.top()]->e_n == sorted_edges[branching_symbols.top()]->e_max)
         {
+          //buffer += '&';
           branching_symbols.pop(); 
         }
 
         if(!branching_symbols.empty())
           node = branching_symbols.top();
-        else 
+        else
           node = 0; 
       }
-      else{ 
-        for(unsigned int i=1;i<edge->order;i++)
-          buffer += 'U';
-
-        // benzene special case; 
-        if(edge->child->inRing && edge->child->inRing->str_notation == "L6J"){
-          // incoming == 'A' locant need to be rearranged          
-          
-          // locants are rotated from the incoming position, C = A, therefore D = B etc
-          unsigned char incoming_char = edge->child->inRing->locants_ch[edge->child]; 
-          
-          std::vector<std::pair<WLNSymbol*,unsigned char>> new_positions; 
-          if(incoming_char != 'A'){
-          // wrap the locants around 
-            WLNRing * benzene =edge->child->inRing;
-            for (unsigned char ch = 'A'; ch <= 'F'; ch++){
-              if(ch < incoming_char){
-                unsigned char new_loc = (ch-incoming_char) + 'F'+1;   
-                new_positions.push_back({benzene->locants[ch],new_loc}); 
-              }
-              else{
-                unsigned char new_loc = (ch-incoming_char) + 'A';   
-                new_positions.push_back({benzene->locants[ch],new_loc}); 
-              }
-            }
-            
-            // seems a bit like bullying, but does work
-            benzene->locants.clear();
-            benzene->locants_ch.clear(); 
-            for (std::pair<WLNSymbol*,unsigned char> p : new_positions){
-              benzene->locants[p.second] = p.first;
-              benzene->locants_ch[p.first] = p.second; 
-            }
-          }
-
-          CanonicalWLNRing(edge->child, graph, edge->parent, buffer);
-          while(  !branching_symbols.empty() && 
-                  sorted_edges[branching_symbols.top()]->e_n == sorted_edges[branching_symbols.top()]->e_max)
-          {
-            //buffer += '&';
-            branching_symbols.pop(); 
-          }
-
-          if(!branching_symbols.empty())
-            node = branching_symbols.top();
-          else
-            node = 0; 
-        }
-        else if(edge->child->inRing){
-          
-          buffer += '-';
-          buffer += ' ';
-          write_locant(edge->child->inRing->locants_ch[edge->child], buffer); 
-          
-          if(edge == edge->child->inRing->macro_return || edge->reverse == edge->child->inRing->macro_return)
-            buffer += "-x-J";
-          else 
-            CanonicalWLNRing(edge->child, graph, edge->parent, buffer);
+      else if(edge->child->inRing){
+        
+        buffer += '-';
+        buffer += ' ';
+        write_locant(edge->child->inRing->locants_ch[edge->child], buffer); 
+        
+        if(edge == edge->child->inRing->macro_return || edge->reverse == edge->child->inRing->macro_return)
+          buffer += "-x-J";
+        else 
+          CanonicalWLNRing(edge->child, graph, edge->parent, buffer);
 
-          
-          while(  !branching_symbols.empty() && 
-                  sorted_edges[branching_symbols.top()]->e_n == sorted_edges[branching_symbols.top()]->e_max)
-          {
-            //buffer += '&';
-            branching_symbols.pop(); 
-          }
+        
+        while(  !branching_symbols.empty() && 
+                sorted_edges[branching_symbols.top()]->e_n == sorted_edges[branching_symbols.top()]->e_max)
+        {
+          //buffer += '&';
+          branching_symbols.pop(); 
+        }
 
-          if(!branching_symbols.empty())
-            node = branching_symbols.top();
-          else
-            node = 0; 
+        if(!branching_symbols.empty())
+          node = branching_symbols.top();
+        else
+          node = 0; 
+      }
+      else{
+        node = edge->child;
+        if(methyl_contract(node)){
+          buffer += '&'; 
+          Visit(node);
+          sorted_edges[node] = ArrangeBonds(node, seen_symbols, ignore);
         }
         else{
-          node = edge->child;
-          if(methyl_contract(node)){
-            buffer += '&'; 
-            seen_symbols[node] = true;
-            sorted_edges[node] = ArrangeBonds(node, seen_symbols, ignore);
-          }
-          else{
-            WriteCharacter(node, buffer,graph); 
-            unsigned int dioxo_write = check_dioxo_type(node,seen_symbols,buffer); 
+          WriteCharacter(node, buffer,graph); 
+          unsigned int dioxo_write = check_dioxo_type(node,seen_symbols,buffer); 
 
-            seen_symbols[node] = true;
-            sorted_edges[node] = ArrangeBonds(node, seen_symbols, ignore);
+          Visit(node);
+          sorted_edges[node] = ArrangeBonds(node, seen_symbols, ignore);
+          
+          if(IsBranching(node)){
+            if(dioxo_write == 1)
+              sorted_edges[node]->push_back(0); // adds pop since W will go from 4 to 3  
             
-            if(IsBranching(node)){
-              if(dioxo_write == 1)
-                sorted_edges[node]->edges[sorted_edges[node]->e_max++] = 0; // adds pop since W will go from 4 to 3  
-              
-              if(dioxo_write==2 && node->allowed_edges==4){
-                dioxo_write = 0;
-              }
-              else
-                branching_symbols.push(node);
+            if(dioxo_write==2 && node->allowed_edges==4){
+              dioxo_write = 0;
             }
+            else
+              branching_symbols.push(node);
           }
         }
       }
     }
-    else if (!branching_symbols.empty()){
-      // return to something on the branch stack here
-
-      while(  !branching_symbols.empty() && 
-              sorted_edges[branching_symbols.top()]->e_n == sorted_edges[branching_symbols.top()]->e_max)
-      {
-        branching_symbols.pop(); 
-      }
+  }
+  else if (!branching_symbols.empty()){
+    // return to something on the branch stack here
 
-      if(!branching_symbols.empty()){
-        if( !(IsTerminator(node) || node->ch == 'W' || (!buffer.empty() && buffer.back() == 'W') ) ){ 
-            
-          if(!methyl_contract(node))
-            buffer+= '&';
-        }
+    while(  !branching_symbols.empty() && 
+            sorted_edges[branching_symbols.top()]->e_n == sorted_edges[branching_symbols.top()]->e_max)
+    {
+      branching_symbols.pop(); 
+    }
 
-        node = branching_symbols.top();
+    if(!branching_symbols.empty()){
+      if( !(IsTerminator(node) || node->ch == 'W' || (!buffer.empty() && buffer.back() == 'W') ) ){ 
+          
+        if(!methyl_contract(node))
+          buffer+= '&';
       }
-      else
-        node = 0; 
+
+      node = branching_symbols.top();
     }
     else
       node = 0; 
   }
-  
-  for(std::set<SortedEdges*>::iterator miter=se_memory_hold.begin();miter!=se_memory_hold.end();miter++){
-    SortedEdges *free_edge = (*miter);
-    free(free_edge);
-    free_edge = 0; 
-  }
-  
+  else
+    node = 0; 
+
+  return true;
+}
+
+
+bool CanonicalWLNChain(WLNSymbol *node, WLNGraph &graph, WLNSymbol *ignore, std::string &buffer){
+  WLNChainWriter writer(node,graph,ignore,buffer);
+  while(writer.Step());
   return true; 
 }
 
@@ -7043,7 +8770,7 @@ bool CanonicalWLNRing(WLNSymbol *node, WLNGraph &graph,WLNSymbol *ignore, std::s
     buffer += ring->str_notation; 
 
   // add all the locants to the seen map, prevents back tracking within the ring structure
-  std::map<WLNSymbol*,bool> seen_locants; 
+  WLNSymbolSet seen_locants; 
   for(unsigned char ch = 'A';ch < 'A'+ring->rsize;ch++){ 
     // add the hydrogens here
     WLNSymbol *lc = ring->locants[ch]; 
@@ -7199,7 +8926,7 @@ bool CanonicalWLNRing(WLNSymbol *node, WLNGraph &graph,WLNSymbol *ignore, std::s
       }
     }
 
-    free(ring_se); 
+    delete ring_se; 
   }
   
   buffer += '&'; // better logic following writer
@@ -7226,6 +8953,173 @@ void WritePostCharges(WLNGraph &wln_graph, std::string &buffer){
   }
 }
 
+/* length of a chain once trailing '&' are cleaned, the final string can never be shorter */
+static unsigned int ChainLength(const std::string &chain){
+  unsigned int n = chain.size();
+  while(n && chain[n-1] == '&')
+    n--;
+  return n; 
+}
+
+
+/* start point rule: the shortest chain wins, then the highest ascii character
+ * (follows rule 2 order), exact ties go to the earlier start point */
+struct ChainRace{
+  std::vector<std::string> chains; 
+  std::vector<WLNChainWriter*> writers;
+  std::vector<bool> done;
+  std::vector<unsigned int> costs; 
+  unsigned int total; 
+  int best; 
+
+  ChainRace(std::vector<WLNSymbol*> &starts, std::set<WLNSymbol*> &component, WLNGraph &graph) 
+    : chains(starts.size()), done(starts.size(),false), costs(graph.symbol_count,0)
+  {
+    best = -1;
+    total = 0;
+    bool component_ring = false; 
+    // benzene rings are written whole from inside a step, only bound plain chains
+    for(std::set<WLNSymbol*>::iterator siter = component.begin();siter != component.end(); siter++){
+      if((*siter)->inRing)
+        component_ring = true;
+    }
+
+    std::string scratch; 
+    for(std::set<WLNSymbol*>::iterator siter = component.begin();siter != component.end() && !component_ring; siter++){
+      WLNSymbol *sym = *siter; 
+      // oxygens can fold into a W and methyls into a trailing '&', neither is owed a character
+      if(sym->ch == 'O' || methyl_contract(sym))
+        continue;
+
+      scratch.clear();
+      WriteCharacter(sym,scratch,graph); // the final write resets str_position 
+      unsigned int bond = 3; 
+      for(unsigned int ei=0;ei<sym->barr_n;ei++)
+        bond = std::min(bond,(unsigned int)sym->bond_array[ei].order);
+      for(unsigned int ei=0;ei<sym->parr_n;ei++)
+        bond = std::min(bond,(unsigned int)sym->prev_array[ei].order);
+
+      costs[sym->id] = scratch.size() + (bond > 1 ? bond-1 : 0); 
+      total += costs[sym->id];
+    }
+
+    for(unsigned int i=0;i<starts.size();i++)
+      writers.push_back(new WLNChainWriter(starts[i],graph,0,chains[i],&costs));
+  }
+
+  ~ChainRace(){
+    for(unsigned int i=0;i<writers.size();i++)
+      delete writers[i];
+  }
+
+  void Advance(unsigned int i, unsigned int size){
+    while(!done[i] && chains[i].size() <= size)
+      done[i] = !writers[i]->Step(); 
+  }
+
+  // every symbol still to come writes after the current tail, so any '&' there stays
+  unsigned int Bound(unsigned int i){
+    unsigned int owed = total - writers[i]->written; 
+    if(owed)
+      return chains[i].size() + owed;
+    else
+      return ChainLength(chains[i]); 
+  }
+
+  // cannot beat the current best whatever it writes from here 
+  bool Beaten(unsigned int i){
+    if(best < 0 || (int)i == best)
+      return false;
+
+    unsigned int bound = Bound(i);
+    unsigned int best_len = chains[best].size();
+    if(bound != best_len)
+      return bound > best_len;
+    
+    // it can only draw level on length, so the written part decides
+    unsigned int len = ChainLength(chains[i]);
+    int cmp = chains[i].compare(0,len,chains[best],0,len);
+    if(cmp)
+      return cmp < 0;
+    return len == best_len && (int)i > best; 
+  }
+
+  void Offer(unsigned int i){
+    chains[i].resize(ChainLength(chains[i])); // trail cleaning
+    if(best < 0){
+      best = i;
+      return;
+    }
+
+    if(chains[i].size() < chains[best].size())
+      best = i;
+    else if(chains[i].size() == chains[best].size()){
+      int cmp = chains[i].compare(chains[best]);
+      if(cmp > 0 || (cmp == 0 && (int)i < best))
+        best = i; 
+    }
+  }
+
+  // resume on its own until it finishes or falls behind the best
+  void Finish(unsigned int i){
+    while(!Beaten(i)){
+      if(done[i]){
+        Offer(i);
+        return; 
+      }
+      Advance(i,chains[i].size());
+    }
+  }
+};
+
+
+/* all start points are written in lock-step one character at a time, any that 
+ * write a lower character than the leader are parked, any that grow past the 
+ * best finished chain are dropped. parked starts can still win by being shorter,
+ * so they are resumed against the best length once the lead line is done */
+WLNSymbol *SelectChainStart(std::vector<WLNSymbol*> &starts, std::set<WLNSymbol*> &component, WLNGraph &graph){
+  if(starts.empty())
+    return 0;
+  else if(starts.size() == 1)
+    return starts[0];
+
+  ChainRace race(starts,component,graph);
+  std::vector<unsigned int> line; 
+  std::vector<unsigned int> parked; 
+  for(unsigned int i=0;i<starts.size();i++)
+    line.push_back(i);
+
+  for(unsigned int k=0;!line.empty();k++){
+    unsigned char top = 0; 
+    std::vector<unsigned int> next; 
+    for(unsigned int l=0;l<line.size();l++){
+      unsigned int i = line[l];
+      race.Advance(i,k); 
+      if(race.chains[i].size() <= k)
+        race.Offer(i); 
+      else if((unsigned char)race.chains[i][k] > top)
+        top = race.chains[i][k];
+    }
+
+    for(unsigned int l=0;l<line.size();l++){
+      unsigned int i = line[l];
+      if(race.chains[i].size() <= k || race.Beaten(i))
+        continue;
+      else if((unsigned char)race.chains[i][k] < top)
+        parked.push_back(i);
+      else
+        next.push_back(i);
+    }
+    line.swap(next);
+  }
+
+  for(unsigned int p=0;p<parked.size();p++)
+    race.Finish(parked[p]);
+
+  return starts[race.best];
+}
+
+
 bool ChainOnlyCanonicalise(WLNGraph &wln_graph, std::set<WLNSymbol*> &whole_set,std::string &store){
   bool ion_write = false;
   
@@ -7244,36 +9138,14 @@ bool ChainOnlyCanonicalise(WLNGraph &wln_graph, std::set<WLNSymbol*> &whole_set,
       std::set<WLNSymbol*> symbol_set; 
       Reachable(node, symbol_set); 
       
-      std::string last_chain;
-      WLNSymbol *best_start_point = 0; 
-
+      std::vector<WLNSymbol*> starts; 
       for(std::set<WLNSymbol*>::iterator siter = symbol_set.begin();siter != symbol_set.end(); siter++){
-        if( (!(*siter)->barr_n || !(*siter)->parr_n) && !(*siter)->inRing){
-          std::string new_chain; 
-          CanonicalWLNChain(*siter, wln_graph, 0,new_chain); 
-          while(new_chain.back() == '&') // trail cleaning
-            new_chain.pop_back(); 
-          
-          // i think charges must be preserved, so writing here is a must
-
-          if(new_chain.size() < last_chain.size() || last_chain.empty()){
-            last_chain = new_chain;
-            best_start_point = (*siter); 
-          }
-          else if(new_chain.size() == last_chain.size()){ // take the highest ascii character, actually follows rule 2 order
-            for(unsigned int j=0;j<new_chain.size();j++){
-              if(new_chain[j] > last_chain[j]){
-                last_chain = new_chain;
-                best_start_point = (*siter); 
-                break;
-              }
-              else if(new_chain[j] < last_chain[j])
-                break;
-            }
-          }
-        }
+        if( (!(*siter)->barr_n || !(*siter)->parr_n) && !(*siter)->inRing)
+          starts.push_back(*siter);
       }
 
+      WLNSymbol *best_start_point = SelectChainStart(starts, symbol_set, wln_graph); 
+
       // write out the final string, this sets all the charge positions to where they should be
       CanonicalWLNChain(best_start_point, wln_graph, 0,store); 
       whole_set.insert(symbol_set.begin(),symbol_set.end()); 
@@ -7296,13 +9168,13 @@ std::string FullCanonicalise(WLNGraph &graph){
   bool first_write = false;
 
   unsigned int r = 0; 
-  unsigned int b = 0; 
-  WLNRing *sorted_rings[128] = {0};
-  WLNRing *benzyl[128] = {0}; 
+  std::vector<WLNRing*> sorted_rings; // benzenes are written from whatever they hang off
+  std::vector<WLNRing*> benzyl; 
+  sorted_rings.reserve(graph.ring_count);
   for (unsigned int i=0;i<graph.ring_count;i++){
     if(graph.RINGS[i]->str_notation != "L6J"){
-      sorted_rings[r++] = graph.RINGS[i];
-      graph.RINGS[i]->ranking = r; 
+      sorted_rings.push_back(graph.RINGS[i]);
+      graph.RINGS[i]->ranking = ++r; 
     }
     else {
       if(graph.RINGS[i]->loc_count <=1){
@@ -7315,7 +9187,7 @@ std::string FullCanonicalise(WLNGraph &graph){
           }
         }
       }
-      benzyl[b++] = graph.RINGS[i];
+      benzyl.push_back(graph.RINGS[i]);
     }
   }
   
@@ -7397,60 +9269,464 @@ std::string FullCanonicalise(WLNGraph &graph){
                          API FUNCTION
 **********************************************************************/
 
+/* each thread keeps one graph alive and resets it per call, so batch parsing 
+ * stops allocating once the arenas have grown to fit the largest molecule seen */
+static WLNGraph &RecycledGraph(){
+  static thread_local WLNGraph graph;
+  graph.reset();
+  return graph;
+}
+
 bool ReadWLN(const char *ptr, OBMol* mol)
 {   
   if(!ptr){
     fprintf(stderr,"Error: could not read wln string pointer\n");
     return false;
   }
-  else 
-    wln_input = ptr; 
 
-  unsigned int len = strlen(wln_input);
-
-  WLNGraph wln_graph;
+  WLNContext ctx(ptr);
+  WLNGraph &wln_graph = RecycledGraph();
   BabelGraph obabel; 
+  WLNStatsTimer timer;
 
-  if(!ParseWLNString(ptr,wln_graph))
-    return false;
+  if(!ParseWLNString(ptr,wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_PARSE,wln_graph);
+  timer.Lap(WLN_STAGE_PARSE);
 
 #if OPT_DEBUG
   WriteGraph(wln_graph, "wln-graph.dot"); 
 #endif
     // needs to be this order to allow K to take the methyl groups
-  if(!WLNKekulize(wln_graph))
-    return Fatal(len,"Error: failed to kekulize mol");
+  if(!WLNKekulize(wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_KEKULIZE,wln_graph);
+  timer.Lap(WLN_STAGE_KEKULIZE);
 
-  if(!ExpandWLNSymbols(wln_graph,len))
+  if(!ExpandWLNSymbols(wln_graph,ctx,ctx.len))
+    return timer.Fail(WLN_STAGE_EXPAND,wln_graph);
+  timer.Lap(WLN_STAGE_EXPAND);
+
+  if(!obabel.ConvertFromWLN(mol,wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_CONVERT,wln_graph);
+  timer.Lap(WLN_STAGE_CONVERT);
+
+  obabel.NMOBSanitizeMol(mol);
+  timer.Lap(WLN_STAGE_SANITIZE);
+  timer.Done(wln_graph,true);
+  return true;
+}
+
+
+/* runs the reader up to the point babel would take over, parse, kekulize and 
+ * expand, then checks every symbol maps onto an atom. nothing is converted */
+bool ValidateWLN(const char *ptr, WLNValidation *result)
+{
+  WLNValidation local;
+  if(!result)
+    result = &local;
+  
+  result->status = WLN_PARSE_ERROR;
+  result->error_pos = 0;
+  result->error_msg = "Error: could not read wln string pointer";
+  if(!ptr)
     return false;
 
-  if(!obabel.ConvertFromWLN(mol,wln_graph,len))
+  WLNContext ctx(ptr);
+  WLNGraph &wln_graph = RecycledGraph();
+
+  if(!ParseWLNString(ptr,wln_graph,ctx))
+    result->status = WLN_PARSE_ERROR;
+  else if(!WLNKekulize(wln_graph,ctx))
+    result->status = WLN_KEKULE_ERROR;
+  else if(!ExpandWLNSymbols(wln_graph,ctx,ctx.len))
+    result->status = WLN_EXPAND_ERROR;
+  else{
+    for (unsigned int i=0; i<wln_graph.symbol_count;i++){
+      WLNSymbol *sym = wln_graph.SYMBOLS[i];
+      int charge = 0; 
+      unsigned int atomic_num = 0;
+      unsigned int hcount = 0;
+      if(sym->ch == '#') // chains are always carbon
+        continue;
+      
+      if(!WLNSymbolAtom(sym,atomic_num,charge,hcount)){
+        result->status = WLN_EXPAND_ERROR;
+        result->error_pos = sym->str_position;
+        result->error_msg = "Error: symbol does not map onto an atom";
+        return false;
+      }
+    }
+
+    result->status = WLN_VALID;
+    result->error_msg = 0;
+    return true;
+  }
+
+  // some failures return without a fatal call, keep the last known position
+  result->error_pos = ctx.error_pos;
+  result->error_msg = ctx.error_msg ? ctx.error_msg : "Error: invalid wln string";
+  return false;
+}
+
+/* hit and miss counts for the ring template cache, shared by every thread */
+void WLNRingCacheStats(unsigned long *hits, unsigned long *misses, unsigned int *size)
+{
+  if(hits)
+    *hits = ring_cache.hits;
+  if(misses)
+    *misses = ring_cache.misses;
+  if(size){
+    std::lock_guard<std::mutex> guard(ring_cache.lock);
+    *size = ring_cache.templates.size();
+  }
+}
+
+/* wln straight to smiles, skips the babel object model entirely. the output is
+ * kekule and not canonical, but describes the same molecule as ReadWLN */
+bool WLNToSmiles(const char *ptr, std::string &buffer)
+{
+  if(!ptr){
+    fprintf(stderr,"Error: could not read wln string pointer\n");
     return false;
+  }
 
-  obabel.NMOBSanitizeMol(mol);
+  WLNContext ctx(ptr);
+  WLNGraph &wln_graph = RecycledGraph();
+
+  static thread_local SmilesGraph smiles;
+  smiles.reset();
+  WLNStatsTimer timer;
+
+  if(!ParseWLNString(ptr,wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_PARSE,wln_graph);
+  timer.Lap(WLN_STAGE_PARSE);
+
+  if(!WLNKekulize(wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_KEKULIZE,wln_graph);
+  timer.Lap(WLN_STAGE_KEKULIZE);
+
+  if(!ExpandWLNSymbols(wln_graph,ctx,ctx.len))
+    return timer.Fail(WLN_STAGE_EXPAND,wln_graph);
+  timer.Lap(WLN_STAGE_EXPAND);
+
+  if(!smiles.Build(wln_graph) || !smiles.WriteSmiles(buffer))
+    return timer.Fail(WLN_STAGE_CONVERT,wln_graph);
+  timer.Lap(WLN_STAGE_CONVERT);
+  timer.Done(wln_graph,true);
   return true;
 }
 
 
 
+/**********************************************************************
+                         Native Graph Hash
+**********************************************************************/
 
-bool CanonicaliseWLN(const char *ptr, OBMol* mol)
-{   
+/* splitmix64 finaliser */
+static inline unsigned long long HashMix(unsigned long long x){
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static inline unsigned long long HashCombine(unsigned long long h, unsigned long long v){
+  return HashMix(h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+}
+
+/* weisfeiler-lehman refinement over the molecule ConvertFromWLN would build, 
+ * bonds in conjugated rings are hashed as one type so any kekule form of the 
+ * same ring system gives the same labels */
+struct GraphHasher{
+  std::vector<unsigned long long> label;
+  std::vector<unsigned long long> next;
+  std::vector<unsigned long long> sorted;
+  std::vector<unsigned int> dirty;       // atoms with a neighbour relabelled last round
+  std::vector<unsigned int> changed;
+  std::vector<unsigned char> queued;
+  std::unordered_map<unsigned long long,unsigned int> class_size;
+  std::vector<unsigned long long> nbrs;
+  std::vector<unsigned char> bond_type;
+  std::vector<unsigned char> pi;         // atom has a double bond inside a ring
+  std::vector<unsigned int> disc;        // dfs discovery order for the bridge search
+  std::vector<unsigned int> low;
+  std::vector<std::pair<unsigned int,unsigned int>> stack; // atom, next neighbour slot
+  std::vector<unsigned int> parent;      // bond into the atom + 1
+
+  bool Skip(SmilesGraph &g, unsigned int b){
+    return g.atoms[g.bonds[b].a].removed || g.atoms[g.bonds[b].b].removed;
+  }
+
+  /* ring bonds are the ones that are not bridges, iterative tarjan */
+  void RingBonds(SmilesGraph &g){
+    unsigned int n = g.atoms.size();
+    disc.assign(n,0);
+    low.assign(n,0);
+    parent.assign(n,0);
+    bond_type.assign(g.bonds.size(),0); // 0 marks a bridge until proven otherwise
+
+    unsigned int count = 0;
+    for(unsigned int root=0;root<n;root++){
+      if(disc[root] || g.atoms[root].removed)
+        continue;
+
+      disc[root] = low[root] = ++count;
+      stack.push_back(std::make_pair(root,g.nbr_start[root]));
+      while(!stack.empty()){
+        unsigned int a = stack.back().first;
+        unsigned int &slot = stack.back().second;
+        if(slot < g.nbr_start[a+1]){
+          unsigned int b = g.nbr_bond[slot++];
+          if(Skip(g,b) || b+1 == parent[a])
+            continue;
+
+          unsigned int w = g.Other(b,a);
+          if(!disc[w]){
+            parent[w] = b+1;
+            disc[w] = low[w] = ++count;
+            stack.push_back(std::make_pair(w,g.nbr_start[w]));
+          }
+          else
+            low[a] = std::min(low[a],disc[w]);
+        }
+        else{
+          stack.pop_back();
+          if(parent[a]){
+            unsigned int b = parent[a]-1;
+            unsigned int p = g.Other(b,a);
+            low[p] = std::min(low[p],low[a]);
+            if(low[a] <= disc[p])
+              bond_type[b] = 1; // in a ring
+          }
+        }
+      }
+    }
+
+    // non tree bonds that survived the search close a ring
+    for(unsigned int b=0;b<g.bonds.size();b++){
+      if(!Skip(g,b) && parent[g.bonds[b].a] != b+1 && parent[g.bonds[b].b] != b+1)
+        bond_type[b] = 1;
+    }
+  }
+
+  void BondTypes(SmilesGraph &g){
+    RingBonds(g);
+    pi.assign(g.atoms.size(),0);
+    for(unsigned int b=0;b<g.bonds.size();b++){
+      if(bond_type[b] && g.bonds[b].order == 2)
+        pi[g.bonds[b].a] = pi[g.bonds[b].b] = 1;
+    }
+
+    for(unsigned int b=0;b<g.bonds.size();b++){
+      unsigned char order = g.bonds[b].order;
+      if(bond_type[b] && order <= 2 && pi[g.bonds[b].a] && pi[g.bonds[b].b])
+        bond_type[b] = 4;
+      else
+        bond_type[b] = order;
+    }
+  }
+
+  /* the atom label combined with its sorted neighbour labels */
+  unsigned long long Signature(SmilesGraph &g, unsigned int a){
+    nbrs.clear();
+    for(unsigned int k=g.nbr_start[a];k<g.nbr_start[a+1];k++){
+      unsigned int b = g.nbr_bond[k];
+      if(Skip(g,b))
+        continue;
+      nbrs.push_back(HashCombine(bond_type[b],label[g.Other(b,a)]));
+    }
+    std::sort(nbrs.begin(),nbrs.end());
+
+    unsigned long long h = label[a];
+    for(unsigned int k=0;k<nbrs.size();k++)
+      h = HashCombine(h,nbrs[k]);
+    return h;
+  }
+
+  void Hash(SmilesGraph &g, unsigned long long *hash){
+    BondTypes(g);
+
+    unsigned int n = g.atoms.size();
+    unsigned int heavy = 0;
+    unsigned int edges = 0;
+    label.assign(n,0);
+    for(unsigned int a=0;a<n;a++){
+      SmilesAtom &atom = g.atoms[a];
+      if(atom.removed)
+        continue;
+      heavy++;
+      unsigned long long h = HashCombine(atom.atomic_num,(unsigned long long)(atom.charge+128));
+      label[a] = HashCombine(h,atom.hcount);
+    }
+
+    // refine until the partition stops splitting. only atoms next to a relabelled atom
+    // can split, and a class that stays whole keeps its label, so a round costs the
+    // neighbourhood of the last split rather than the whole molecule
+    class_size.clear();
+    dirty.clear();
+    queued.assign(n,0);
+    for(unsigned int a=0;a<n;a++){
+      if(g.atoms[a].removed)
+        continue;
+      class_size[label[a]]++;
+      dirty.push_back(a);
+      for(unsigned int k=g.nbr_start[a];k<g.nbr_start[a+1];k++){
+        if(!Skip(g,g.nbr_bond[k]))
+          edges++;
+      }
+    }
+
+    next.assign(n,0);
+    while(!dirty.empty()){
+      for(unsigned int i=0;i<dirty.size();i++)
+        next[dirty[i]] = Signature(g,dirty[i]);
+
+      // group the dirty atoms by class then by new label. a class that splits keeps
+      // its label on the members left clean, or on its largest part when every member 
+      // is dirty, so only the atoms that actually moved dirty their neighbours
+      std::sort(dirty.begin(),dirty.end(),[this](unsigned int x, unsigned int y){
+        if(label[x] != label[y])
+          return label[x] < label[y];
+        if(next[x] != next[y])
+          return next[x] < next[y];
+        return x < y;
+      });
+
+      changed.clear();
+      for(unsigned int i=0;i<dirty.size();){
+        unsigned int j = i;
+        unsigned int keep = i;      // start of the largest part
+        unsigned int keep_n = 0;
+        while(j < dirty.size() && label[dirty[j]] == label[dirty[i]]){
+          unsigned int k = j;
+          while(k < dirty.size() && label[dirty[k]] == label[dirty[j]] && next[dirty[k]] == next[dirty[j]])
+            k++;
+          if(k-j > keep_n){
+            keep = j;
+            keep_n = k-j;
+          }
+          j = k;
+        }
+
+        unsigned int &size = class_size[label[dirty[i]]];
+        if(j-i == size){
+          if(keep_n == size){ // not split
+            i = j;
+            continue;
+          }
+        }
+        else
+          keep_n = 0;
+
+        size -= j-i - keep_n;
+        for(unsigned int k=i;k<j;k++){
+          if(k < keep || k >= keep+keep_n)
+            changed.push_back(dirty[k]);
+        }
+        i = j;
+      }
+
+      for(unsigned int i=0;i<changed.size();i++){
+        unsigned int a = changed[i];
+        label[a] = next[a];
+        class_size[label[a]]++;
+      }
+
+      dirty.clear();
+      for(unsigned int i=0;i<changed.size();i++){
+        unsigned int a = changed[i];
+        for(unsigned int k=g.nbr_start[a];k<g.nbr_start[a+1];k++){
+          unsigned int b = g.nbr_bond[k];
+          unsigned int w = g.Other(b,a);
+          if(Skip(g,b) || queued[w])
+            continue;
+          queued[w] = 1;
+          dirty.push_back(w);
+        }
+      }
+      for(unsigned int i=0;i<dirty.size();i++)
+        queued[dirty[i]] = 0;
+    }
+
+    // a class that never split still holds an older label, one last signature over 
+    // the settled partition puts every atom's neighbourhood back into the hash.
+    // order free reduction over the atom signatures, two seeds give 128 bits
+    sorted.clear();
+    for(unsigned int a=0;a<n;a++){
+      if(!g.atoms[a].removed)
+        sorted.push_back(Signature(g,a));
+    }
+    std::sort(sorted.begin(),sorted.end());
+
+    hash[0] = HashCombine(heavy,edges/2);
+    hash[1] = HashCombine(HashMix(edges/2),heavy ^ 0x5bd1e995ULL);
+    for(unsigned int k=0;k<sorted.size();k++){
+      hash[0] = HashCombine(hash[0],sorted[k]);
+      hash[1] = HashCombine(hash[1],HashMix(sorted[k] ^ 0xc2b2ae3d27d4eb4fULL));
+    }
+  }
+};
+
+/* 128 bit hash of the molecule, equal molecules give equal hashes whatever the 
+ * wln spelling. hash must hold two words */
+bool WLNGraphHash(const char *ptr, unsigned long long *hash)
+{
   if(!ptr){
     fprintf(stderr,"Error: could not read wln string pointer\n");
     return false;
   }
-  else 
-    wln_input = ptr; 
 
-  WLNGraph wln_graph;
-  BabelGraph obabel; 
+  WLNContext ctx(ptr);
+  WLNGraph &wln_graph = RecycledGraph();
+
+  static thread_local SmilesGraph molecule;
+  static thread_local GraphHasher hasher;
+  molecule.reset();
+  WLNStatsTimer timer;
+
+  if(!ParseWLNString(ptr,wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_PARSE,wln_graph);
+  timer.Lap(WLN_STAGE_PARSE);
 
-  if(!ParseWLNString(ptr,wln_graph))
+  if(!WLNKekulize(wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_KEKULIZE,wln_graph);
+  timer.Lap(WLN_STAGE_KEKULIZE);
+
+  if(!ExpandWLNSymbols(wln_graph,ctx,ctx.len))
+    return timer.Fail(WLN_STAGE_EXPAND,wln_graph);
+  timer.Lap(WLN_STAGE_EXPAND);
+
+  if(!molecule.Build(wln_graph))
+    return timer.Fail(WLN_STAGE_CONVERT,wln_graph);
+
+  hasher.Hash(molecule,hash);
+  timer.Lap(WLN_STAGE_CONVERT);
+  timer.Done(wln_graph,true);
+  return true;
+}
+
+
+/* appends the canonical form of the wln string to buffer, nothing is appended 
+ * if the string fails to parse */
+bool CanonicalWLN(const char *ptr, std::string &buffer)
+{   
+  if(!ptr){
+    fprintf(stderr,"Error: could not read wln string pointer\n");
     return false;
+  }
+
+  WLNContext ctx(ptr);
+  WLNGraph &wln_graph = RecycledGraph();
+  WLNStatsTimer timer;
+
+  if(!ParseWLNString(ptr,wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_PARSE,wln_graph);
+  timer.Lap(WLN_STAGE_PARSE);
   
-  if(!WLNKekulize(wln_graph))
-    return false; 
+  if(!WLNKekulize(wln_graph,ctx))
+    return timer.Fail(WLN_STAGE_KEKULIZE,wln_graph);
+  timer.Lap(WLN_STAGE_KEKULIZE);
 
   // more minimal resolve step for certain groups, W removal
   unsigned int stop = wln_graph.symbol_count;
@@ -7462,7 +9738,7 @@ bool CanonicaliseWLN(const char *ptr, OBMol* mol)
       case 'X':
       case 'K':
         if(!resolve_methyls(sym,wln_graph))
-          return false;
+          return timer.Fail(WLN_STAGE_EXPAND,wln_graph);
         break;
 
       case 'W':
@@ -7477,8 +9753,10 @@ bool CanonicaliseWLN(const char *ptr, OBMol* mol)
         break;
     }
   }
+  timer.Lap(WLN_STAGE_EXPAND);
   
   std::string res; 
+  ChainMemo().reset(); // chain runs are keyed on recycled edges
   // if no rings, choose a starting atom and flow from each, ions must be handled seperately
   if(!wln_graph.ring_count){
     std::set<WLNSymbol*> seen_set;
@@ -7488,6 +9766,20 @@ bool CanonicaliseWLN(const char *ptr, OBMol* mol)
     res = FullCanonicalise(wln_graph); 
   
   WritePostCharges(wln_graph, res); 
+  buffer += res; 
+  timer.Lap(WLN_STAGE_CONVERT); // canonical write
+  timer.Done(wln_graph,true);
+  return true;
+}
+
+
+/* kept for existing callers, writes the canonical form to stdout */
+bool CanonicaliseWLN(const char *ptr, OBMol* mol)
+{
+  std::string res; 
+  if(!CanonicalWLN(ptr,res))
+    return false;
+
   std::cout << res << std::endl; 
   return true;
 }
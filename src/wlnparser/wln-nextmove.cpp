@@ -27,6 +27,7 @@ GNU General Public License for more details.
 
 #include <vector>
 #include <numeric>
+#include <string.h>
 
 #include "parser.h"
 
@@ -122,11 +123,40 @@ struct WLNParser {
 
     OpenBabel::OBAtom* prev;
 
+    bool quiet;         // no stderr, the failing offset is kept in error_pos
+    int error_pos;      // -1 until error() is hit
+
+    // parse_ring scratch, held here so reset() keeps the capacity
+    std::vector<int> cycles;
+    std::vector<char> char_vector;
+    std::vector<char> peri_vector;
+    std::vector<char> bridge_vector;
+    std::vector<int> atom_vector;
+    std::vector<unsigned int> size_catch;
+    std::vector<OpenBabel::OBAtom*> ring_atoms;
+    std::string wln_string;
+
+    WLNParser() {
+        reset(0,0);
+        quiet = false;
+    }
+
     WLNParser(const char *wln, OpenBabel::OBMol* m) {
+        reset(wln,m);
+        quiet = false;
+    }
+
+    /* readies the parser for the next string, vectors keep their capacity */
+    void reset(const char *wln, OpenBabel::OBMol* m) {
         mol = m;
         orig = wln;
         ptr = wln;
 
+        stack.clear();
+        rings.clear();
+        atoms.clear();
+
+        error_pos = -1;
         pending = PENDING_NONE;
         prev = nullptr;
         slash = 0;
@@ -143,6 +173,9 @@ struct WLNParser {
 
     // CHANGED THIS FOR PROTOTYPING!!!
     bool error() {
+        error_pos = (int)(ptr-orig);
+        if (quiet)
+            return false;
         fprintf(stderr,"Error: Character %c in %s\n",*ptr,orig);
         unsigned int len = (unsigned int)(ptr-orig)+22;
         for (unsigned int i=0; i<len; i++)
@@ -527,7 +560,8 @@ struct WLNParser {
                 return error();
         }
         if (peri_vector.size() > 2){
-            fprintf(stderr,"Peri Points Greater Than 3 Are Currently Unstable \n");
+            if (!quiet)
+                fprintf(stderr,"Peri Points Greater Than 3 Are Currently Unstable \n");
             return error();}
 
         char_vector.pop_back();
@@ -602,7 +636,8 @@ struct WLNParser {
     }
 #endif 
     OpenBabel::OBAtom* benzene() {
-        std::vector<OpenBabel::OBAtom*> ring;
+        std::vector<OpenBabel::OBAtom*> &ring = ring_atoms;
+        ring.clear();
         new_cycle(ring,6);
         return ring[0];
     }
@@ -709,12 +744,12 @@ struct WLNParser {
         int ring_count = 0;
         int atom_sum = 0;
         int cyclic_set=0;
-        std::vector<int> cycles;
-        std::vector<char> char_vector;
-        std::vector<char> peri_vector;
-        std::vector<char> bridge_vector;
-        std::vector<int> atom_vector;
-        std::string wln_string = ptr;
+        cycles.clear();
+        char_vector.clear();
+        peri_vector.clear();
+        bridge_vector.clear();
+        atom_vector.clear();
+        wln_string.assign(ptr);
         bool poly = false;
         bool peri=false;
         int peri_count=0;
@@ -745,7 +780,8 @@ struct WLNParser {
             for (int i=0; i < wln_string.size();i++){
                 if (std::isdigit(wln_string[i]) && wln_string[i-1] == ' ' && wln_string[i+1] != ' '){ // Change point 1
                     if (wln_string[i+1] >= 'D'){
-                        fprintf(stderr,"Peri Points Greater Than Char Level 3 Are Currently Unstable \n");
+                        if (!quiet)
+                            fprintf(stderr,"Peri Points Greater Than Char Level 3 Are Currently Unstable \n");
                         return error();
                         break;
                     }
@@ -754,7 +790,8 @@ struct WLNParser {
                     peri_atoms = wln_string[i] - '0';
                     peri_index=i;
                     if (peri_count>1){
-                        fprintf(stderr,"Joining Peri System Not yet Supported \n");
+                        if (!quiet)
+                            fprintf(stderr,"Joining Peri System Not yet Supported \n");
                         return error();}
                 }
                 if (wln_string[i] == 'J' && wln_string[i-1] != ' '){
@@ -805,8 +842,9 @@ struct WLNParser {
         }else{
             return error();}
         bool done = false;
-        std::vector <unsigned int> size_catch;
-        std::vector<OpenBabel::OBAtom*> ring;
+        size_catch.clear();
+        std::vector<OpenBabel::OBAtom*> &ring = ring_atoms;
+        ring.clear();
         switch (size) {
             case 3:
                 if (ptr[0]=='6') {
@@ -954,7 +992,8 @@ struct WLNParser {
                             }
                         }
                         if (ali_state==1){
-                            fprintf(stderr, "Aliphatic Ring Selection Under Construction\n");
+                            if (!quiet)
+                                fprintf(stderr, "Aliphatic Ring Selection Under Construction\n");
                             return error();}
                     }
                     ptr++;
@@ -2855,15 +2894,58 @@ struct WLNParser {
 };
 
 
-bool NMReadWLN(const char *ptr, OpenBabel::OBMol* mol)
+/* one parser per thread, reset for every string so the stacks and ring
+ * vectors keep their capacity across calls */
+static bool NMParseWLN(WLNParser &wp, const char *ptr, OpenBabel::OBMol* mol, unsigned int *error_pos)
 {
-    WLNParser wp(ptr,mol);
+    wp.reset(ptr,mol);
+    wp.quiet = error_pos != 0;
+
     int result = wp.parse_inorganic();
-    if (result == 0) {
-        if (!wp.parse())
-            return false;
-    } else if (result < 0)
-        return false;
-    mol->SetDimension(0);
-    return NMOBSanitizeMol(mol);
+    if (result == 0)
+        result = wp.parse() ? 1 : -1;
+
+    if (result > 0) {
+        mol->SetDimension(0);
+        if (NMOBSanitizeMol(mol))
+            return true;
+        wp.error_pos = -1; // whole string parsed, the molecule is bad
+    }
+
+    if (error_pos)
+        *error_pos = wp.error_pos < 0 ? (unsigned int)strlen(ptr) : (unsigned int)wp.error_pos;
+    return false;
+}
+
+/* with error_pos set nothing is written to stderr, the failing character
+ * offset is returned instead, the string length when the molecule itself fails */
+bool NMReadWLN(const char *ptr, OpenBabel::OBMol* mol, unsigned int *error_pos)
+{
+    static thread_local WLNParser wp;
+    return NMParseWLN(wp,ptr,mol,error_pos);
+}
+
+/* quiet batch conversion for whole files, one parser and molecule serve every
+ * line, output records are appended to out with fail_record standing in for any
+ * line that does not convert. returns the number of failed lines */
+unsigned int NMReadWLNBatch(const std::vector<std::string> &lines, OpenBabel::OBConversion &conv,
+                            std::string &out, const char *fail_record)
+{
+    static thread_local WLNParser wp;
+    OpenBabel::OBMol mol;
+    unsigned int failed = 0;
+    unsigned int pos = 0;
+
+    for (unsigned int i=0; i<lines.size(); i++) {
+        mol.Clear();
+        const char *wln = lines[i].c_str();
+        if (!*wln || !NMParseWLN(wp,wln,&mol,&pos)) {
+            out += fail_record;
+            out += '\n';
+            failed++;
+            continue;
+        }
+        out += conv.WriteString(&mol);
+    }
+    return failed;
 }
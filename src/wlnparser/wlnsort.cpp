@@ -0,0 +1,615 @@
+
+
+#include <cstring>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "parser.h"
+#include "read_file.h"
+
+#define SORT_LINE_MAX 4096
+#define SORT_RECORD_OVERHEAD 96  // rough per record cost of the strings and vector slot
+#define SORT_FAN_IN 256          // runs merged at once, keeps open files bounded
+#define SORT_IO_BUFFER (1 << 20)
+
+const char *file_inp;
+const char *dup_out;
+const char *tmp_dir;
+unsigned int opt_column = 1;    // tab separated column holding the wln string
+unsigned int opt_id_column = 0; // 0 uses the line number as the source id
+unsigned int opt_threads = 1;
+unsigned long long opt_memory = 1024ULL << 20; // bytes held per run before it is spilled
+
+static void DisplayUsage()
+{
+  fprintf(stderr, "wlnsort <options> -f <file>|-\n");
+  fprintf(stderr, "<options>\n");
+  fprintf(stderr, " -h                   show the help for executable usage\n");
+  fprintf(stderr, " -f <file>            read newline delimited wln from file\n");
+  fprintf(stderr, " -                    read newline delimited wln from stdin\n");
+  fprintf(stderr, " -c <n>               take the wln string from tab separated column n (default 1)\n");
+  fprintf(stderr, " -i <n>               take the source id from tab separated column n (default line number)\n");
+  fprintf(stderr, " -j <n>               canonicalise on n threads\n");
+  fprintf(stderr, " -m <mb>[k]           memory for each sorted run before it is spilled, k for kilobytes (default 1024)\n");
+  fprintf(stderr, " -t <dir>             directory for the spilled runs (default $TMPDIR or /tmp)\n");
+  fprintf(stderr, " -d <file>            write the duplicate map, one 'id<TAB>first id' per duplicate\n"
+                  "                      then one 'id<TAB>*error*' per line that failed\n");
+  exit(1);
+}
+
+static void DisplayHelp()
+{
+  fprintf(stderr, "\n--- wisswesser notation sort ---\n\n");
+  fprintf(stderr, " Canonicalises every wln string in a file and writes\n"
+                  " each canonical form once with the first source id\n"
+                  " it was seen with, memory is bounded by spilling sorted\n"
+                  " runs to disk and merging them\n"
+        );
+  DisplayUsage();
+}
+
+static unsigned int PositiveArg(int argc, char *argv[], int i, const char *msg)
+{
+  if(i+1 >= argc || atoi(argv[i+1]) < 1){
+    fprintf(stderr,"Error: %s\n",msg);
+    DisplayUsage();
+  }
+  return atoi(argv[i+1]);
+}
+
+/* megabytes, or kilobytes with a trailing k so small inputs can be made to spill */
+static unsigned long long MemoryArg(int argc, char *argv[], int i)
+{
+  unsigned long long size = PositiveArg(argc,argv,i,"-m requires a size in MB > 0");
+  const char *unit = argv[i+1];
+  while(*unit >= '0' && *unit <= '9')
+    unit++;
+
+  if(!*unit)
+    return size << 20;
+  else if((*unit == 'k' || *unit == 'K') && !unit[1])
+    return size << 10;
+
+  fprintf(stderr,"Error: -m takes a size in MB, or in KB with a k suffix\n");
+  DisplayUsage();
+  return 0;
+}
+
+static void ProcessCommandLine(int argc, char *argv[])
+{
+  const char *ptr = 0;
+  int i;
+
+  file_inp = (const char *)0;
+  dup_out = (const char *)0;
+  tmp_dir = getenv("TMPDIR");
+  if(!tmp_dir || !*tmp_dir)
+    tmp_dir = "/tmp";
+
+  if (argc < 2)
+    DisplayUsage();
+
+  for (i = 1; i < argc; i++)
+  {
+    ptr = argv[i];
+    if (ptr[0] == '-' && !ptr[1]){
+      file_inp = ptr; // stdin
+      continue;
+    }
+
+    if (ptr[0] != '-'){
+      fprintf(stderr, "Error: unrecognised input %s\n", ptr);
+      DisplayUsage();
+    }
+
+    switch (ptr[1])
+    {
+      case 'h':
+        DisplayHelp();
+
+      case 'f':
+        if(i+1 >= argc){
+          fprintf(stderr,"Error: -f requires a file path\n");
+          DisplayUsage();
+        }
+        file_inp = argv[++i];
+        break;
+
+      case 'c':
+        opt_column = PositiveArg(argc,argv,i++,"-c requires a column number > 0");
+        break;
+
+      case 'i':
+        opt_id_column = PositiveArg(argc,argv,i++,"-i requires a column number > 0");
+        break;
+
+      case 'j':
+        opt_threads = PositiveArg(argc,argv,i++,"-j requires a thread count > 0");
+        break;
+
+      case 'm':
+        opt_memory = MemoryArg(argc,argv,i++);
+        break;
+
+      case 't':
+        if(i+1 >= argc){
+          fprintf(stderr,"Error: -t requires a directory\n");
+          DisplayUsage();
+        }
+        tmp_dir = argv[++i];
+        break;
+
+      case 'd':
+        if(i+1 >= argc){
+          fprintf(stderr,"Error: -d requires a file path\n");
+          DisplayUsage();
+        }
+        dup_out = argv[++i];
+        break;
+
+      default:
+        fprintf(stderr, "Error: unrecognised input %s\n", ptr);
+        DisplayUsage();
+    }
+  }
+
+  if(!file_inp){
+    fprintf(stderr,"Error: no input file entered\n");
+    DisplayUsage();
+  }
+
+  return;
+}
+
+/* pointer to the nth tab separated column, the column is not terminated */
+static const char *FindColumn(const char *line, unsigned int column, unsigned int *len)
+{
+  const char *ptr = line;
+  for(unsigned int c=1;c<column;c++){
+    ptr = strchr(ptr,'\t');
+    if(!ptr)
+      return 0;
+    ptr++;
+  }
+
+  *len = strcspn(ptr,"\t\r\n");
+  return ptr;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+
+/**********************************************************************
+                         Sorted Runs
+**********************************************************************/
+
+/* one input line, seq is the line position so the first source wins ties */
+struct SortRecord{
+  std::string wln; // canonical form once the run is converted
+  std::string id;
+  unsigned long long seq;
+  bool failed;
+};
+
+static bool RecordLess(const SortRecord *a, const SortRecord *b)
+{
+  int cmp = a->wln.compare(b->wln);
+  if(cmp)
+    return cmp < 0;
+  return a->seq < b->seq;
+}
+
+/* run files hold "canonical<TAB>seq<TAB>id" lines sorted on canonical then seq */
+struct RunFile{
+  std::string path;
+  FILE *fp;
+  char *io;
+
+  RunFile(){
+    fp = 0;
+    io = 0;
+  }
+
+  bool Create(const char *dir){
+    path = dir;
+    path += "/wlnsort.XXXXXX";
+    int fd = mkstemp(&path[0]);
+    if(fd < 0 || !(fp = fdopen(fd,"w+"))){
+      fprintf(stderr,"Error: could not create a run file in %s\n",dir);
+      return false;
+    }
+    io = (char*)malloc(SORT_IO_BUFFER);
+    setvbuf(fp,io,_IOFBF,SORT_IO_BUFFER);
+    return true;
+  }
+
+  void Rewind(){
+    fflush(fp);
+    rewind(fp);
+  }
+
+  void Remove(){
+    if(fp)
+      fclose(fp);
+    unlink(path.c_str());
+    free(io);
+    fp = 0;
+    io = 0;
+  }
+};
+
+/* running totals for the phase reports */
+struct SortStats{
+  unsigned long long lines;
+  unsigned long long failed;
+  unsigned long long unique;
+  unsigned long long duplicates;
+  unsigned long long spilled;  // bytes written to run files
+  unsigned long long merged;   // bytes read back from run files
+  unsigned long long written;  // bytes of unique list and duplicate map
+  unsigned int runs;
+  unsigned int passes;
+
+  SortStats(){
+    memset(this,0,sizeof(SortStats));
+  }
+};
+
+/* canonicalises a slice of the run, CanonicalWLN keeps its graphs per thread */
+static void CanonicaliseSlice(std::vector<SortRecord> *records, std::atomic<unsigned int> *next)
+{
+  std::string canonical;
+  for(;;){
+    unsigned int i = (*next)++;
+    if(i >= records->size())
+      return;
+
+    SortRecord &rec = (*records)[i];
+    canonical.clear();
+    if(rec.wln.empty() || !CanonicalWLN(rec.wln.c_str(),canonical))
+      rec.failed = true;
+    else
+      rec.wln = canonical;
+  }
+}
+
+/* converts, sorts and writes one run, failed lines are counted and their ids 
+ * go to the failures file when there is a duplicate map to report them in */
+static bool SpillRun(std::vector<SortRecord> &records, std::vector<RunFile> &runs, RunFile *failures, SortStats &stats)
+{
+  std::atomic<unsigned int> next(0);
+  std::vector<std::thread> pool;
+  for(unsigned int t=1;t<opt_threads;t++)
+    pool.push_back(std::thread(CanonicaliseSlice,&records,&next));
+  CanonicaliseSlice(&records,&next);
+  for(unsigned int t=0;t<pool.size();t++)
+    pool[t].join();
+
+  std::vector<SortRecord*> order;
+  order.reserve(records.size());
+  for(unsigned int i=0;i<records.size();i++){
+    if(!records[i].failed)
+      order.push_back(&records[i]);
+    else{
+      stats.failed++;
+      if(failures && fprintf(failures->fp,"%s\n",records[i].id.c_str()) < 0){
+        fprintf(stderr,"Error: failed writing run file %s\n",failures->path.c_str());
+        return false;
+      }
+    }
+  }
+  std::sort(order.begin(),order.end(),RecordLess);
+
+  RunFile run;
+  if(!run.Create(tmp_dir))
+    return false;
+
+  for(unsigned int i=0;i<order.size();i++){
+    int n = fprintf(run.fp,"%s\t%llu\t%s\n",order[i]->wln.c_str(),order[i]->seq,order[i]->id.c_str());
+    if(n < 0){
+      fprintf(stderr,"Error: failed writing run file %s\n",run.path.c_str());
+      run.Remove();
+      return false;
+    }
+    stats.spilled += n;
+  }
+
+  run.Rewind();
+  runs.push_back(run);
+  stats.runs++;
+  return true;
+}
+
+/* phase one, reads the input in memory sized batches and spills each as a sorted run */
+static bool BuildRuns(FILE *fp, std::vector<RunFile> &runs, RunFile *failures, SortStats &stats)
+{
+  char *buffer = (char*)malloc(sizeof(char) * SORT_LINE_MAX+1);
+  memset(buffer,0,SORT_LINE_MAX+1);
+
+  unsigned long long budget = opt_memory;
+  unsigned long long held = 0;
+  std::vector<SortRecord> records;
+
+  char idbuf[32];
+  bool too_long = false;
+  while(ReadBatchLine(fp,buffer,SORT_LINE_MAX,&too_long)){
+    stats.lines++;
+    records.push_back(SortRecord());
+    SortRecord &rec = records.back();
+    rec.seq = stats.lines;
+    rec.failed = too_long;
+
+    unsigned int len = 0;
+    const char *wln = FindColumn(buffer,opt_column,&len);
+    if(wln && !too_long)
+      rec.wln.assign(wln,len);
+    else if(too_long)
+      fprintf(stderr,"Warning: line %llu is over %d characters, skipped\n",stats.lines,SORT_LINE_MAX);
+
+    // an id running into the end of a cut line may itself be cut, number those
+    const char *id = 0;
+    if(opt_id_column && (id = FindColumn(buffer,opt_id_column,&len)) 
+       && (!too_long || id+len < buffer+SORT_LINE_MAX))
+      rec.id.assign(id,len);
+    else{
+      snprintf(idbuf,32,"%llu",stats.lines);
+      rec.id = idbuf;
+    }
+
+    // the canonical form is of similar size to the input, so budget on the raw line
+    held += rec.wln.size() + rec.id.size() + SORT_RECORD_OVERHEAD;
+    if(held >= budget){
+      if(!SpillRun(records,runs,failures,stats)){
+        free(buffer);
+        return false;
+      }
+      records.clear();
+      held = 0;
+    }
+  }
+
+  bool ok = records.empty() || SpillRun(records,runs,failures,stats);
+  free(buffer);
+  return ok;
+}
+
+
+/**********************************************************************
+                         K-Way Merge
+**********************************************************************/
+
+/* head line of a run, the canonical form is a prefix of line up to the first tab */
+struct MergeHead{
+  char *line;
+  size_t cap;
+  size_t wln_len;
+  unsigned long long seq;
+  unsigned int run;
+
+  const char *id() const{
+    const char *ptr = strchr(line+wln_len+1,'\t');
+    return ptr ? ptr+1 : "";
+  }
+};
+
+static bool HeadRead(MergeHead *head, RunFile &run, SortStats &stats)
+{
+  ssize_t n = getline(&head->line,&head->cap,run.fp);
+  if(n <= 0)
+    return false;
+
+  stats.merged += n;
+  if(head->line[n-1] == '\n')
+    head->line[n-1] = '\0';
+
+  head->wln_len = strcspn(head->line,"\t");
+  head->seq = strtoull(head->line+head->wln_len+1,0,10);
+  return true;
+}
+
+static int HeadCompare(const MergeHead *a, const MergeHead *b)
+{
+  size_t n = std::min(a->wln_len,b->wln_len);
+  int cmp = memcmp(a->line,b->line,n);
+  if(cmp)
+    return cmp;
+  if(a->wln_len != b->wln_len)
+    return a->wln_len < b->wln_len ? -1 : 1;
+  if(a->seq != b->seq)
+    return a->seq < b->seq ? -1 : 1;
+  return 0;
+}
+
+struct HeadGreater{
+  bool operator()(const MergeHead *a, const MergeHead *b) const{
+    return HeadCompare(a,b) > 0;
+  }
+};
+
+/* merges runs[first,last) in order, either into a new run (out) or, when out is
+ * null, into the unique list and duplicate map */
+static bool MergeRuns(std::vector<RunFile> &runs, unsigned int first, unsigned int last,
+                      RunFile *out, FILE *uniq, FILE *dups, SortStats &stats)
+{
+  std::vector<MergeHead> heads(last-first);
+  std::priority_queue<MergeHead*,std::vector<MergeHead*>,HeadGreater> queue;
+  for(unsigned int r=first;r<last;r++){
+    MergeHead *head = &heads[r-first];
+    head->line = 0;
+    head->cap = 0;
+    head->run = r;
+    if(HeadRead(head,runs[r],stats))
+      queue.push(head);
+  }
+
+  std::string last_wln;
+  std::string first_id;
+  bool have_last = false;
+  bool ok = true;
+
+  while(!queue.empty()){
+    MergeHead *head = queue.top();
+    queue.pop();
+
+    if(out){
+      int n = fprintf(out->fp,"%s\n",head->line);
+      if(n < 0)
+        ok = false;
+      stats.spilled += n;
+    }
+    else{
+      if(have_last && last_wln.size() == head->wln_len && !memcmp(last_wln.c_str(),head->line,head->wln_len)){
+        stats.duplicates++;
+        if(dups){
+          int n = fprintf(dups,"%s\t%s\n",head->id(),first_id.c_str());
+          if(n < 0)
+            ok = false;
+          stats.written += n;
+        }
+      }
+      else{
+        last_wln.assign(head->line,head->wln_len);
+        first_id = head->id();
+        have_last = true;
+        stats.unique++;
+
+        int n = fprintf(uniq,"%s\t%s\n",last_wln.c_str(),first_id.c_str());
+        if(n < 0)
+          ok = false;
+        stats.written += n;
+      }
+    }
+
+    if(HeadRead(head,runs[head->run],stats))
+      queue.push(head);
+  }
+
+  for(unsigned int h=0;h<heads.size();h++)
+    free(heads[h].line);
+
+  if(!ok)
+    fprintf(stderr,"Error: write failed during merge\n");
+  return ok;
+}
+
+/* phase two, folds the runs down SORT_FAN_IN at a time, the final pass writes the output */
+static bool MergeAll(std::vector<RunFile> &runs, FILE *uniq, FILE *dups, SortStats &stats)
+{
+  while(runs.size() > SORT_FAN_IN){
+    std::vector<RunFile> next;
+    for(unsigned int r=0;r<runs.size();r+=SORT_FAN_IN){
+      unsigned int last = std::min((unsigned int)runs.size(),r+SORT_FAN_IN);
+      RunFile merged;
+      if(!merged.Create(tmp_dir) || !MergeRuns(runs,r,last,&merged,0,0,stats)){
+        merged.Remove();
+        for(unsigned int m=0;m<next.size();m++)
+          next[m].Remove();
+        return false;
+      }
+
+      merged.Rewind();
+      next.push_back(merged);
+      for(unsigned int m=r;m<last;m++)
+        runs[m].Remove();
+    }
+    runs.swap(next); // merged runs were removed above, the caller cleans the rest
+    stats.passes++;
+  }
+
+  stats.passes++;
+  return MergeRuns(runs,0,runs.size(),0,uniq,dups,stats);
+}
+
+/* the error section of the duplicate map, so every source id is accounted for */
+static bool WriteFailures(RunFile &failures, FILE *dups, SortStats &stats)
+{
+  char *line = 0;
+  size_t cap = 0;
+  ssize_t n = 0;
+  bool ok = true;
+
+  failures.Rewind();
+  while((n = getline(&line,&cap,failures.fp)) > 0){
+    if(line[n-1] == '\n')
+      line[n-1] = '\0';
+    int w = fprintf(dups,"%s\t*error*\n",line);
+    if(w < 0)
+      ok = false;
+    stats.written += w;
+  }
+
+  free(line);
+  if(!ok)
+    fprintf(stderr,"Error: write failed on the duplicate map\n");
+  return ok;
+}
+
+
+int main(int argc, char *argv[])
+{
+  ProcessCommandLine(argc, argv);
+
+  FILE *fp = stdin;
+  if(strcmp(file_inp,"-")){
+    fp = fopen(file_inp,"r");
+    if(!fp){
+      fprintf(stderr,"Error: unable to open file at: %s\n",file_inp);
+      return 1;
+    }
+  }
+
+  FILE *dups = 0;
+  if(dup_out && !(dups = fopen(dup_out,"w"))){
+    fprintf(stderr,"Error: unable to open duplicate map at: %s\n",dup_out);
+    return 1;
+  }
+
+  SortStats stats;
+  std::vector<RunFile> runs;
+  RunFile failures; // failed ids, held until the duplicates are written
+  if(dups && !failures.Create(tmp_dir))
+    return 1;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  bool ok = BuildRuns(fp,runs,dups ? &failures : 0,stats);
+  double build_time = Seconds(start);
+  if(fp != stdin)
+    fclose(fp);
+
+  fprintf(stderr,"canonicalise: %llu lines, %llu failed, %u runs, %.1f MB spilled, %.2f sec\n",
+          stats.lines,stats.failed,stats.runs,stats.spilled/1048576.0,build_time);
+
+  if(ok){
+    unsigned long long spilled = stats.spilled;
+    start = std::chrono::steady_clock::now();
+    ok = MergeAll(runs,stdout,dups,stats);
+    if(ok && dups)
+      ok = WriteFailures(failures,dups,stats);
+    fflush(stdout);
+
+    fprintf(stderr,"merge: %u passes, %.1f MB read, %.1f MB respilled, %.1f MB written, %.2f sec\n",
+            stats.passes,stats.merged/1048576.0,(stats.spilled-spilled)/1048576.0,stats.written/1048576.0,Seconds(start));
+    fprintf(stderr,"  %llu unique, %llu duplicates\n",stats.unique,stats.duplicates);
+  }
+
+  for(unsigned int r=0;r<runs.size();r++)
+    runs[r].Remove();
+  if(dups){
+    failures.Remove();
+    fclose(dups);
+  }
+  return ok ? 0:1;
+}
@@ -2,6 +2,18 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
 #include <openbabel/mol.h>
 #include <openbabel/plugin.h>
 #include <openbabel/atom.h>
@@ -14,23 +26,35 @@
 #include <openbabel/obmolecformat.h>
 
 #include "parser.h"
+#include "read_file.h"
 
 using namespace OpenBabel; 
 
 #define REASONABLE 1024
+#define BATCH_LINE_MAX 4096
+#define BATCH_ERROR "*error*"
+#define BATCH_CHUNK 32      // records handed to a worker at a time, kept small so ring heavy chunks can be stolen
+#define BATCH_INFLIGHT 8    // chunks held per worker before the reader blocks
 
 const char *cli_inp;
+const char *file_inp;
 const char *format; 
 
 bool opt_modern = false;
+unsigned int opt_threads = 1;
+bool opt_bound = true;
 
 static void DisplayUsage()
 {
   fprintf(stderr, "writewln <options> -i<format> <input (escaped)>\n");
+  fprintf(stderr, "writewln <options> -i<format> -f <file>\n");
   fprintf(stderr, "<options>\n");
   fprintf(stderr, "  -h                    show the help for executable usage\n");
-  fprintf(stderr, "  -i                    choose input format (-ismi, -iinchi, -ican, -imol)\n");
+  fprintf(stderr, "  -i                    choose input format (-ismi, -iinchi, -ican, -imol, -isdf)\n");
+  fprintf(stderr, "  -f <file>             write a wln per record of a file, - reads stdin\n");
+  fprintf(stderr, "  -j <n>                convert a file on n worker threads, output keeps the input order\n");
   fprintf(stderr, "  -m                    write mwln (modern) strings (part of michaels PhD work\n");
+  fprintf(stderr, "  --no-bound            walk every locant path, only for measuring the path bound\n");
   exit(1);
 }
 
@@ -53,6 +77,7 @@ static void ProcessCommandLine(int argc, char *argv[])
   unsigned int j = 0;
 
   cli_inp = (const char *)0;
+  file_inp = (const char *)0;
   format = (const char *)0;
 
   if (argc < 2)
@@ -62,6 +87,11 @@ static void ProcessCommandLine(int argc, char *argv[])
   {
 
     ptr = argv[i];
+    if (ptr[0] == '-' && !ptr[1]){
+      file_inp = ptr; // stdin
+      continue;
+    }
+
     if (ptr[0] == '-' && ptr[1]){
       switch (ptr[1]){
 
@@ -94,15 +124,44 @@ static void ProcessCommandLine(int argc, char *argv[])
             format = "mol";
             break;
           }
+          else if (!strcmp(ptr, "-isdf"))
+          {
+            format = "sdf";
+            break;
+          }
           else{
-            fprintf(stderr,"Error: unrecognised format, choose between ['smi','smy','inchi','can','mol']\n");
+            fprintf(stderr,"Error: unrecognised format, choose between ['smi','smy','inchi','can','mol','sdf']\n");
             DisplayUsage();
           }
 
+        case 'f':
+          if(i+1 >= argc){
+            fprintf(stderr,"Error: -f requires a file path\n");
+            DisplayUsage();
+          }
+          file_inp = argv[++i];
+          break;
+
+        case 'j':
+          if(i+1 >= argc || atoi(argv[i+1]) < 1){
+            fprintf(stderr,"Error: -j requires a thread count > 0\n");
+            DisplayUsage();
+          }
+          opt_threads = atoi(argv[++i]);
+          break;
+
         case 'm':
           opt_modern = true;
           break;
 
+        case '-':
+          if(!strcmp(ptr, "--no-bound")){
+            opt_bound = false;
+            break;
+          }
+          fprintf(stderr, "Error: unrecognised input %s\n", ptr);
+          DisplayUsage();
+
         default:
           fprintf(stderr, "Error: unrecognised input %s\n", ptr);
           DisplayUsage();
@@ -128,11 +187,24 @@ static void ProcessCommandLine(int argc, char *argv[])
     DisplayUsage();
   }
 
-  if(!cli_inp){
+  if(!cli_inp && !file_inp){
     fprintf(stderr,"Error: no input string entered\n");
     DisplayUsage();
   }
 
+  if(cli_inp && file_inp){
+    fprintf(stderr,"Error: give either an input string or a file, not both\n");
+    DisplayUsage();
+  }
+
+  if(opt_threads > 1 && !file_inp){
+    fprintf(stderr,"Error: -j can only be used with file input\n");
+    DisplayUsage();
+  }
+
+  if(!file_inp && !strcmp(format,"sdf"))
+    format = "mol"; // a single record reads the same either way
+
 
   if(opt_modern)
     fprintf(stderr,"Warning: modern wln functions not fully functional\n");
@@ -140,9 +212,476 @@ static void ProcessCommandLine(int argc, char *argv[])
   return;
 }
 
+/* one input record. smiles and inchi keep their line and are read by whoever
+ * converts them, mol and sdf records are read by babel as the file is walked
+ * and mol points at the result, cleared when babel could not read it */
+struct BatchRecord{
+  std::string text;
+  OBMol *mol;
+};
+
+/* converts one record, the wln and id are written tab separated, a record that
+ * does not read or write gives an error line in its place and the stage the
+ * writer stopped at, WLN_WRITE_STAGE_NONE when the record did not read */
+static bool ConvertRecord(const BatchRecord &record, unsigned int n, OBMol &mol, OBConversion &conv, std::string &out,
+                          WLNWriteStage *stage)
+{
+  *stage = WLN_WRITE_STAGE_NONE;
+  OBMol *read = record.mol;
+  bool ok = true;
+  if(!read){
+    mol.Clear();
+    mol.SetTitle(""); // a blank line must not pick up the last title
+    ok = !record.text.empty() && conv.ReadString(&mol,record.text);
+    read = &mol;
+  }
+
+  // smiles and inchi take the id from the text after the notation,
+  // mol blocks from the title line
+  std::string id = read->GetTitle();
+  if(id.empty()){
+    size_t sep = record.text.find_first_of(" \t");
+    if(sep != std::string::npos && (sep = record.text.find_first_not_of(" \t",sep)) != std::string::npos)
+      id = record.text.substr(sep);
+    while(!id.empty() && (id.back() == '\n' || id.back() == '\r'))
+      id.pop_back();
+    if(id.empty())
+      id = std::to_string(n);
+  }
+
+  WLNWriteError error;
+  if(!ok || !read->NumAtoms())
+    ok = false;
+  else if(!WriteWLN(out,read,opt_modern,&error)){
+    *stage = error.stage;
+    ok = false;
+  }
+
+  if(!ok)
+    out += BATCH_ERROR;
+  out += '\t';
+  out += id;
+  out += '\n';
+  return ok;
+}
+
+/* hands out the records of a file in order, every record gives exactly one
+ * output line. smiles and inchi are taken a line at a time, a blank line or
+ * one over BATCH_LINE_MAX comes back with no text so it is written as a failed
+ * read. mol and sdf go through OBConversion::Read over the stream, a record
+ * babel fails on is skipped to its $$$$ and comes back cleared */
+struct RecordReader{
+  FILE *fp;
+  std::istream *is;
+  std::ifstream file;
+  OBConversion conv;
+  char *buffer;
+  bool blocks;
+
+  RecordReader(){
+    fp = 0;
+    is = 0;
+    buffer = 0;
+    blocks = !strcmp(format,"mol") || !strcmp(format,"sdf");
+  }
+
+  ~RecordReader(){
+    if(fp && fp != stdin)
+      fclose(fp);
+    free(buffer);
+  }
+
+  bool Open(const char *path){
+    bool from_stdin = !strcmp(path,"-");
+    if(blocks){
+      if(from_stdin)
+        is = &std::cin;
+      else{
+        file.open(path);
+        if(!file.is_open())
+          return false;
+        is = &file;
+      }
+      conv.SetInFormat(format);
+      conv.SetInStream(is);
+      return true;
+    }
+
+    fp = from_stdin ? stdin : fopen(path,"r");
+    if(!fp)
+      return false;
+    buffer = (char*)malloc(sizeof(char) * BATCH_LINE_MAX+1);
+    memset(buffer,0,BATCH_LINE_MAX+1);
+    return true;
+  }
+
+  /* false once the file is done, mol is only used for mol and sdf */
+  bool Next(BatchRecord &record, OBMol *mol, bool *too_long){
+    *too_long = false;
+    record.text.clear();
+    record.mol = 0;
+
+    if(blocks){
+      if(!is->good() || is->peek() == EOF)
+        return false;
+      record.mol = mol;
+      if(!conv.Read(mol)){
+        mol->Clear();
+        mol->SetTitle("");
+        if(is->good())
+          conv.GetInFormat()->SkipObjects(0,&conv);
+      }
+      return true;
+    }
+
+    if(!ReadBatchLine(fp,buffer,BATCH_LINE_MAX,too_long))
+      return false;
+    if(*too_long)
+      return true;
+
+    char *end = buffer + strlen(buffer);
+    while(end > buffer && (end[-1] == '\n' || end[-1] == '\r'))
+      *(--end) = '\0';
+    if(buffer[strspn(buffer," \t")])
+      record.text = buffer;
+    return true;
+  }
+};
+
+static void ReportFailures(unsigned int records, unsigned int failed, unsigned int *stages)
+{
+  fprintf(stderr,"%d records read, %d failed\n",records,failed);
+  if(failed){
+    fprintf(stderr,"  read: %u, chain: %u, ring: %u, locant: %u, metal: %u\n",
+            stages[WLN_WRITE_STAGE_NONE],stages[WLN_WRITE_STAGE_CHAIN],stages[WLN_WRITE_STAGE_RING],
+            stages[WLN_WRITE_STAGE_LOCANT],stages[WLN_WRITE_STAGE_METAL]);
+  }
+}
+
+/* how hard the multicyclic locant path search worked over the run */
+static void ReportPathSearch()
+{
+  unsigned long seeds = 0;
+  unsigned long steps = 0;
+  unsigned long scored = 0;
+  unsigned long pruned = 0;
+  WLNPathSearchStats(&seeds,&steps,&scored,&pruned);
+  if(seeds){
+    fprintf(stderr,"  locant paths: %lu seeds, %lu atoms walked, %lu paths scored, %lu cut by the bound\n",
+            seeds,steps,scored,pruned);
+  }
+}
+
+/* streams a file through one converter and molecule */
+static bool ConvertFile(RecordReader &reader)
+{
+  unsigned int records = 0;
+  unsigned int failed = 0;
+  unsigned int stages[WLN_WRITE_STAGE_METAL+1] = {0};
+  WLNWriteStage stage;
+
+  OBMol mol;
+  OBConversion conv;
+  conv.SetInFormat(format);
+
+  BatchRecord record;
+  std::string out;
+  bool too_long = false;
+  while(reader.Next(record,&mol,&too_long)){
+    out.clear();
+    if(too_long)
+      fprintf(stderr,"Warning: record %d has a line over %d characters, skipped\n",records+1,BATCH_LINE_MAX);
+    if(!ConvertRecord(record,++records,mol,conv,out,&stage)){
+      stages[stage]++;
+      failed++;
+    }
+    std::cout << out;
+  }
+
+  std::cout.flush();
+  ReportFailures(records,failed,stages);
+  ReportPathSearch();
+  return true;
+}
+
+/**********************************************************************
+                         Threaded Batch Engine
+**********************************************************************/
+
+/* a run of consecutive records, converted as one unit of work */
+struct BatchChunk{
+  unsigned int id;
+  unsigned int first;   // record number of records[0], for default ids
+  unsigned int failed;
+  unsigned int stages[WLN_WRITE_STAGE_METAL+1];
+  std::vector<BatchRecord> records; // mol and sdf records own their molecule
+  std::string out;
+};
+
+/* one per worker, only ever locked for a single push or pop. the owner works
+ * from the back and thieves from the front, so they meet only on the last chunk */
+struct WorkQueue{
+  std::mutex lock;
+  std::deque<BatchChunk*> chunks;
+};
+
+struct WorkerStats{
+  unsigned int records;
+  unsigned int steals;
+  double seconds;  // time spent converting, excludes waiting on the queues
+};
+
+/* reader -> workers -> writer pipeline. chunks are dealt round robin onto per
+ * worker queues, a worker that runs dry steals from the others so a queue
+ * stuck behind large ring systems is drained by whoever is free. claims only
+ * take the queue locks, the engine lock is for sleeping on an empty pool and
+ * the writer's reorder buffer. the reader blocks once too many chunks are in
+ * flight so memory stays bounded */
+struct BatchEngine{
+  std::mutex lock;
+  std::condition_variable work_ready;
+  std::condition_variable done_ready;
+  std::condition_variable space_ready;
+
+  std::vector<WorkQueue*> queues;
+  std::map<unsigned int,BatchChunk*> done; // reorder buffer, keyed on chunk id
+
+  std::atomic<unsigned int> queued; // chunks sitting in any queue, raised under lock
+  unsigned int in_flight;
+  unsigned int max_in_flight;
+  unsigned int total_chunks;  // only valid once finished_reading is set
+  unsigned int next_queue;
+  bool finished_reading;
+
+  std::vector<WorkerStats> stats;
+
+  BatchEngine(unsigned int threads){
+    queued = 0;
+    in_flight = 0;
+    max_in_flight = threads * BATCH_INFLIGHT;
+    total_chunks = 0;
+    next_queue = 0;
+    finished_reading = false;
+    stats.resize(threads);
+    for(unsigned int w=0;w<threads;w++)
+      queues.push_back(new WorkQueue);
+  }
+
+  ~BatchEngine(){
+    for(unsigned int w=0;w<queues.size();w++)
+      delete queues[w];
+  }
+
+  /* the push and count happen under the engine lock, so a worker checking
+   * queued before it sleeps cannot miss the wake up */
+  void Submit(BatchChunk *chunk){
+    std::unique_lock<std::mutex> guard(lock);
+    space_ready.wait(guard,[this]{return in_flight < max_in_flight;});
+    in_flight++;
+
+    WorkQueue *q = queues[next_queue++ % queues.size()];
+    {
+      std::lock_guard<std::mutex> qguard(q->lock);
+      q->chunks.push_back(chunk);
+      queued++;
+    }
+    work_ready.notify_one();
+  }
+
+  void Close(unsigned int chunks){
+    std::lock_guard<std::mutex> guard(lock);
+    total_chunks = chunks;
+    finished_reading = true;
+    work_ready.notify_all();
+    done_ready.notify_one();
+  }
+
+  /* pops the newest chunk off the worker's own queue, otherwise steals the
+   * oldest from the next non empty one, the oldest is what the writer is
+   * waiting on. 0 when every queue is empty */
+  BatchChunk *Take(unsigned int w){
+    unsigned int n = queues.size();
+    for(unsigned int k=0;k<n;k++){
+      WorkQueue *q = queues[(w+k) % n];
+      std::lock_guard<std::mutex> guard(q->lock);
+      if(q->chunks.empty())
+        continue;
+
+      BatchChunk *chunk = 0;
+      if(!k){
+        chunk = q->chunks.back();
+        q->chunks.pop_back();
+      }
+      else{
+        chunk = q->chunks.front();
+        q->chunks.pop_front();
+        stats[w].steals++;
+      }
+      queued--;
+      return chunk;
+    }
+    return 0;
+  }
+
+  /* each worker owns its own babel objects, WriteWLN keeps its state per thread */
+  void Worker(unsigned int w){
+    OBMol mol;
+    OBConversion conv;
+    conv.SetInFormat(format);
+    WLNWriteStage stage;
+
+    for(;;){
+      BatchChunk *chunk = Take(w);
+      if(!chunk){
+        std::unique_lock<std::mutex> guard(lock);
+        work_ready.wait(guard,[this]{return queued || finished_reading;});
+        if(!queued)
+          return;
+        continue;
+      }
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for(unsigned int i=0;i<chunk->records.size();i++){
+        if(!ConvertRecord(chunk->records[i],chunk->first+i,mol,conv,chunk->out,&stage)){
+          chunk->stages[stage]++;
+          chunk->failed++;
+        }
+        delete chunk->records[i].mol;
+        chunk->records[i].mol = 0;
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      std::lock_guard<std::mutex> guard(lock);
+      stats[w].records += chunk->records.size();
+      stats[w].seconds += elapsed.count();
+      done[chunk->id] = chunk;
+      done_ready.notify_one();
+    }
+  }
+
+  /* writes chunks strictly in input order, failures are summed into stages */
+  unsigned int Writer(unsigned int *stages){
+    unsigned int next = 0;
+    unsigned int failed = 0;
+    for(;;){
+      BatchChunk *chunk = 0;
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        done_ready.wait(guard,[this,next]{
+          return done.count(next) || (finished_reading && next == total_chunks);
+        });
+        if(!done.count(next))
+          return failed;
+        chunk = done[next];
+        done.erase(next);
+        in_flight--;
+        space_ready.notify_one();
+      }
+
+      std::cout << chunk->out;
+      failed += chunk->failed;
+      for(unsigned int s=0;s<=WLN_WRITE_STAGE_METAL;s++)
+        stages[s] += chunk->stages[s];
+      delete chunk;
+      next++;
+    }
+  }
+};
+
+/* threaded version of ConvertFile, records are chunked onto a worker pool and
+ * written back in input order */
+static bool ConvertFileThreaded(RecordReader &reader, unsigned int threads)
+{
+  unsigned int records = 0;
+  unsigned int chunks = 0;
+  unsigned int failed = 0;
+  unsigned int stages[WLN_WRITE_STAGE_METAL+1] = {0};
+
+  // babel loads its format plugins on first use, do that before any threads start
+  OBConversion warmup;
+  if(!warmup.SetInFormat(format)){
+    fprintf(stderr,"Error: babel could not load format %s\n",format);
+    return false;
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  BatchEngine engine(threads);
+  std::vector<std::thread> pool;
+  for(unsigned int w=0;w<threads;w++)
+    pool.push_back(std::thread(&BatchEngine::Worker,&engine,w));
+
+  std::thread writer([&engine,&failed,&stages]{ failed = engine.Writer(stages); });
+
+  BatchChunk *chunk = 0;
+  BatchRecord record;
+  OBMol *mol = reader.blocks ? new OBMol : 0;
+  bool too_long = false;
+  while(reader.Next(record,mol,&too_long)){
+    records++;
+    if(too_long)
+      fprintf(stderr,"Warning: record %d has a line over %d characters, skipped\n",records,BATCH_LINE_MAX);
+    if(!chunk){
+      chunk = new BatchChunk;
+      chunk->first = records;
+      chunk->failed = 0;
+      memset(chunk->stages,0,sizeof(chunk->stages));
+      chunk->records.reserve(BATCH_CHUNK);
+    }
+
+    chunk->records.push_back(record);
+    if(mol)
+      mol = new OBMol; // the chunk owns the one just read
+    if(chunk->records.size() == BATCH_CHUNK){
+      chunk->id = chunks++;
+      engine.Submit(chunk);
+      chunk = 0;
+    }
+  }
+
+  if(chunk){
+    chunk->id = chunks++;
+    engine.Submit(chunk);
+  }
+
+  delete mol;
+  engine.Close(chunks);
+  for(unsigned int w=0;w<threads;w++)
+    pool[w].join();
+  writer.join();
+
+  std::cout.flush();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  ReportFailures(records,failed,stages);
+  ReportPathSearch();
+  for(unsigned int w=0;w<threads;w++){
+    WorkerStats &ws = engine.stats[w];
+    fprintf(stderr,"  worker %d: %d records, %d stolen chunks, %.0f records/sec\n",w,ws.records,ws.steals,
+            ws.seconds > 0 ? ws.records/ws.seconds : 0.0);
+  }
+  fprintf(stderr,"  total: %.0f records/sec over %.2f sec\n", elapsed.count() > 0 ? records/elapsed.count() : 0.0,elapsed.count());
+  return true;
+}
+
 int main(int argc, char *argv[])
 {
   ProcessCommandLine(argc, argv);
+  WLNPathBound(opt_bound);
+
+  if(file_inp){
+    RecordReader reader;
+    if(!reader.Open(file_inp)){
+      fprintf(stderr,"Error: unable to open file at: %s\n",file_inp);
+      return 1; 
+    }
+
+    if(opt_threads > 1)
+      ConvertFileThreaded(reader,opt_threads);
+    else
+      ConvertFile(reader);
+    return 0;
+  }
   
   bool res;
   OBMol mol;
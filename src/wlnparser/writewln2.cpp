@@ -23,6 +23,7 @@ GNU General Public License for more details.
 #include <stack>
 #include <map>
 #include <string>
+#include <atomic>
 
 #include <utility> // std::pair
 #include <iterator>
@@ -76,9 +77,84 @@ struct SubsetData{
 };
 
 
-static void Fatal(const char *str){
+/* ring sets are walked in order, keying them on the molecule's indices rather than
+ * the heap addresses babel handed out keeps the notation independent of the allocator */
+struct AtomIdxLess{
+  bool operator()(const OBAtom *a, const OBAtom *b) const { return a->GetIdx() < b->GetIdx(); }
+};
+
+struct BondIdxLess{
+  bool operator()(const OBBond *a, const OBBond *b) const { return a->GetIdx() < b->GetIdx(); }
+};
+
+// sssr rings carry no index, their atom paths are distinct
+struct RingPathLess{
+  bool operator()(const OBRing *a, const OBRing *b) const { return a->_path < b->_path; }
+};
+
+// atom indexes start from 1, bond indexes from 0
+inline unsigned int index_size(OBMol *mol, OBAtom*){ return mol->NumAtoms()+1; }
+inline unsigned int index_size(OBMol *mol, OBBond*){ return mol->NumBonds(); }
+
+/* flat per atom or bond state indexed by GetIdx(), stands in for a std::map keyed 
+ * on the pointer. Reset() bumps the epoch rather than clearing, an entry stamped
+ * with an older epoch reads as T() just as an unseen map key would */
+template <typename K, typename T>
+struct IndexedState{
+  struct Slot{
+    unsigned int epoch;
+    T value;
+  };
+
+  std::vector<Slot> slots;
+  unsigned int epoch = 0;
+  T spare; // null or out of range keys, the map took these silently
+
+  void Reset(OBMol *mol){
+    unsigned int size = index_size(mol,(K*)0);
+    if(slots.size() < size)
+      slots.resize(size,Slot{0,T()});
+    
+    if(++epoch == 0){ // wrapped, stamps could alias
+      for(Slot &slot : slots)
+        slot.epoch = 0;
+      epoch = 1;
+    }
+  }
+
+  T &operator[](K *key){
+    unsigned int idx = key ? key->GetIdx() : slots.size();
+    if(idx >= slots.size()){
+      spare = T();
+      return spare;
+    }
+
+    Slot &slot = slots[idx];
+    if(slot.epoch != epoch){
+      slot.epoch = epoch;
+      slot.value = T();
+    }
+    return slot.value;
+  }
+};
+
+template <typename T> using AtomState = IndexedState<OBAtom,T>;
+template <typename T> using BondState = IndexedState<OBBond,T>;
+
+
+static thread_local WLNWriteError write_error;
+
+/* records the first failure of a write and returns false for the caller to
+ * unwind with, functions that cannot return a failure leave it for WriteWLN
+ * to find after the parse */
+static bool Fatal(WLNWriteStage stage, WLNWriteCode code, const char *str){
   fprintf(stderr,"Fatal: %s\n",str);
-  exit(1);
+  if(write_error.code == WLN_WRITE_NONE){
+    write_error.stage = stage;
+    write_error.code = code;
+    write_error.error_msg = str;
+  }
+  return false;
 }
 
 
@@ -132,7 +208,7 @@ unsigned int position_in_path(OBAtom *atom,LocantPos*locant_path,unsigned int pa
       return i; 
   }
 
-  Fatal("Error: atom not found in locant path");
+  Fatal(WLN_WRITE_STAGE_LOCANT,WLN_WRITE_NOT_IN_PATH,"atom not found in locant path");
   return 0; 
 }
 
@@ -164,9 +240,9 @@ unsigned int ring_sum(OBMol *mol, OBRing *ring, LocantPos*locant_path,unsigned i
 }
 
 
-unsigned int fusion_sum(OBMol *mol, LocantPos*locant_path, unsigned int path_size, std::set<OBRing*> &local_SSSR){
+unsigned int fusion_sum(OBMol *mol, LocantPos*locant_path, unsigned int path_size, std::set<OBRing*,RingPathLess> &local_SSSR){
   unsigned int ret = 0; 
-  for(std::set<OBRing*>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end();riter++)
+  for(std::set<OBRing*,RingPathLess>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end();riter++)
     ret += fusion_locant(mol,*riter,locant_path,path_size) + 1; // A=1, B=2 etc 
   return ret;
 }
@@ -208,8 +284,10 @@ void static write_locant(unsigned int locant,std::string &buffer){
     unsigned int offset = 0; 
     
     loc_start = broken_parent_char(locant); 
-    if(!loc_start)
-      Fatal("could not fetch off path parent for broken locant"); 
+    if(!loc_start){
+      Fatal(WLN_WRITE_STAGE_LOCANT,WLN_WRITE_BROKEN_LOCANT,"could not fetch off path parent for broken locant"); 
+      return;
+    }
 
     offset = locant - (128 + (LOCANT_TO_INT(loc_start)*6)); // 0 = E-, 1 = E-&
     buffer += loc_start;
@@ -235,7 +313,7 @@ void static write_locant(unsigned int locant,std::string &buffer){
         break;
 
       default:
-        Fatal("broken locants exceeding tree limit of 6"); 
+        Fatal(WLN_WRITE_STAGE_LOCANT,WLN_WRITE_BROKEN_LOCANT,"broken locants exceeding tree limit of 6"); 
     }
   }
   else{
@@ -377,8 +455,8 @@ bool IsConsecutiveLocants(LocantPos *a, LocantPos *b){
  * - This must be the full path size, detection made on locant value for bridging broken points
 */
 void TestPathSequences( OBMol *mol,LocantPos*locant_path, unsigned int path_size, 
-                        std::vector<OBRing*> &ring_order,std::map<OBAtom*,unsigned int> &atom_shares,
-                        std::map<OBAtom*,bool> &bridge_atoms, std::string &buffer){
+                        std::vector<OBRing*> &ring_order,AtomState<unsigned int> &atom_shares,
+                        AtomState<bool> &bridge_atoms, std::string &buffer){
   
   std::map<OBBond*,bool> allowed_jumps; 
   std::map<unsigned int,unsigned int> allowed_connection; 
@@ -497,7 +575,7 @@ bool sequential_chain(  OBMol *mol,OBRing *ring,
 unsigned int PseudoCheck( OBMol *mol, OBAtom **locant_path, unsigned int path_size,
                           std::vector<unsigned char>      &locant_order,
                           std::vector<OBRing*>            &ring_order,
-                          std::map<OBAtom*,bool>          &bridge_atoms,
+                          AtomState<bool>          &bridge_atoms,
                           std::string &buffer)
 {
 
@@ -611,7 +689,7 @@ unsigned int PseudoCheck( OBMol *mol, OBAtom **locant_path, unsigned int path_si
 }
 #endif
 
-bool ReachableFromEntry(OBAtom *entry, std::set<OBAtom*> &ring_atoms, std::set<OBAtom*> &seen){
+bool ReachableFromEntry(OBAtom *entry, std::set<OBAtom*,AtomIdxLess> &ring_atoms, std::set<OBAtom*,AtomIdxLess> &seen){
   std::stack<OBAtom*> stack;  
   OBAtom *top = 0; 
   stack.push(entry);
@@ -622,7 +700,7 @@ bool ReachableFromEntry(OBAtom *entry, std::set<OBAtom*> &ring_atoms, std::set<O
 
     FOR_NBORS_OF_ATOM(n ,top){
       OBAtom *nbor = &(*n); 
-      for(std::set<OBAtom*>::iterator fiter = ring_atoms.begin(); fiter != ring_atoms.end();fiter++){
+      for(std::set<OBAtom*,AtomIdxLess>::iterator fiter = ring_atoms.begin(); fiter != ring_atoms.end();fiter++){
         if(*fiter == nbor)
           stack.push(nbor);
       }
@@ -633,7 +711,7 @@ bool ReachableFromEntry(OBAtom *entry, std::set<OBAtom*> &ring_atoms, std::set<O
 }
 
 // helper function whenever we need the ring bonds
-void FillRingBonds(OBMol *mol,OBRing* obring, std::set<OBBond*> &ring_bonds){
+void FillRingBonds(OBMol *mol,OBRing* obring, std::set<OBBond*,BondIdxLess> &ring_bonds){
    
   for(unsigned int i=0;i<obring->Size()-1;i++){
     OBAtom *satom = mol->GetAtom(obring->_path[i]);    
@@ -657,15 +735,15 @@ void FillRingBonds(OBMol *mol,OBRing* obring, std::set<OBBond*> &ring_bonds){
 pseudo check will add determined pairs and check notation is viable for read
  - This is deprecated as rings are read on path read, but keep for posterity */
 unsigned int ReadLocantPath(  OBMol *mol, OBAtom **locant_path, unsigned int path_size,
-                      std::set<OBRing*>               &local_SSSR,
-                      std::map<OBAtom*,bool>          &bridge_atoms,
+                      std::set<OBRing*,RingPathLess>               &local_SSSR,
+                      AtomState<bool>          &bridge_atoms,
                       std::vector<OBRing*>            &ring_order,
                       std::string &buffer,
                       bool verbose)
 {  
   unsigned int arr_size = 0; 
   OBRing **ring_arr = (OBRing**)malloc(sizeof(OBRing*) * local_SSSR.size()); 
-  for(std::set<OBRing*>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end();riter++)
+  for(std::set<OBRing*,RingPathLess>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end();riter++)
     ring_arr[arr_size++]= *riter; 
   
   unsigned int assignment_score = 0;
@@ -720,8 +798,11 @@ unsigned int ReadLocantPath(  OBMol *mol, OBAtom **locant_path, unsigned int pat
     }
 
     OBRing *to_write = ring_arr[pos_to_write];
-    if(!to_write)
-      Fatal("out of access locant path reading");
+    if(!to_write){
+      Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_NO_PATH,"out of access locant path reading");
+      free(ring_arr);
+      return 255;
+    }
     
 
     for(unsigned int k=0;k<to_write->Size();k++){
@@ -765,7 +846,7 @@ unsigned int ReadLocantPath(  OBMol *mol, OBAtom **locant_path, unsigned int pat
 
 
 LocantPos *SingleWalk(OBMol *mol, unsigned int path_size,
-                    std::set<OBRing*> &local_SSSR,
+                    std::set<OBRing*,RingPathLess> &local_SSSR,
                     std::vector<OBRing*> &ring_order,
                     std::string &buffer )
 {
@@ -792,7 +873,7 @@ LocantPos *SingleWalk(OBMol *mol, unsigned int path_size,
  * For multicyclics is a simple ask, you want the highest ring shares in the lowest position, 
  * therefore if all bonds are junctions, take the multicyclic point.
 */
-bool IsRingJunction(OBMol*mol, OBAtom *curr, OBAtom *ahead, std::set<OBRing*>&local_SSSR){
+bool IsRingJunction(OBMol*mol, OBAtom *curr, OBAtom *ahead, std::set<OBRing*,RingPathLess>&local_SSSR){
   OBBond * bond = mol->GetBond(curr,ahead); 
   if(!bond){
     fprintf(stderr,"Error: bond does not exist\n"); 
@@ -800,7 +881,7 @@ bool IsRingJunction(OBMol*mol, OBAtom *curr, OBAtom *ahead, std::set<OBRing*>&lo
   }
     
   unsigned int shares = 0; 
-  for(std::set<OBRing*>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end(); riter++){
+  for(std::set<OBRing*,RingPathLess>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end(); riter++){
     OBRing *obring = *riter; 
     if(obring->IsMember(bond)){
       shares++;
@@ -842,7 +923,7 @@ bool IsRingCompleteWB(OBRing *ring,
 /*  a valid starting multicyclic point cannot be nested within others, it must only point to 
  *  1 other multicyclic, within the ring walk this is not true, and both routes must be taken
  *  */ 
-unsigned int connected_multicycles(OBAtom *atom, std::map<OBAtom*,unsigned int>  &atom_shares){
+unsigned int connected_multicycles(OBAtom *atom, AtomState<unsigned int>  &atom_shares){
   unsigned int m = 0;
   FOR_NBORS_OF_ATOM(a, atom){
     OBAtom *n = &(*a);
@@ -853,6 +934,62 @@ unsigned int connected_multicycles(OBAtom *atom, std::map<OBAtom*,unsigned int>
 }
 
 
+// path search counters for the whole run, added once per ring system
+static std::atomic<unsigned long> path_seeds{0};
+static std::atomic<unsigned long> path_steps{0};
+static std::atomic<unsigned long> path_scored{0};
+static std::atomic<unsigned long> path_pruned{0};
+static bool path_bound = true;
+
+/* running lower bound on fusion_sum() for a partial locant path. the walk only 
+ * adds atoms at the end of the path and backtracking only clears from the back, 
+ * so a ring keeps the position it was first entered at, a ring not yet entered 
+ * can do no better than the next free position. on a full path this is exactly 
+ * fusion_sum() */
+struct FusionBound{
+  std::vector<OBRing*> rings;
+  std::vector<unsigned int> first; // UINT32_MAX until entered
+
+  FusionBound(std::set<OBRing*,RingPathLess> &local_SSSR): 
+    rings(local_SSSR.begin(),local_SSSR.end()), first(rings.size(),UINT32_MAX) {}
+
+  void Clear(){
+    std::fill(first.begin(),first.end(),UINT32_MAX);
+  }
+
+  void Place(OBAtom *atom, unsigned int pos){
+    for(unsigned int r=0;r<rings.size();r++){
+      if(first[r] == UINT32_MAX && rings[r]->IsMember(atom))
+        first[r] = pos;
+    }
+  }
+
+  // drop everything at or past len after a backtrack
+  void Trim(unsigned int len){
+    for(unsigned int r=0;r<rings.size();r++){
+      if(first[r] != UINT32_MAX && first[r] >= len)
+        first[r] = UINT32_MAX;
+    }
+  }
+
+  unsigned int Lower(unsigned int len){
+    unsigned int sum = 0;
+    for(unsigned int r=0;r<rings.size();r++)
+      sum += (first[r] == UINT32_MAX ? len : first[r]) + 1; // A=1, B=2 etc
+    return sum;
+  }
+};
+
+
+/* seeds with the most rings through them put those rings on A, try them first,
+ * ties go in ring order */
+static bool best_seed_first(const std::pair<unsigned int,unsigned int> &a, const std::pair<unsigned int,unsigned int> &b){
+  if(a.first != b.first)
+    return a.first > b.first;
+  return a.second < b.second;
+}
+
+
 /*
 builds iteratively so ordering is correct, when a ring is filled, write the notation
 there is some bit logic to speed all this up, - concepts first, optimisation later
@@ -861,12 +998,12 @@ as long as the sequential order is FORCED, we can take the max array size as
 max_path_size
 */
 void write_complete_rings(  OBMol *mol, LocantPos *locant_path, unsigned int max_path_size, 
-                            std::set<OBRing*> &local_SSSR, 
+                            std::set<OBRing*,RingPathLess> &local_SSSR, 
                             std::map<OBRing*,bool>  &handled_rings, 
                             std::vector<OBRing*> &ring_order, 
                             std::string &buffer)
 {
-  for(std::set<OBRing*>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end(); riter++){
+  for(std::set<OBRing*,RingPathLess>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end(); riter++){
     if(!handled_rings[*riter] && IsRingComplete(*riter, locant_path, max_path_size)){
       unsigned int lowest_locant = lowest_ring_locant(mol,*riter, locant_path, max_path_size);
       if(lowest_locant != 'A'){
@@ -884,12 +1021,12 @@ void write_complete_rings(  OBMol *mol, LocantPos *locant_path, unsigned int max
 /* same as before but allow through a branching locant array to check solves */
 void write_complete_ringsWB(  OBMol *mol, LocantPos *locant_path, unsigned int max_path_size, 
                             LocantPos *branching_locants, unsigned int branch_n,
-                            std::set<OBRing*> &local_SSSR, std::map<OBRing*,bool> &handled_rings,
+                            std::set<OBRing*,RingPathLess> &local_SSSR, std::map<OBRing*,bool> &handled_rings,
                             std::vector<OBRing*> &ring_order, 
                             std::string &buffer)
 {
 
-  for(std::set<OBRing*>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end(); riter++){
+  for(std::set<OBRing*,RingPathLess>::iterator riter = local_SSSR.begin(); riter != local_SSSR.end(); riter++){
     if(!handled_rings[*riter] && IsRingCompleteWB(*riter, locant_path, max_path_size,branching_locants,branch_n)){
       unsigned int lowest_locant = lowest_ring_locantWB(mol,*riter, locant_path, max_path_size,branching_locants,branch_n);
       if(lowest_locant != 'A'){
@@ -928,10 +1065,10 @@ void write_complete_ringsWB(  OBMol *mol, LocantPos *locant_path, unsigned int m
 3 and 4 are likely not needed for polycyclic, see ComplexWalk for implementation on multicyclics, bridges etc. 
 */
 LocantPos *PathFinderIIIa(    OBMol *mol, unsigned int path_size,
-                              std::set<OBAtom*>               &ring_atoms,
-                              std::map<OBAtom*,unsigned int>  &atom_shares,
-                              std::map<OBAtom*,bool>          &bridge_atoms,
-                              std::set<OBRing*>               &local_SSSR,
+                              std::set<OBAtom*,AtomIdxLess>               &ring_atoms,
+                              AtomState<unsigned int>  &atom_shares,
+                              AtomState<bool>          &bridge_atoms,
+                              std::set<OBRing*,RingPathLess>               &local_SSSR,
                               std::vector<OBRing*>            &ring_order,
                               std::string                     &buffer)
 {
@@ -950,13 +1087,14 @@ LocantPos *PathFinderIIIa(    OBMol *mol, unsigned int path_size,
   OBAtom*                matom  = 0; // move atom
   unsigned int           lowest_sum       = UINT32_MAX;
   
-  for(std::set<OBAtom*>::iterator aiter = ring_atoms.begin(); aiter != ring_atoms.end(); aiter++){
+  AtomState<bool>        visited; 
+  for(std::set<OBAtom*,AtomIdxLess>::iterator aiter = ring_atoms.begin(); aiter != ring_atoms.end(); aiter++){
     if(atom_shares[*aiter] == 2){ // these are the starting points 
      
       zero_locant_path(locant_path, path_size);
 
-      std::set<OBBond*>      ring_junctions;
-      std::map<OBAtom*,bool> visited; 
+      std::set<OBBond*,BondIdxLess>      ring_junctions;
+      visited.Reset(mol); 
       unsigned int locant_pos = 0;
       
       ratom = *aiter; 
@@ -1009,7 +1147,7 @@ LocantPos *PathFinderIIIa(    OBMol *mol, unsigned int path_size,
 }
 
 
-void BackTrackWalk(  OBAtom *clear, LocantPos*locant_path, unsigned int path_size,unsigned int &locant_pos, std::map<OBAtom*,bool> &visited_atoms)
+void BackTrackWalk(  OBAtom *clear, LocantPos*locant_path, unsigned int path_size,unsigned int &locant_pos, AtomState<bool> &visited_atoms)
 {
 
   // find the position in the path where the lowest one of these are, the other gets placed into locant path 
@@ -1056,10 +1194,10 @@ Some rules to follow when walking the path:
   path size can now change to accomadate whether the locant path reduces due to branching locants
 */
 LocantPos *PathFinderIIIb(  OBMol *mol,        unsigned int &path_size,
-                            std::set<OBAtom*>               &ring_atoms,
-                            std::map<OBAtom*,unsigned int>  &atom_shares,
-                            std::map<OBAtom*,bool>          &bridge_atoms,
-                            std::set<OBRing*>               &local_SSSR,
+                            std::set<OBAtom*,AtomIdxLess>               &ring_atoms,
+                            AtomState<unsigned int>  &atom_shares,
+                            AtomState<bool>          &bridge_atoms,
+                            std::set<OBRing*,RingPathLess>               &local_SSSR,
                             std::vector<OBRing*>            &ring_order,
                             std::string                     &buffer)
 {
@@ -1070,14 +1208,15 @@ LocantPos *PathFinderIIIb(  OBMol *mol,        unsigned int &path_size,
   LocantPos *locant_path = (LocantPos*)malloc(sizeof(LocantPos) * path_size); 
   LocantPos *best_path = (LocantPos*)malloc(sizeof(LocantPos) * path_size); 
 
-  LocantPos *off_branches = (LocantPos*)malloc(sizeof(LocantPos) * 32); // hard limit 
-  LocantPos *best_off_branches = (LocantPos*)malloc(sizeof(LocantPos) * 32); // hard limit 
+  // every off branch shortens the path by one, so they never outnumber it
+  LocantPos *off_branches = (LocantPos*)malloc(sizeof(LocantPos) * path_size); 
+  LocantPos *best_off_branches = (LocantPos*)malloc(sizeof(LocantPos) * path_size); 
 
   zero_locant_path(locant_path, path_size);
   zero_locant_path(best_path, path_size);
 
-  zero_locant_path(off_branches, 32); 
-  zero_locant_path(best_off_branches, 32); 
+  zero_locant_path(off_branches, path_size); 
+  zero_locant_path(best_off_branches, path_size); 
 
   OBAtom*                ratom  = 0; // ring
   OBAtom*                catom  = 0; // child
@@ -1086,136 +1225,190 @@ LocantPos *PathFinderIIIb(  OBMol *mol,        unsigned int &path_size,
   unsigned int           starting_path_size = path_size; // important if path size changes
   unsigned int           best_path_size     = 0; 
   unsigned int           best_off_branch_n  = 0; 
+  unsigned int           best_rank          = UINT32_MAX; // ring order of the seed the best path came from
+  AtomState<bool>        visited; 
+  FusionBound            bound(local_SSSR); 
+  unsigned long          steps = 0; 
+  unsigned long          scored = 0; 
+  unsigned long          pruned = 0; 
+
+  // a multicyclic that connects to two other multicyclic points can never be the start, always take an edge case
+  std::vector<OBAtom*> seeds; 
+  for(std::set<OBAtom*,AtomIdxLess>::iterator aiter = ring_atoms.begin(); aiter != ring_atoms.end(); aiter++){
+    if( (atom_shares[*aiter] >= 3 && connected_multicycles(*aiter,atom_shares)<=1)  || bridge_atoms[*aiter]) // these are the starting points 
+      seeds.push_back(*aiter);
+  }
 
-  for(std::set<OBAtom*>::iterator aiter = ring_atoms.begin(); aiter != ring_atoms.end(); aiter++){
-    // a multicyclic that connects to two other multicyclic points can never be the start, always take an edge case
-    if( (atom_shares[*aiter] >= 3 && connected_multicycles(*aiter,atom_shares)<=1)  || bridge_atoms[*aiter]){ // these are the starting points 
-
-      std::map<OBAtom*,bool>    visited; 
-      std::stack<OBAtom*>       multistack; 
-      std::stack<std::pair<OBAtom*,OBAtom*>> backtrack_stack;   // multicyclics have three potential routes, 
-      
-      locant_pos = 0;
-      off_branch_n = 0; 
-      path_size = starting_path_size; 
-      zero_locant_path(locant_path, starting_path_size);
-      zero_locant_path(off_branches, 32);
+  /* walks the locant paths from one seed. a full path is taken on a lower fusion
+   * sum, rule 30d, or the same sum from a seed earlier in ring order (rank), so 
+   * the path picked does not depend on the order the seeds are tried in. with
+   * off_branching, when no clean path fits multicyclic points are popped into 
+   * off branches until one does, the bound stays off until the seed has a path
+   * so the same points are popped. true when the seed gave a path */
+  auto walk_seed = [&](unsigned int rank, bool off_branching) -> bool {
+    bool found = false; 
+    OBAtom *seed = seeds[rank]; 
+    visited.Reset(mol); 
+    std::stack<OBAtom*>       multistack; 
+    std::stack<std::pair<OBAtom*,OBAtom*>> backtrack_stack;   // multicyclics have three potential routes, 
     
+    locant_pos = 0;
+    off_branch_n = 0; 
+    path_size = starting_path_size; 
+    zero_locant_path(locant_path, starting_path_size);
+    zero_locant_path(off_branches, starting_path_size);
+  
 path_solve:        
-      ratom = *aiter; 
-      locant_pos = 0;
-      do{
+    ratom = seed; 
+    locant_pos = 0;
+    bound.Clear(); 
+    do{
 
-        if(!backtrack_stack.empty())
-          backtrack_stack.pop(); 
+      if(!backtrack_stack.empty())
+        backtrack_stack.pop(); 
 
-        for(;;){
-          
-          locant_path[locant_pos].atom = ratom;
-          locant_path[locant_pos].locant = INT_TO_LOCANT(locant_pos+1);
-          locant_pos++; 
-          
-          // check if attached to broken, if yes, update their locants
-          update_broken_locants(mol, &locant_path[locant_pos-1], locant_path, path_size, off_branches, off_branch_n); 
-          visited[ratom] = true;
+      for(;;){
+        
+        locant_path[locant_pos].atom = ratom;
+        locant_path[locant_pos].locant = INT_TO_LOCANT(locant_pos+1);
+        locant_pos++; 
+        
+        // check if attached to broken, if yes, update their locants
+        update_broken_locants(mol, &locant_path[locant_pos-1], locant_path, path_size, off_branches, off_branch_n); 
+        visited[ratom] = true;
+        bound.Place(ratom,locant_pos-1); 
+        steps++; 
 
-          if(locant_pos >= path_size)
-            break;
-          
-          // here we allow multicyclics to cross ring junctions
-          matom = 0; 
-          FOR_NBORS_OF_ATOM(a,ratom){ 
-            catom = &(*a);  
-            if(!visited[catom]){
-              // two things can happen, either we're at a ring junction or we're not
-              if(IsRingJunction(mol, ratom, catom, local_SSSR)){
-                // if its a ring junction, we can move if this is going to/from a multicyclic point,
-                // if pointing at a multicyclic, or an edge atoms, try both
-                if( (atom_shares[ratom]>=3 || atom_shares[catom]>=3) || (bridge_atoms[ratom] || bridge_atoms[catom]) ){
-                  if(!matom)
-                    matom = catom; 
-                  else if(atom_shares[catom] > atom_shares[matom]){
-                    // edge cases should be tried
-                    if(atom_shares[matom] < 2)
-                      backtrack_stack.push({ratom,matom}); 
-
-                    matom = catom;
-                  }
-                  else 
-                    backtrack_stack.push({ratom,catom}); 
-                }
-              }
-              else if(atom_shares[catom] < 3){
+        if(locant_pos >= path_size)
+          break;
+
+        // every path through this prefix scores at least the bound, a higher sum or a 
+        // tie from a later seed cannot win
+        if(path_bound && lowest_sum != UINT32_MAX && (!off_branching || found)){
+          unsigned int lower = bound.Lower(locant_pos); 
+          if(lower > lowest_sum || (lower == lowest_sum && rank >= best_rank)){
+            pruned++; 
+            break; 
+          }
+        }
+        
+        // here we allow multicyclics to cross ring junctions
+        matom = 0; 
+        FOR_NBORS_OF_ATOM(a,ratom){ 
+          catom = &(*a);  
+          if(!visited[catom]){
+            // two things can happen, either we're at a ring junction or we're not
+            if(IsRingJunction(mol, ratom, catom, local_SSSR)){
+              // if its a ring junction, we can move if this is going to/from a multicyclic point,
+              // if pointing at a multicyclic, or an edge atoms, try both
+              if( (atom_shares[ratom]>=3 || atom_shares[catom]>=3) || (bridge_atoms[ratom] || bridge_atoms[catom]) ){
                 if(!matom)
                   matom = catom; 
                 else if(atom_shares[catom] > atom_shares[matom]){
+                  // edge cases should be tried
                   if(atom_shares[matom] < 2)
                     backtrack_stack.push({ratom,matom}); 
-                  
+
                   matom = catom;
                 }
-                else if(atom_shares[catom] <= atom_shares[matom])
-                  backtrack_stack.push({ratom,catom});
+                else 
+                  backtrack_stack.push({ratom,catom}); 
               }
-              else if(atom_shares[ratom] < 2){
-                if(!matom)
-                  matom = catom;
+            }
+            else if(atom_shares[catom] < 3){
+              if(!matom)
+                matom = catom; 
+              else if(atom_shares[catom] > atom_shares[matom]){
+                if(atom_shares[matom] < 2)
+                  backtrack_stack.push({ratom,matom}); 
+                
+                matom = catom;
               }
+              else if(atom_shares[catom] <= atom_shares[matom])
+                backtrack_stack.push({ratom,catom});
+            }
+            else if(atom_shares[ratom] < 2){
+              if(!matom)
+                matom = catom;
             }
-          }
-          
-          if(!matom){
-            // no locant path! add logic for off branches here! and pseudo locants
-            //fprintf(stderr,"Error: did not move in locant path walk!\n"); 
-            break;
-          }
-            
-          ratom = matom;
-          if(atom_shares[ratom ]>= 3 || bridge_atoms[ratom]) // ignores the first one
-            multistack.push(ratom); 
-        }
-       
-        if(locant_pos == path_size){
-          unsigned int fsum = fusion_sum(mol,locant_path,path_size,local_SSSR);
-          if(fsum < lowest_sum){ // rule 30d.
-            lowest_sum = fsum;
-            copy_locant_path(best_path,locant_path,starting_path_size);
-            copy_locant_path(best_off_branches,off_branches,32);
-            best_path_size = path_size;
-            best_off_branch_n = off_branch_n; 
           }
         }
         
-        if(!backtrack_stack.empty()){
-          ratom = backtrack_stack.top().second;
-          BackTrackWalk(backtrack_stack.top().first, locant_path, path_size,locant_pos,visited); 
+        if(!matom){
+          // no locant path! add logic for off branches here! and pseudo locants
+          //fprintf(stderr,"Error: did not move in locant path walk!\n"); 
+          break;
         }
-        else if(!best_path[0].atom && !multistack.empty()){ // once you find a branch path, take it!
-          // this the where the broken locants happen, pop off a multistack atom 
-          OBAtom *branch_locant = multistack.top();
-          multistack.pop();
-          for(unsigned int p=0;p<starting_path_size;p++)
-            visited[locant_path[p].atom] = 0;
           
-          burn_stack(backtrack_stack); 
-          burn_stack(multistack);  
-          visited[branch_locant] = true;
-          
-          off_branches[off_branch_n].atom   = branch_locant; 
-          off_branches[off_branch_n].locant = 0; 
-          off_branch_n++;
-          path_size--; // decrement the path size, this is globally changed
-          
-          //fprintf(stderr,"removing atom: %d\n",branch_locant->GetIdx()); 
-          zero_locant_path(locant_path, starting_path_size); 
-          goto path_solve; 
+        ratom = matom;
+        if(atom_shares[ratom ]>= 3 || bridge_atoms[ratom]) // ignores the first one
+          multistack.push(ratom); 
+      }
+     
+      if(locant_pos == path_size){
+        scored++; 
+        found = true; 
+
+        unsigned int fsum = bound.Lower(path_size); // fusion_sum() of the full path
+        if(fsum < lowest_sum || (fsum == lowest_sum && rank < best_rank)){ // rule 30d.
+          lowest_sum = fsum;
+          best_rank = rank; 
+          copy_locant_path(best_path,locant_path,starting_path_size);
+          copy_locant_path(best_off_branches,off_branches,starting_path_size);
+          best_path_size = path_size;
+          best_off_branch_n = off_branch_n; 
         }
-        else
-          break;
+      }
+      
+      if(!backtrack_stack.empty()){
+        ratom = backtrack_stack.top().second;
+        BackTrackWalk(backtrack_stack.top().first, locant_path, path_size,locant_pos,visited); 
+        bound.Trim(locant_pos); 
+      }
+      else if(off_branching && !found && !multistack.empty() && off_branch_n < starting_path_size){ // once you find a branch path, take it!
+        // this the where the broken locants happen, pop off a multistack atom 
+        OBAtom *branch_locant = multistack.top();
+        multistack.pop();
+        for(unsigned int p=0;p<starting_path_size;p++)
+          visited[locant_path[p].atom] = 0;
         
-      } while(!backtrack_stack.empty()) ; 
-    }
-  } 
+        burn_stack(backtrack_stack); 
+        burn_stack(multistack);  
+        visited[branch_locant] = true;
+        
+        off_branches[off_branch_n].atom   = branch_locant; 
+        off_branches[off_branch_n].locant = 0; 
+        off_branch_n++;
+        path_size--; // decrement the path size, this is globally changed
+        
+        //fprintf(stderr,"removing atom: %d\n",branch_locant->GetIdx()); 
+        zero_locant_path(locant_path, starting_path_size); 
+        goto path_solve; 
+      }
+      else
+        break;
+      
+    } while(!backtrack_stack.empty()) ; 
+    return found; 
+  };
+
+  // best first, so the bound has a low sum to cut against early
+  std::vector<std::pair<unsigned int,unsigned int>> order; 
+  for(unsigned int s=0;s<seeds.size();s++)
+    order.push_back({atom_shares[seeds[s]],s});
+  std::sort(order.begin(),order.end(),best_seed_first);
+  for(unsigned int s=0;s<order.size();s++)
+    walk_seed(order[s].second,false); 
+
+  // a clean path from any seed beats an off branch one, the seeds are only walked 
+  // again in ring order with off branches allowed when none of them gave a path
+  for(unsigned int s=0;s<seeds.size() && !best_path[0].atom;s++)
+    walk_seed(s,true); 
+
+  path_seeds += seeds.size(); 
+  path_steps += steps; 
+  path_scored += scored; 
+  path_pruned += pruned; 
 
   free(locant_path);
   free(off_branches); 
@@ -1246,11 +1439,11 @@ path_solve:
   /* uses a flood fill style solution (likely NP-HARD), with some restrictions to 
   find a multicyclic path thats stable with disjoined pericyclic points */
 OBAtom **PeriWalk(      OBMol *mol, unsigned int path_size,
-                        std::set<OBAtom*>               &ring_atoms,
-                        std::set<OBBond*>               &ring_bonds,
-                        std::map<OBAtom*,unsigned int>  &atom_shares,
-                        std::map<OBAtom*,bool>          &bridge_atoms, // rule 30f.
-                        std::set<OBRing*>               &local_SSSR,
+                        std::set<OBAtom*,AtomIdxLess>               &ring_atoms,
+                        std::set<OBBond*,BondIdxLess>               &ring_bonds,
+                        AtomState<unsigned int>  &atom_shares,
+                        AtomState<bool>          &bridge_atoms, // rule 30f.
+                        std::set<OBRing*,RingPathLess>               &local_SSSR,
                         unsigned int recursion_tracker)
   {
 
@@ -1260,7 +1453,7 @@ OBAtom **PeriWalk(      OBMol *mol, unsigned int path_size,
 
     // multi atoms are the starting seeds, must check them all unfortuanately 
     std::vector<OBAtom*> seeds; 
-    for(std::set<OBAtom*>::iterator aiter = ring_atoms.begin(); aiter != ring_atoms.end(); aiter++){
+    for(std::set<OBAtom*,AtomIdxLess>::iterator aiter = ring_atoms.begin(); aiter != ring_atoms.end(); aiter++){
       OBAtom *rseed = (*aiter);
       if(atom_shares[rseed] >= 1)
         seeds.push_back(rseed);
@@ -1276,9 +1469,10 @@ OBAtom **PeriWalk(      OBMol *mol, unsigned int path_size,
       best_path[i] = 0; 
     }
 
+    AtomState<bool> current; 
     for(OBAtom *rseed : seeds){
       OBAtom*                catom  = 0;
-      std::map<OBAtom*,bool> current; 
+      current.Reset(mol); 
       std::vector<std::pair<OBAtom*,OBAtom*>> path; 
       path.push_back({rseed,0}); 
 
@@ -1301,7 +1495,7 @@ OBAtom **PeriWalk(      OBMol *mol, unsigned int path_size,
   //        bool in_set = true;
 
           bool in_set = false; 
-          for (std::set<OBAtom*>::iterator siter = ring_atoms.begin();siter != ring_atoms.end(); siter++) {
+          for (std::set<OBAtom*,AtomIdxLess>::iterator siter = ring_atoms.begin();siter != ring_atoms.end(); siter++) {
             if (catom == *siter)
               in_set = true;
           }
@@ -1377,10 +1571,10 @@ OBAtom **PeriWalk(      OBMol *mol, unsigned int path_size,
       if(recursion_tracker == 0){
         
         unsigned int pos = 0;
-        for(std::set<OBRing*>::iterator riter = local_SSSR.begin();riter != local_SSSR.end();riter++){
+        for(std::set<OBRing*,RingPathLess>::iterator riter = local_SSSR.begin();riter != local_SSSR.end();riter++){
           OBRing *obring = *riter; 
-          std::set<OBAtom*> local_atoms; 
-          std::set<OBAtom*> difference;
+          std::set<OBAtom*,AtomIdxLess> local_atoms; 
+          std::set<OBAtom*,AtomIdxLess> difference;
           
           // its the difference ONLY if the atoms are ONLY contained in this ring
           for(unsigned int i=0;i<obring->Size();i++){
@@ -1391,13 +1585,13 @@ OBAtom **PeriWalk(      OBMol *mol, unsigned int path_size,
           
           if(!local_atoms.empty()){
             std::set_difference(ring_atoms.begin(), ring_atoms.end(), local_atoms.begin(), local_atoms.end(),
-                                std::inserter(difference, difference.begin()));
+                                std::inserter(difference, difference.begin()), AtomIdxLess());
             
             best_path = PeriWalk(mol, difference.size(), difference, ring_bonds,atom_shares, bridge_atoms, local_SSSR, 1); 
             if(best_path){
               // remove ring from the local SSSR, mark all the local_atoms set as non cyclic
               // and non-aromatic!
-              for(std::set<OBAtom*>::iterator laiter=local_atoms.begin(); laiter != local_atoms.end();laiter++){
+              for(std::set<OBAtom*,AtomIdxLess>::iterator laiter=local_atoms.begin(); laiter != local_atoms.end();laiter++){
                 (*laiter)->SetInRing(false);
                 bridge_atoms[*laiter] = false;
               }
@@ -1409,16 +1603,16 @@ OBAtom **PeriWalk(      OBMol *mol, unsigned int path_size,
                   bridge_atoms[latom] = false;
               }
         
-              std::set<OBRing*>::iterator it = std::next(local_SSSR.begin(), pos); 
+              std::set<OBRing*,RingPathLess>::iterator it = std::next(local_SSSR.begin(), pos); 
               local_SSSR.erase(it);
               
               // remove any aromaticty contraints so bonds get written
-              std::set<OBBond*> local_ring_bonds; 
+              std::set<OBBond*,BondIdxLess> local_ring_bonds; 
               FillRingBonds(mol, obring, local_ring_bonds); 
-              for(std::set<OBBond*>::iterator biter=local_ring_bonds.begin(); biter != local_ring_bonds.end();biter++){
+              for(std::set<OBBond*,BondIdxLess>::iterator biter=local_ring_bonds.begin(); biter != local_ring_bonds.end();biter++){
                 // these need to erased from the ring
                 (*biter)->SetAromatic(false); 
-              std::set<OBBond*>::iterator gpos = std::find(ring_bonds.begin(),ring_bonds.end(), *biter);   
+              std::set<OBBond*,BondIdxLess>::iterator gpos = std::find(ring_bonds.begin(),ring_bonds.end(), *biter);   
               ring_bonds.erase(gpos); 
             }
 
@@ -1494,23 +1688,35 @@ bool WriteBabelDotGraph(OBMol *mol){
 struct BabelGraph{
   
   bool modern; 
-  std::map<OBAtom*,bool> atoms_seen;
-  std::map<OBAtom*,unsigned char> atom_chars;
-  std::map<OBRing*,bool> rings_seen; 
-  std::map<OBAtom*,int>  remaining_branches; // tracking for branch pop
-  std::map<OBAtom*,unsigned int> string_position; // essential for writing post charges. 
+  AtomState<bool> atoms_seen;
+  AtomState<unsigned char> atom_chars;
+  std::vector<bool> rings_seen; // by position in the sssr
+  AtomState<int>  remaining_branches; // tracking for branch pop
+  AtomState<unsigned int> string_position; // essential for writing post charges. 
 
   BabelGraph(){
     modern = 0; 
   };
   ~BabelGraph(){};
+
+  // clears the per molecule state so one graph can serve a whole batch, 
+  // the arrays only grow so a batch stops allocating once it has seen its largest mol
+  void Reset(OBMol *mol){
+    atoms_seen.Reset(mol);
+    atom_chars.Reset(mol);
+    remaining_branches.Reset(mol);
+    string_position.Reset(mol);
+    rings_seen.assign(mol->GetSSSR().size(),false);
+  }
   
 
   // if modern, charges are completely independent apart from assumed K
   unsigned char WriteSingleChar(OBAtom* atom){
 
-    if(!atom)
-      Fatal("writing notation from dead atom ptr");
+    if(!atom){
+      Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_DEAD_ATOM,"writing notation from dead atom ptr");
+      return 0;
+    }
     
     unsigned int neighbours = atom->GetExplicitDegree(); 
     unsigned int orders = atom->GetExplicitValence(); 
@@ -1611,8 +1817,10 @@ struct BabelGraph{
   }
 
   void WriteSpecial(OBAtom *atom, std::string &buffer){
-    if(!atom)
-      Fatal("writing notation from dead atom ptr");
+    if(!atom){
+      Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_DEAD_ATOM,"writing notation from dead atom ptr");
+      return;
+    }
     // all special elemental cases
     //
     
@@ -2141,7 +2349,7 @@ struct BabelGraph{
 
   bool CheckCarbonyl(OBAtom *atom){
     if(!atom)
-      Fatal("checking for carbonyl on dead atom ptr");
+      return Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_DEAD_ATOM,"checking for carbonyl on dead atom ptr");
 
     if(atom->GetAtomicNum() != 6)
       return false;
@@ -2174,7 +2382,7 @@ struct BabelGraph{
                       std::string &buffer)
   {
     if(!start_atom)
-      Fatal("writing notation from dead atom ptr");
+      return Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_DEAD_ATOM,"writing notation from dead atom ptr");
 
     unsigned int border = 0; 
     unsigned char stereo = 0; 
@@ -2287,11 +2495,11 @@ struct BabelGraph{
           buffer += ' ';
           buffer += '0';
           if(!RecursiveParse(mol,atom,spawned_from,false,buffer))
-            Fatal("failed to make pi bonded ring");
+            return Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_BRANCH,"failed to make pi bonded ring");
         }
         else{
           if(!RecursiveParse(mol,atom,spawned_from,true,buffer))
-            Fatal("failed to make inline ring");
+            return Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_BRANCH,"failed to make inline ring");
         }
         
         // this should count as a branch?, lets see - doesnt seem
@@ -2682,7 +2890,7 @@ struct BabelGraph{
 
         default:
           fprintf(stderr,"Error: unhandled char %c\n",wln_character); 
-          return 0; 
+          return Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_ELEMENT,"unhandled wln character"); 
       }
 
       // here we ask, is this bonded to a ring atom that is not 'spawned from'
@@ -2690,10 +2898,8 @@ struct BabelGraph{
         OBAtom *nbor = &(*a);
         if(nbor != spawned_from && nbor->IsInRing() && atoms_seen[nbor] == true){
   
-          if(require_macro_closure){
-            fprintf(stderr,"Error: macro-closure appearing more than once\n");
-            return 0;
-          }
+          if(require_macro_closure)
+            return Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_BRANCH,"macro-closure appearing more than once");
           else{
             require_macro_closure = true;
             
@@ -2721,10 +2927,8 @@ struct BabelGraph{
             buffer += '-';
             buffer += ' ';
             
-            if(!locant_path){
-              fprintf(stderr,"Error: no locant path to wrap back macro-closures\n");
-              return 0;
-            }
+            if(!locant_path)
+              return Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_NO_PATH,"no locant path to wrap back macro-closures");
             else{
               for (unsigned int i=0;i<path_size;i++) {
                 if(locant_path[i].atom == nbor){
@@ -2833,12 +3037,12 @@ struct BabelGraph{
   /* parses the local ring system, return the size for creating the locant path with 
   non bonds to avoid */
   bool  ConstructLocalSSSR( OBMol *mol, OBAtom *ring_root,
-                            std::set<OBAtom*>         &ring_atoms,
-                            std::set<OBBond*>         &ring_bonds,
-                            std::map<OBAtom*,bool>    &bridge_atoms,
-                            std::map<OBAtom*,unsigned int> &atom_shares,
-                            std::map<OBBond*,unsigned int> &bond_shares, 
-                            std::set<OBRing*> &local_SSSR,
+                            std::set<OBAtom*,AtomIdxLess>         &ring_atoms,
+                            std::set<OBBond*,BondIdxLess>         &ring_bonds,
+                            AtomState<bool>    &bridge_atoms,
+                            AtomState<unsigned int> &atom_shares,
+                            BondState<unsigned int> &bond_shares, 
+                            std::set<OBRing*,RingPathLess> &local_SSSR,
                             SubsetData &local_data)
   {
 
@@ -2851,14 +3055,16 @@ struct BabelGraph{
     OBAtom *prev = 0; 
     OBBond *bond = 0; 
     OBRing *obring = 0; 
-    std::set<OBAtom*> tmp_bridging_atoms;
-    std::set<OBAtom*> remove_atoms; 
+    std::set<OBAtom*,AtomIdxLess> tmp_bridging_atoms;
+    std::set<OBAtom*,AtomIdxLess> remove_atoms; 
+
+    std::vector<OBRing*> &sssr = mol->GetSSSR();
 
     // get the seed ring and add path to ring_atoms
-    FOR_RINGS_OF_MOL(r,mol){
-      obring = &(*r);
+    for(unsigned int r=0;r<sssr.size();r++){
+      obring = sssr[r];
       if(obring->IsMember(ring_root)){
-        rings_seen[obring] = true;
+        rings_seen[r] = true;
         local_SSSR.insert(obring);
  
         prev = 0; 
@@ -2894,13 +3100,13 @@ struct BabelGraph{
     while(running){
       running = false;
 
-      FOR_RINGS_OF_MOL(r,mol){
-        obring = &(*r);
+      for(unsigned int r=0;r<sssr.size();r++){
+        obring = sssr[r];
 
-        if(!rings_seen[obring]){
+        if(!rings_seen[r]){
 
-          std::set<OBAtom*> ring_set; 
-          std::set<OBAtom*> intersection; 
+          std::set<OBAtom*,AtomIdxLess> ring_set; 
+          std::set<OBAtom*,AtomIdxLess> intersection; 
           bool all_ring = true;
 
           for(unsigned int i=0;i<obring->Size();i++){
@@ -2911,7 +3117,7 @@ struct BabelGraph{
           }
 
           std::set_intersection(ring_set.begin(), ring_set.end(), ring_atoms.begin(), ring_atoms.end(),
-                                std::inserter(intersection, intersection.begin()));
+                                std::inserter(intersection, intersection.begin()), AtomIdxLess());
 
           // intersection == 1 is a spiro ring, ignore,
           if(intersection.size() > 1 && all_ring){
@@ -2920,7 +3126,7 @@ struct BabelGraph{
             // if its enough to say that true bridges cannot have more than two bonds each?
             // yes but 2 bonds within the completed local SSSR,so this will needed filtering
             if(intersection.size() > 2){
-              for(std::set<OBAtom*>::iterator iiter = intersection.begin(); iiter != intersection.end();iiter++){
+              for(std::set<OBAtom*,AtomIdxLess>::iterator iiter = intersection.begin(); iiter != intersection.end();iiter++){
                 tmp_bridging_atoms.insert(*iiter);
               }
             }
@@ -2951,7 +3157,7 @@ struct BabelGraph{
               ring_bonds.insert(bond); 
               bond_shares[bond]++; 
             }
-            rings_seen[obring] = true; 
+            rings_seen[r] = true; 
             local_SSSR.insert(obring);
             running = true;
           }
@@ -2962,9 +3168,9 @@ struct BabelGraph{
     // filter out only the 2 bond bridge atoms
     unsigned int bridge_count = 0;
     if(!tmp_bridging_atoms.empty()){
-      for(std::set<OBAtom*>::iterator brd_iter=tmp_bridging_atoms.begin(); brd_iter != tmp_bridging_atoms.end();brd_iter++){
+      for(std::set<OBAtom*,AtomIdxLess>::iterator brd_iter=tmp_bridging_atoms.begin(); brd_iter != tmp_bridging_atoms.end();brd_iter++){
         unsigned int inter_ring_bonds = 0;
-        for(std::set<OBAtom*>::iterator aiter= ring_atoms.begin(); aiter != ring_atoms.end();aiter++){
+        for(std::set<OBAtom*,AtomIdxLess>::iterator aiter= ring_atoms.begin(); aiter != ring_atoms.end();aiter++){
           if(mol->GetBond(*brd_iter,*aiter))
             inter_ring_bonds++; 
         }
@@ -2984,7 +3190,7 @@ struct BabelGraph{
       fprintf(stderr,"  bridging atoms: %d\n",bridge_count);
       
       unsigned int max_share = 0; 
-      for(std::set<OBBond*>::iterator biter = ring_bonds.begin();biter != ring_bonds.end(); biter++)
+      for(std::set<OBBond*,BondIdxLess>::iterator biter = ring_bonds.begin();biter != ring_bonds.end(); biter++)
         if(bond_shares[*biter] > max_share)
           max_share = bond_shares[*biter];
 
@@ -3001,7 +3207,7 @@ struct BabelGraph{
   /* create the heteroatoms and locant path unsaturations where neccesary */
   bool ReadLocantAtomsBonds(  OBMol *mol, LocantPos* locant_path,unsigned int path_size,
                               std::vector<OBRing*> &ring_order,
-                              std::set<OBBond*>   &ring_bonds,
+                              std::set<OBBond*,BondIdxLess>   &ring_bonds,
                               std::string &buffer)
   {
 
@@ -3021,11 +3227,11 @@ struct BabelGraph{
       
       if(!locant_path[i].atom){
         print_locant_array(locant_path, path_size); 
-        Fatal("dead locant path atom ptr in hetero read - atom");
+        return Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_DEAD_ATOM,"dead locant path atom ptr in hetero read - atom");
       }
 
       if(!locant_path[i].locant)
-        Fatal("dead locant path position in hetero read - locant");
+        return Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_NOT_IN_PATH,"dead locant path position in hetero read - locant");
       
       bool carbonyl = CheckCarbonyl(locant_atom);
 
@@ -3145,7 +3351,7 @@ struct BabelGraph{
     }
 
 
-    for(std::set<OBBond*>::iterator biter = ring_bonds.begin(); biter != ring_bonds.end();biter++){
+    for(std::set<OBBond*,BondIdxLess>::iterator biter = ring_bonds.begin(); biter != ring_bonds.end();biter++){
       OBBond *fbond = *biter; 
       
       if(!bonds_checked[fbond] && fbond->GetBondOrder() > 1 && !fbond->IsAromatic()){
@@ -3192,7 +3398,7 @@ struct BabelGraph{
 
 
   void ReadMultiCyclicPoints( LocantPos *locant_path,unsigned int path_size, 
-                              std::map<OBAtom*,unsigned int> &ring_shares,std::string &buffer)
+                              AtomState<unsigned int> &ring_shares,std::string &buffer)
   { 
 
     unsigned int count = 0;
@@ -3215,26 +3421,28 @@ struct BabelGraph{
   }
 
   /* constructs and parses a cyclic structure, locant path is returned with its path_size */
-  void ParseCyclic(OBMol *mol, OBAtom *ring_root,OBAtom *spawned_from,bool inline_ring,PathData &pd,std::string &buffer){
+  bool ParseCyclic(OBMol *mol, OBAtom *ring_root,OBAtom *spawned_from,bool inline_ring,PathData &pd,std::string &buffer){
     if(OPT_DEBUG)
       fprintf(stderr,"Reading Cyclic\n");
 
     LocantPos*                      locant_path = 0; 
-    std::set<OBRing*>               local_SSSR;
-    std::set<OBAtom*>               ring_atoms;
-    std::set<OBBond*>               ring_bonds;
+    std::set<OBRing*,RingPathLess>               local_SSSR;
+    std::set<OBAtom*,AtomIdxLess>               ring_atoms;
+    std::set<OBBond*,BondIdxLess>               ring_bonds;
     std::vector<OBRing*>            ring_order; 
 
-    std::map<OBAtom*,bool>          bridge_atoms;
-    std::map<OBAtom*,unsigned int>  atom_shares;
-    std::map<OBBond*,unsigned int>  bond_shares;
+    AtomState<bool>                 bridge_atoms;
+    AtomState<unsigned int>         atom_shares;
+    BondState<unsigned int>         bond_shares;
+    bridge_atoms.Reset(mol);
+    atom_shares.Reset(mol);
+    bond_shares.Reset(mol);
     
     // can we get the local SSSR data out of this?
     SubsetData LocalSSRS_data;
 
-    if(!ConstructLocalSSSR(mol,ring_root,ring_atoms,ring_bonds,bridge_atoms,atom_shares,bond_shares,local_SSSR, LocalSSRS_data)){
-      Fatal("failed to contruct SSSR"); 
-    }
+    if(!ConstructLocalSSSR(mol,ring_root,ring_atoms,ring_bonds,bridge_atoms,atom_shares,bond_shares,local_SSSR, LocalSSRS_data))
+      return Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_NO_SSSR,"failed to contruct SSSR"); 
     
     bool multi = LocalSSRS_data.multi;
     bool hetero = LocalSSRS_data.hetero;
@@ -3251,7 +3459,7 @@ struct BabelGraph{
     else
       locant_path = PathFinderIIIb(mol,path_size, ring_atoms, atom_shares, bridge_atoms, local_SSSR,ring_order,ring_segment); 
     if(!locant_path)
-      return Fatal("no locant path could be determined");
+      return Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_NO_PATH,"no locant path could be determined");
     
 
 
@@ -3319,7 +3527,10 @@ struct BabelGraph{
     }
 
     path_size = LocalSSRS_data.path_size; 
-    ReadLocantAtomsBonds(mol,locant_path,path_size,ring_order,ring_bonds,buffer);
+    if(!ReadLocantAtomsBonds(mol,locant_path,path_size,ring_order,ring_bonds,buffer)){
+      free(locant_path);
+      return false;
+    }
 
     // breaks incremented locant notation
     if(buffer.back() == '&')
@@ -3366,6 +3577,7 @@ struct BabelGraph{
     pd.locant_path = locant_path;
     pd.path_size = path_size;
     pd.macro_ring = macro_ring; // could be zero, need check
+    return true;
   }
     
 
@@ -3373,8 +3585,7 @@ struct BabelGraph{
     // assumes atom is a ring atom 
     
     PathData pd; 
-    ParseCyclic(mol,atom,spawned_from,inline_ring,pd,buffer);
-    if(!pd.locant_path){
+    if(!ParseCyclic(mol,atom,spawned_from,inline_ring,pd,buffer) || !pd.locant_path){
       fprintf(stderr,"Error: failed on cyclic parse\n");
       return false;
     }
@@ -3448,6 +3659,7 @@ struct BabelGraph{
           if(!ParseNonCyclic( mol,latom,pd.locant_path[i].atom,lbond,
                               pd.locant_path[i].locant,pd.locant_path,pd.path_size,buffer)){
             fprintf(stderr,"Error: failed on non-cyclic parse\n");
+            free(pd.locant_path);
             return false;
           }
 
@@ -3482,14 +3694,17 @@ struct BabelGraph{
                           
 
                     fprintf(stderr,"Error: failed on non-cyclic parse\n");
+                    free(pd.locant_path);
                     return false;
                   }
 
                   next_pi->SetFormalCharge(0);
                   if(charge)
                     charge--;
-                  else
-                    Fatal("Linking more pi bonded organometallics then charge allows\n");
+                  else{
+                    free(pd.locant_path);
+                    return Fatal(WLN_WRITE_STAGE_METAL,WLN_WRITE_CHARGE,"linking more pi bonded organometallics than charge allows");
+                  }
 
                   organometallic->SetFormalCharge(charge);
                 }
@@ -3518,11 +3733,33 @@ struct BabelGraph{
                          API FUNCTION
 **********************************************************************/
 
-bool WriteWLN(std::string &buffer, OBMol* mol, bool modern)
+static bool WriteFailed(WLNWriteError *error)
+{
+  if(error)
+    *error = write_error;
+  return false;
+}
+
+/* appends the wln to out, on failure out is left untouched and when error is
+ * given it is filled with the stage and reason the write stopped at */
+bool WriteWLN(std::string &out, OBMol* mol, bool modern, WLNWriteError *error)
 {   
+  write_error.stage = WLN_WRITE_STAGE_NONE;
+  write_error.code = WLN_WRITE_NONE;
+  write_error.error_msg = 0;
+
+  // the notation is built on its own, post charges and locant checks index 
+  // and look back into it, so it cannot share the callers string
+  static thread_local std::string buffer;
+  buffer.clear();
   
-  OBMol *mol_copy = new OBMol(*mol); // performs manipulations on the mol object, copy for safety
-  BabelGraph obabel;
+  // performs manipulations on the mol object, copy for safety. both the copy
+  // and the graph are kept per thread so batch runs do not rebuild them
+  static thread_local OBMol mol_store;
+  static thread_local BabelGraph obabel;
+  mol_store = *mol;
+  OBMol *mol_copy = &mol_store;
+  obabel.Reset(mol_copy);
 
 #define PERCEPTION_DEBUG 0
 #if PERCEPTION_DEBUG
@@ -3585,23 +3822,28 @@ bool WriteWLN(std::string &buffer, OBMol* mol, bool modern)
       if(!obabel.atoms_seen[satom] && (satom->GetExplicitDegree()==1 || satom->GetExplicitDegree() == 0) ){
         if(started)
           buffer += " &"; // ionic species
-        if(!obabel.ParseNonCyclic(mol_copy,&(*a),0,0,0,0,0,buffer))
-          Fatal("failed on recursive branch parse");
+        if(!obabel.ParseNonCyclic(mol_copy,&(*a),0,0,0,0,0,buffer)){
+          Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_BRANCH,"failed on recursive branch parse");
+          return WriteFailed(error);
+        }
 
         started = true; 
       }
     }
   }
   else{
-    FOR_RINGS_OF_MOL(r,mol_copy){
+    std::vector<OBRing*> &sssr = mol_copy->GetSSSR();
+    for(unsigned int r=0;r<sssr.size();r++){
     // start recursion from first cycle atom
-      if(!obabel.rings_seen[&(*r)]){
+      if(!obabel.rings_seen[r]){
         if(started){
           buffer += " &"; // ionic species
         }
         
-        if(!obabel.RecursiveParse(mol_copy,mol_copy->GetAtom( (&(*r))->_path[0]),0,false,buffer))
-          Fatal("failed on recursive ring parse");
+        if(!obabel.RecursiveParse(mol_copy,mol_copy->GetAtom(sssr[r]->_path[0]),0,false,buffer)){
+          Fatal(WLN_WRITE_STAGE_RING,WLN_WRITE_BRANCH,"failed on recursive ring parse");
+          return WriteFailed(error);
+        }
 
         started = true;
       }
@@ -3612,8 +3854,10 @@ bool WriteWLN(std::string &buffer, OBMol* mol, bool modern)
       OBAtom *satom = &(*a); 
       if(!obabel.atoms_seen[satom] && (satom->GetExplicitDegree()==1 || satom->GetExplicitDegree() == 0) ){
         buffer += " &"; // ionic species
-        if(!obabel.ParseNonCyclic(mol_copy,satom,0,0,0,0,0,buffer))
-          Fatal("failed on recursive branch parse");
+        if(!obabel.ParseNonCyclic(mol_copy,satom,0,0,0,0,0,buffer)){
+          Fatal(WLN_WRITE_STAGE_CHAIN,WLN_WRITE_BRANCH,"failed on recursive branch parse");
+          return WriteFailed(error);
+        }
       }
     }
   }
@@ -3622,12 +3866,39 @@ bool WriteWLN(std::string &buffer, OBMol* mol, bool modern)
   obabel.AddPostCharges(mol_copy,buffer); // add in charges where we can 
 #endif 
 
-  while(buffer.back() == '&')
+  // failures inside helpers that cannot return one
+  if(write_error.code != WLN_WRITE_NONE)
+    return WriteFailed(error);
+
+  while(!buffer.empty() && buffer.back() == '&')
     buffer.pop_back(); 
 
-  delete mol_copy; 
+  out += buffer;
+  if(error)
+    *error = write_error;
   return true; 
 }
 
 
 
+
+
+/* seeds tried, atoms placed on a path, full locant paths scored and partial paths 
+ * cut by the fusion sum bound in PathFinderIIIb, summed over every thread */
+void WLNPathSearchStats(unsigned long *seeds, unsigned long *steps, unsigned long *scored, unsigned long *pruned)
+{
+  if(seeds)
+    *seeds = path_seeds;
+  if(steps)
+    *steps = path_steps;
+  if(scored)
+    *scored = path_scored;
+  if(pruned)
+    *pruned = path_pruned;
+}
+
+// the bound is exact, turning it off only exists to measure it
+void WLNPathBound(bool on)
+{
+  path_bound = on;
+}
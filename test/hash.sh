@@ -0,0 +1,103 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+DATA="${SCRIPT_DIR}/../data/unit_test"
+KNOWN="${DATA}/hash_known.txt"
+UPDATE=0
+
+# distinct hashes and -owln forms over the regression sets, and the distinct pairs of the two
+HASHES=21021
+FORMS=21035
+PAIRS=21036
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: hash.sh <options>"
+        echo "checks readwln -ohash over the regression sets, each string must hash the"
+        echo "same as its -owln form unless it is in data/unit_test/hash_known.txt, and the"
+        echo "number of distinct hashes and forms must match the pinned counts. when the"
+        echo "build has a real inchi, every 10th hash is also checked with --check and no"
+        echo "collisions are allowed"
+        echo "options"
+        echo "  -u, --update        rewrite the known list from this run"
+        exit 0;
+        ;;
+      -u|--update)
+        UPDATE=1
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+main(){
+  local failed=0
+  local input=$(mktemp)
+  local canonical=$(mktemp)
+  local hashes=$(mktemp)
+  local rehashed=$(mktemp)
+  local found=$(mktemp)
+
+  cat $DATA/smith.tsv $DATA/pubchem.tsv $DATA/chembl24.tsv $DATA/chemspider.tsv | cut -f1 > $input
+  $READ -owln -f $input 2> /dev/null > $canonical
+  $READ -ohash -f $input 2> /dev/null > $hashes
+  $READ -ohash -f $canonical 2> /dev/null > $rehashed
+  paste $hashes $rehashed $input | awk -F'\t' '$1 != "*error*" && $1 != $2 {print $3}' | sort -u > $found
+
+  local total=$(wc -l < $input)
+  local differ=$(wc -l < $found)
+  if [ $UPDATE -eq 1 ]; then
+    mv $found $KNOWN
+    echo "$differ of $total strings hash differently to their -owln form, written to $KNOWN"
+    rm -f $input $canonical $hashes $rehashed
+    exit 0
+  fi
+
+  local added=$(comm -23 $found $KNOWN)
+  local removed=$(comm -13 $found $KNOWN)
+  echo "$total strings, $differ hash differently to their -owln form"
+  if [ -n "$added" ]; then
+    echo "new differences:"
+    echo "$added"
+    failed=1
+  fi
+  if [ -n "$removed" ]; then
+    echo "known differences that now agree, update with -u:"
+    echo "$removed"
+    failed=1
+  fi
+
+  local counts=$(paste $hashes $canonical | awk -F'\t' '$1 != "*error*" && $2 != "*error*" {
+    if(!h[$1]++) nh++; if(!f[$2]++) nf++; if(!p[$1"\t"$2]++) np++ } END{print nh+0, nf+0, np+0}')
+  echo "distinct hashes, forms and pairs: expected $HASHES $FORMS $PAIRS, found $counts"
+  if [ "$counts" != "$HASHES $FORMS $PAIRS" ]; then
+    failed=1
+  fi
+
+  # babels inchikey is the reference, skipped on builds without a real inchi
+  if $READ -okey 'Q2' 2> /dev/null | grep -qE '^[A-Z]{14}-[A-Z]{10}-[A-Z]$'; then
+    $READ -ohash --check 10 -f $input 2> $found > /dev/null
+    grep "hash check:" $found
+    local collisions=$(grep "hash check:" $found | awk '{print $7}')
+    if [ "${collisions:-1}" -ne 0 ]; then
+      failed=1
+    fi
+  else
+    echo "no inchikey in this build, --check skipped"
+  fi
+
+  rm -f $input $canonical $hashes $rehashed $found
+  if [ $failed -ne 0 ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
@@ -0,0 +1,73 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+COMP="${SCRIPT_DIR}/../build/obcomp"
+DATA="${SCRIPT_DIR}/../data/unit_test"
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: native.sh"
+        echo "checks readwln -osmi --native against -osmi over the regression sets, the"
+        echo "same strings must fail, every other line must be the same molecule by obcomp,"
+        echo "and -j 4 must write the same lines as a single thread"
+        exit 0;
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+main(){
+  local failed=0
+  local input=$(mktemp)
+  local babel=$(mktemp)
+  local native=$(mktemp)
+  local threaded=$(mktemp)
+
+  cat $DATA/smith.tsv $DATA/pubchem.tsv $DATA/chembl24.tsv $DATA/chemspider.tsv | cut -f1 > $input
+  $READ -osmi -f $input 2> /dev/null > $babel
+  $READ -osmi --native -f $input 2> /dev/null > $native
+  $READ -osmi --native -j 4 -f $input 2> /dev/null > $threaded
+
+  local total=$(wc -l < $input)
+  local failures=$(paste $babel $native | awk -F'\t' '($1 == "*error*") != ($2 == "*error*"){n++} END{print n+0}')
+  local split=$(diff $native $threaded | grep -c '^[<>]')
+  echo "$total strings, $failures fail on only one path, $split lines differ when threaded"
+  if [ $failures -ne 0 ] || [ $split -ne 0 ]; then
+    paste $input $babel $native | awk -F'\t' '($2 == "*error*") != ($3 == "*error*") {print "  "$1": "$2" -> "$3}'
+    failed=1
+  fi
+
+  local compared=0
+  local differ=0
+  while IFS=$'\t' read -r wln smiles kekule; do
+    if [ "$smiles" == "*error*" ] || [ "$kekule" == "*error*" ]; then
+      continue
+    fi
+    ((compared++))
+    if [ "$smiles" != "$kekule" ] && [ "$($COMP "$kekule" "$smiles" 2> /dev/null)" != "1" ]; then
+      echo "  $wln: $smiles -> $kekule"
+      ((differ++))
+    fi
+  done < <(paste $input $babel $native)
+
+  echo "$compared molecules compared, $differ differ"
+  if [ $differ -ne 0 ]; then
+    failed=1
+  fi
+
+  rm -f $input $babel $native $threaded
+  if [ $failed -ne 0 ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
@@ -0,0 +1,127 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+WRITE="${SCRIPT_DIR}/../build/writewln"
+COMP="${SCRIPT_DIR}/../build/obcomp"
+PREVIOUS=""
+FILE=""
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: paths.sh <options>"
+        echo "writes each multicyclic case with and without the locant path bound and"
+        echo "compares the search, the notation should never change. each notation is"
+        echo "read back with readwln and compared to the input molecule"
+        echo "options"
+        echo "  -f, --file <file>          use a 'SMILES<TAB>name' file instead of the built in cases"
+        echo "  -p, --previous <writewln>  also compare the notation against another writer build"
+        exit 0;
+        ;;
+      -f|--file)
+        FILE=$2
+        shift
+        ;;
+      -p|--previous)
+        PREVIOUS=$2
+        shift
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+# bridged cages and perifused systems, all go through PathFinderIIIb
+cases(){
+  printf "norbornane\tC1CC2CCC1C2\n"
+  printf "twistane\tC1CC2CC3CC1CC2C3\n"
+  printf "adamantane\tC1C2CC3CC1CC(C2)C3\n"
+  printf "iceane\tC1C2CC3CC1C4CC2CC3C4\n"
+  printf "diamantane\tC1C2CC3C4CC5CC(C4)C3C1C5C2\n"
+  printf "triamantane\tC1C2CC3C4C1C5C6CC7CC(C6)C5C4C(C7)C3C2\n"
+  printf "tetramantane\tC1C2CC3C4C1C5C6CC7C8CC9CC(C8)C7C6C4C(C9)C5C3C2\n"
+  printf "pyrene\tC1=CC2=C3C(=C1)C=CC4=CC=CC(=C43)C=C2\n"
+  printf "perylene\tC1=CC2=C3C(=C1)C4=CC=CC5=C4C(=CC=C5)C3=CC=C2\n"
+  printf "benzopyrene\tC1=CC=C2C(=C1)C=C3C=CC4=C5C3=C2C=CC5=CC=C4\n"
+  printf "anthanthrene\tC1=CC2=C3C(=C1)C4=CC=C5C=CC=C6C5=C4C(=C3C=C6)C=C2\n"
+  printf "dibenzopyrene\tC1=CC=C2C(=C1)C=C3C=CC4=C5C3=C2C6=CC=CC=C6C5=CC=C4\n"
+}
+
+# runs one smiles, prints the walked and scored counts then the wln, which has spaces
+measure(){
+  local log=$(mktemp)
+  local wln=$(echo "$1 x" | $WRITE $2 -ismi -f - 2> $log | cut -f1)
+  local stats=$(grep "locant paths" $log)
+  rm -f $log
+
+  local walked=$(sed -n 's/.* \([0-9]*\) atoms walked.*/\1/p' <<< "$stats")
+  local scored=$(sed -n 's/.* \([0-9]*\) paths scored.*/\1/p' <<< "$stats")
+  echo "${walked:-0} ${scored:-0} $wln"
+}
+
+# 1 when the wln reads back to the smiles
+round_trip(){
+  local smiles=$($READ -ocan "$2" 2> /dev/null)
+  if [ -z "$smiles" ]; then
+    echo 0
+  else
+    $COMP "$1" "$smiles" 2> /dev/null
+  fi
+}
+
+main(){
+  local input
+  if [ -n "$FILE" ]; then
+    input=$(awk -F'\t' '{print $2"\t"$1}' $FILE)
+  else
+    input=$(cases)
+  fi
+
+  local total_on=0
+  local total_off=0
+  local failed=0
+  printf "%-14s %12s %12s %10s %10s %6s %6s %6s\n" "case" "walked" "unbounded" "scored" "unbounded" "same" "trip" "prev"
+  while IFS=$'\t' read name smiles; do
+    read WALK_ON SCORE_ON WLN_ON <<< "$(measure "$smiles" "")"
+    read WALK_OFF SCORE_OFF WLN_OFF <<< "$(measure "$smiles" "--no-bound")"
+    SAME="yes"
+    if [ "$WLN_ON" != "$WLN_OFF" ]; then
+      SAME="NO"
+      ((failed++))
+    fi
+
+    TRIP="yes"
+    if [ "$(round_trip "$smiles" "$WLN_ON")" != "1" ]; then
+      TRIP="NO"
+      ((failed++))
+    fi
+
+    PREV="-"
+    if [ -n "$PREVIOUS" ]; then
+      PREV="yes"
+      if [ "$(echo "$smiles x" | $PREVIOUS -ismi -f - 2> /dev/null | cut -f1)" != "$WLN_ON" ]; then
+        PREV="NO"
+        ((failed++))
+      fi
+    fi
+
+    printf "%-14s %12d %12d %10d %10d %6s %6s %6s\n" $name $WALK_ON $WALK_OFF $SCORE_ON $SCORE_OFF $SAME $TRIP $PREV
+    ((total_on += WALK_ON))
+    ((total_off += WALK_OFF))
+  done <<< "$input"
+
+  awk -v on=$total_on -v off=$total_off 'BEGIN{printf "%d atoms walked against %d unbounded, %.1f%% cut\n", on, off, off ? 100*(off-on)/off : 0}'
+  if [ $failed -ne 0 ]; then
+    echo "$failed checks failed"
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
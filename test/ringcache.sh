@@ -0,0 +1,101 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+DATA="${SCRIPT_DIR}/../data/unit_test"
+RING_CACHE_SIZE=4096
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: ringcache.sh"
+        echo "checks the ring block cache, over the regression sets the output must not"
+        echo "depend on the line order or the thread count. over more distinct ring blocks"
+        echo "than the cache holds, the cache must stay at ${RING_CACHE_SIZE} templates, a second"
+        echo "pass over evicted blocks must match the first, and a sample of lines"
+        echo "converted one per process (cold cache) must match the file run"
+        exit 0;
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+# three ring fused blocks with two nitrogens, 64 shapes x 91 locant pairs
+ring_blocks(){
+  local locants=(A B C D E F G H I J K L M N)
+  for a in 5 6 7 8; do
+    for b in 5 6 7 8; do
+      for c in 5 6 7 8; do
+        for ((i=0;i<${#locants[@]};i++)); do
+          for ((j=i+1;j<${#locants[@]};j++)); do
+            echo "T${a}${b}${c} ${locants[$i]}N ${locants[$j]}NJ"
+          done
+        done
+      done
+    done
+  done
+}
+
+cache_counts(){
+  grep "ring cache:" $1 | awk '{print $3, $7}'
+}
+
+main(){
+  local failed=0
+  local input=$(mktemp)
+  local output=$(mktemp)
+  local reversed=$(mktemp)
+  local threaded=$(mktemp)
+
+  cat $DATA/smith.tsv $DATA/pubchem.tsv $DATA/chembl24.tsv $DATA/chemspider.tsv | cut -f1 > $input
+  $READ -osmi -f $input 2> $output.log > $output
+  tac $input | $READ -osmi - 2> /dev/null | tac > $reversed
+  $READ -osmi -j 4 -f $input 2> /dev/null > $threaded
+
+  local counts=($(cache_counts $output.log))
+  local flipped=$(diff $output $reversed | grep -c '^[<>]')
+  local split=$(diff $output $threaded | grep -c '^[<>]')
+  echo "$(wc -l < $input) strings, ${counts[0]} hits, $flipped lines differ reversed, $split differ threaded"
+  if [ "${counts[0]:-0}" -eq 0 ] || [ $flipped -ne 0 ] || [ $split -ne 0 ]; then
+    failed=1
+  fi
+
+  # twice over, the first blocks are evicted before the second pass reaches them
+  ring_blocks > $input
+  cat $input $input | $READ -osmi - 2> $output.log > $output
+  local total=$(wc -l < $input)
+  counts=($(cache_counts $output.log))
+  local repeated=$(diff <(head -n $total $output) <(tail -n $total $output) | grep -c '^[<>]')
+  tac $input | $READ -osmi - 2> /dev/null | tac > $reversed
+  flipped=$(head -n $total $output | diff - $reversed | grep -c '^[<>]')
+
+  # every 50th block in its own process, so nothing is replayed from the cache
+  local cold=0
+  local sampled=0
+  while IFS=$'\t' read -r wln smiles; do
+    ((sampled++))
+    if [ "$($READ -osmi "$wln" 2> /dev/null)" != "$smiles" ]; then
+      echo "  $wln: $smiles cached, $($READ -osmi "$wln" 2> /dev/null) cold"
+      ((cold++))
+    fi
+  done < <(paste $input <(head -n $total $output) | awk 'NR % 50 == 1')
+
+  echo "$total ring blocks, ${counts[1]} templates kept, $repeated lines differ on the second pass, $flipped differ reversed, $cold of $sampled differ cold"
+  if [ "${counts[1]:-0}" -ne $RING_CACHE_SIZE ] || [ $repeated -ne 0 ] || [ $flipped -ne 0 ] || [ $cold -ne 0 ]; then
+    failed=1
+  fi
+
+  rm -f $input $output $output.log $reversed $threaded
+  if [ $failed -ne 0 ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
@@ -0,0 +1,148 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+WRITE="${SCRIPT_DIR}/../build/writewln"
+MODE="read"
+FAMILY=""
+MAX=100000
+LIMIT=60
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: scaling.sh <options> [family]"
+        echo "families (default all)"
+        echo "  chain               polyether chain, Q2O2O...2Q"
+        echo "  rings               polyphenylene, one ring system per benzene, R DR DR..."
+        echo "  ladder              linear fused ring ladder in one ring system, L666...TJ"
+        echo "  macro               single macrocycle, L-n-TJ"
+        echo "options"
+        echo "  -r, --read          time wln to smiles (default)"
+        echo "  -n, --native        time wln to smiles without babel"
+        echo "  -c, --canonical     time wln canonicalisation"
+        echo "  -w, --write         time smiles to wln, input made by readwln"
+        echo "  -s, --small         stop at 10k atoms"
+        echo "  -t, --timeout <s>   give up on a size after s seconds (default 60)"
+        exit 0;
+        ;;
+      -r|--read)
+        MODE="read"
+        ;;
+      -n|--native)
+        MODE="native"
+        ;;
+      -c|--canonical)
+        MODE="canonical"
+        ;;
+      -w|--write)
+        MODE="write"
+        ;;
+      -s|--small)
+        MAX=10000
+        ;;
+      -t|--timeout)
+        LIMIT=$2
+        shift
+        ;;
+      *)
+        FAMILY=$arg
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+# repeats a unit n times
+repeat(){
+  local out=""
+  for ((r=0;r<$2;r++)); do out+="$1"; done
+  echo -n "$out"
+}
+
+# writes the wln for roughly n atoms of a family, the ring system families are
+# capped where the locants run out
+generate(){
+  case "$1" in
+    chain)
+      echo -n "Q$(repeat 2O $(( ($2-2)/3 )))2Q"
+      ;;
+    rings)
+      echo -n "R$(repeat " DR" $(( $2/6 - 1 )))"
+      ;;
+    ladder)
+      local k=$(( ($2-2)/4 ))
+      if [ $k -lt 1 ] || [ $k -gt 10 ]; then return 1; fi
+      echo -n "L$(repeat 6 $k)TJ"
+      ;;
+    macro)
+      if [ $2 -lt 3 ] || [ $2 -gt 60 ]; then return 1; fi
+      echo -n "L-$2-TJ"
+      ;;
+  esac
+}
+
+# runs one conversion, prints seconds and peak kb when gnu time is about,
+# the seconds are replaced by timeout or failed when the run does not finish
+measure(){
+  local input="$1"
+  local cmd
+  case "$MODE" in
+    read)      cmd=("$READ" -osmi "$input") ;;
+    native)    cmd=("$READ" -osmi --native "$input") ;;
+    canonical) cmd=("$READ" -owln "$input") ;;
+    write)
+      input=$($READ -osmi --native "$input" 2> /dev/null)
+      cmd=("$WRITE" -ismi "$input")
+      ;;
+  esac
+
+  local log=$(mktemp)
+  local start=$(date +%s.%N)
+  if [ -x /usr/bin/time ]; then
+    timeout $LIMIT /usr/bin/time -o $log -f "%M" "${cmd[@]}" > /dev/null 2>&1
+  else
+    timeout $LIMIT "${cmd[@]}" > /dev/null 2>&1
+  fi
+  local status=$?
+  local end=$(date +%s.%N)
+  local kb=$(tail -n1 $log 2> /dev/null)
+  rm -f $log
+
+  if [ $status -eq 124 ]; then
+    echo "timeout -"
+  elif [ $status -ne 0 ]; then
+    echo "failed -"
+  else
+    awk -v s=$start -v e=$end -v k="${kb:--}" 'BEGIN{printf "%.3f %s\n", e-s, k}'
+  fi
+}
+
+main(){
+  local families="chain rings ladder macro"
+  if [ -n "$FAMILY" ]; then
+    families=$FAMILY
+  fi
+
+  printf "%-8s %10s %10s %10s %12s\n" "family" "atoms" "seconds" "peak kb" "us/atom"
+  for f in $families; do
+    for n in 10 30 60 100 300 1000 3000 10000 30000 100000; do
+      if [ $n -gt $MAX ]; then break; fi
+      WLN=$(generate $f $n) || continue
+      read SECS KB <<< "$(measure "$WLN")"
+      if [ "$SECS" = "timeout" ] || [ "$SECS" = "failed" ]; then
+        printf "%-8s %10d %10s %10s %12s\n" $f $n $SECS $KB "-"
+        break # larger sizes will not do better
+      fi
+      awk -v f=$f -v n=$n -v s=$SECS -v k=$KB 'BEGIN{printf "%-8s %10d %10s %10s %12.2f\n", f, n, s, k, s*1e6/n}'
+    done
+  done
+}
+
+process_arguments "$@"
+main
+exit 0
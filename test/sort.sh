@@ -0,0 +1,86 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+SORT="${SCRIPT_DIR}/../build/wlnsort"
+DATA="${SCRIPT_DIR}/../data/unit_test"
+SORT_FAN_IN=256
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: sort.sh"
+        echo "checks wlnsort over the regression sets with a blank and an over-long line"
+        echo "added, the unique list must hold each readwln -owln form with the first line"
+        echo "it was seen on, the duplicate map must hold every other line once with the"
+        echo "failures in its *error* section, and a run small enough to spill more than"
+        echo "${SORT_FAN_IN} runs must merge in extra passes to the same output"
+        exit 0;
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+main(){
+  local failed=0
+  local input=$(mktemp)
+  local canonical=$(mktemp)
+  local expected=$(mktemp)
+  local unique=$(mktemp)
+  local dups=$(mktemp)
+  local spilled=$(mktemp)
+
+  # one blank and one over-long line in the middle, both must land in the *error* section
+  cat $DATA/smith.tsv $DATA/pubchem.tsv $DATA/chembl24.tsv $DATA/chemspider.tsv | cut -f1 > $expected
+  { head -n 100 $expected; echo; head -c 5000 /dev/zero | tr '\0' 'C'; echo; tail -n +101 $expected; } > $input
+  local total=$(wc -l < $input)
+
+  $READ -owln -f $input 2> /dev/null > $canonical
+  $SORT -d $dups -f $input 2> /dev/null > $unique
+
+  # first line number of each form, in the byte order wlnsort merges in
+  awk '$0 != "*error*" && !seen[$0]++ {print $0"\t"NR}' $canonical | LC_ALL=C sort > $expected
+  local differ=$(LC_ALL=C sort $unique | diff $expected - | grep -c '^[<>]')
+  echo "$(wc -l < $unique) unique forms, $differ lines differ from readwln -owln"
+  if [ $differ -ne 0 ]; then
+    failed=1
+  fi
+
+  # duplicates point at the first line of their form, then the failures follow
+  awk -F'\t' 'NR == FNR {first[$1] = $2; next} $0 != "*error*" && first[$0] != FNR {print FNR"\t"first[$0]}' \
+    $unique $canonical | LC_ALL=C sort > $expected
+  local mapped=$(grep -v '\*error\*$' $dups | LC_ALL=C sort | diff $expected - | grep -c '^[<>]')
+  awk '$0 == "*error*" {print NR"\t*error*"}' $canonical > $expected
+  local errors=$(grep '\*error\*$' $dups | diff $expected - | grep -c '^[<>]')
+  local ordered=$(awk -F'\t' '$2 == "*error*" {e = 1} e && $2 != "*error*" {n++} END{print n+0}' $dups)
+  local covered=$({ cut -f2 $unique; cut -f1 $dups; } | sort -n | uniq | awk 'NR == $1 {n++} END{print n+0}')
+  local listed=$(( $(wc -l < $unique) + $(wc -l < $dups) ))
+  echo "$total lines, $covered of $listed ids cover them once, $mapped duplicates and $errors failures differ, $ordered duplicates after the *error* section"
+  if [ $mapped -ne 0 ] || [ $errors -ne 0 ] || [ $ordered -ne 0 ] || [ $covered -ne $total ] || [ $listed -ne $total ]; then
+    failed=1
+  fi
+
+  # a few dozen records a run, enough runs that the merge has to fold them more than once
+  $SORT -m 4k -d $spilled.dups -f $input 2> $spilled.log > $spilled
+  local runs=$(grep "canonicalise:" $spilled.log | awk '{print $6}')
+  local passes=$(grep "merge:" $spilled.log | awk '{print $2}')
+  local changed=$(( $(diff $unique $spilled | grep -c '^[<>]') + $(diff $dups $spilled.dups | grep -c '^[<>]') ))
+  echo "-m 4k: $runs runs, $passes merge passes, $changed lines changed"
+  if [ "${runs:-0}" -le $SORT_FAN_IN ] || [ "${passes:-0}" -le 1 ] || [ $changed -ne 0 ]; then
+    failed=1
+  fi
+
+  rm -f $input $canonical $expected $unique $dups $spilled $spilled.dups $spilled.log
+  if [ $failed -ne 0 ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
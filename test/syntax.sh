@@ -0,0 +1,80 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+DATA="${SCRIPT_DIR}/../data/unit_test"
+KNOWN="${DATA}/syntax_known.txt"
+UPDATE=0
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: syntax.sh <options>"
+        echo "validates the regression sets with the parser alone and with the baked wlngrep"
+        echo "machine in front (--syntax), any string the two disagree on that is not in"
+        echo "data/unit_test/syntax_known.txt means the machine and the reader have drifted"
+        echo "options"
+        echo "  -u, --update        rewrite the known list from this run"
+        exit 0;
+        ;;
+      -u|--update)
+        UPDATE=1
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+main(){
+  local input=$(mktemp)
+  local parser=$(mktemp)
+  local machine=$(mktemp)
+  local found=$(mktemp)
+
+  cat $DATA/smith.tsv $DATA/pubchem.tsv $DATA/chembl24.tsv $DATA/chemspider.tsv | cut -f1 > $input
+  if ! $READ --syntax -ovalid 'L6J' > /dev/null 2>&1; then
+    echo "Error: $READ was built without the dfa table"
+    rm -f $input $parser $machine $found
+    exit 1
+  fi
+
+  $READ -ovalid -f $input 2> /dev/null | cut -f1 > $parser
+  $READ -ovalid --syntax -f $input 2> /dev/null | cut -f1 > $machine
+  paste $parser $machine $input | awk -F'\t' '$1 != $2 {print $3}' | sort -u > $found
+
+  local total=$(wc -l < $input)
+  local differ=$(wc -l < $found)
+  rm -f $input $parser $machine
+
+  if [ $UPDATE -eq 1 ]; then
+    mv $found $KNOWN
+    echo "$differ of $total strings disagree, written to $KNOWN"
+    exit 0
+  fi
+
+  local added=$(comm -23 $found $KNOWN)
+  local removed=$(comm -13 $found $KNOWN)
+  rm -f $found
+
+  echo "$total strings, $differ disagree between the parser and the syntax machine"
+  if [ -n "$added" ]; then
+    echo "new disagreements:"
+    echo "$added"
+  fi
+  if [ -n "$removed" ]; then
+    echo "known disagreements that now agree, update with -u:"
+    echo "$removed"
+  fi
+
+  if [ -n "$added" ] || [ -n "$removed" ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
@@ -0,0 +1,74 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+WRITE="${SCRIPT_DIR}/../build/writewln"
+MODE="write"
+THREADS=4
+FILE=""
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: threads.sh <options> <file>"
+        echo "converts the file serially and with -j, the output should never change"
+        echo "options"
+        echo "  -r, --read          read a file of wln, one per line"
+        echo "  -w, --write         write a 'SMILES<TAB>id' file (default)"
+        echo "  -j <n>              worker threads to compare against (default 4)"
+        exit 0;
+        ;;
+      -r|--read)
+        MODE="read"
+        ;;
+      -w|--write)
+        MODE="write"
+        ;;
+      -j)
+        THREADS=$2
+        shift
+        ;;
+      *)
+        FILE=$arg
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+
+  if [ -z "$FILE" ]; then
+    echo "Error: no input file given"
+    exit 1
+  fi
+}
+
+convert(){
+  if [ $MODE == "read" ]; then
+    $READ -osmi $1 -f $FILE 2> /dev/null
+  else
+    $WRITE -ismi $1 -f $FILE 2> /dev/null
+  fi
+}
+
+main(){
+  local serial=$(mktemp)
+  local threaded=$(mktemp)
+  convert "" > $serial
+  convert "-j $THREADS" > $threaded
+
+  local total=$(wc -l < $serial)
+  local differ=$(diff $serial $threaded | grep -c '^>')
+  rm -f $serial $threaded
+
+  echo "$total records, $differ differ between serial and -j $THREADS"
+  if [ $differ -ne 0 ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
@@ -0,0 +1,97 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+DATA="${SCRIPT_DIR}/../data/unit_test"
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: unique.sh"
+        echo "checks readwln -owln --unique, each group of spellings below must collapse to"
+        echo "its first line, and over the regression sets the filter must keep exactly the"
+        echo "first line of each -owln form and every *error* line, with the same output and"
+        echo "counts when threaded"
+        exit 0;
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+# spellings of the same molecule, then the line --unique keeps for each, duplicates keep nothing
+cases(){
+  printf "Q2\tQ2\n"
+  printf "2Q\t\n"
+  printf "1R\t1R\n"
+  printf "R1\t\n"
+  printf "QVR\tQVR\n"
+  printf "RVQ\t\n"
+  printf "ZR DQ\tZR DQ\n"
+  printf "QR DZ\t\n"
+  printf "L6\t*error*\n"
+  printf "L6\t*error*\n"
+  printf "ZV1\tZV1\n"
+  printf "1VZ\t\n"
+  printf "NCR\tNCR\n"
+  printf "RCN\t\n"
+}
+
+# first line of each canonical form, failures always kept
+first_forms(){
+  awk '$0 == "*error*" || !seen[$0]++' $1
+}
+
+# forms and duplicates as --unique should report them
+form_counts(){
+  awk '$0 != "*error*" {n++; if(!seen[$0]++) f++} END{print f+0, n-f}' $1
+}
+
+main(){
+  local failed=0
+  local input=$(mktemp)
+  local expected=$(mktemp)
+  local canonical=$(mktemp)
+  local unique=$(mktemp)
+  local threaded=$(mktemp)
+
+  cases | cut -f1 > $input
+  cases | cut -f2 | grep -v '^$' > $expected
+  $READ -owln --unique -f $input 2> /dev/null > $unique
+  local changed=$(diff $expected $unique | grep -c '^[<>]')
+  echo "$(wc -l < $input) pinned spellings, $changed lines changed"
+  if [ $changed -ne 0 ]; then
+    diff $expected $unique
+    failed=1
+  fi
+
+  cat $DATA/smith.tsv $DATA/pubchem.tsv $DATA/chembl24.tsv $DATA/chemspider.tsv | cut -f1 > $input
+  $READ -owln -f $input 2> /dev/null > $canonical
+  first_forms $canonical > $expected
+  $READ -owln --unique -f $input 2> $unique.log > $unique
+  $READ -owln --unique -j 4 -f $input 2> $threaded.log > $threaded
+
+  local differ=$(diff $expected $unique | grep -c '^[<>]')
+  local split=$(diff $unique $threaded | grep -c '^[<>]')
+  local counts=$(form_counts $canonical)
+  local reported=$(grep "unique:" $unique.log | awk '{print $2, $5}')
+  local reported_threaded=$(grep "unique:" $threaded.log | awk '{print $2, $5}')
+  echo "$(wc -l < $input) strings, $(wc -l < $unique) kept, $differ lines differ from the first -owln forms, $split differ when threaded"
+  echo "forms and duplicates: expected $counts, reported $reported, threaded $reported_threaded"
+  if [ $differ -ne 0 ] || [ $split -ne 0 ] || [ "$counts" != "$reported" ] || [ "$counts" != "$reported_threaded" ]; then
+    failed=1
+  fi
+
+  rm -f $input $expected $canonical $unique $unique.log $threaded $threaded.log
+  if [ $failed -ne 0 ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0
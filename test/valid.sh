@@ -0,0 +1,81 @@
+#!/bin/bash
+
+SCRIPT_DIR=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd )
+READ="${SCRIPT_DIR}/../build/readwln"
+DATA="${SCRIPT_DIR}/../data/unit_test"
+
+process_arguments() {
+  # Loop through all the arguments
+  while [ $# -gt 0 ]; do
+    arg=$1
+    case "$arg" in
+      -h|--help)
+        # Display a help message
+        echo "Usage: valid.sh"
+        echo "checks readwln -ovalid, each case below must give its pinned verdict,"
+        echo "stage and offset, and over the regression sets a string must be valid"
+        echo "exactly when the full -osmi conversion writes it"
+        exit 0;
+        ;;
+    esac
+    shift # Shift to the next argument
+  done
+}
+
+# wln, then the first three -ovalid columns (verdict, stage, offset)
+cases(){
+  printf "L6J\tvalid\n"
+  printf "T56 BMJ\tvalid\n"
+  printf "QVR\tvalid\n"
+  printf "L66J BXX\tvalid\n"
+  printf "T6NJ B- AL6J\tvalid\n"
+  printf "L6\tinvalid\tparse\t2\n"
+  printf "L6V\tinvalid\tparse\t3\n"
+  printf "L6J A-\tinvalid\tparse\t6\n"
+  printf "T5NJ A-\tinvalid\tparse\t7\n"
+  printf "ZZ1Z\tinvalid\tparse\t3\n"
+  printf "Q1Q1Q1Q1Q\tinvalid\tparse\t4\n"
+  printf "*Q\tinvalid\tparse\t0\n"
+  printf "SUCM\tinvalid\texpand\t4\n"
+  printf "SUCS\tinvalid\texpand\t4\n"
+}
+
+main(){
+  local failed=0
+  local input=$(mktemp)
+  local expected=$(mktemp)
+  local valid=$(mktemp)
+  local smiles=$(mktemp)
+
+  cases | cut -f1 > $input
+  cases | cut -f2- > $expected
+  $READ -ovalid -f $input 2> /dev/null | cut -f1-3 > $valid
+  local changed=$(diff $expected $valid | grep -c '^>')
+  echo "$(wc -l < $input) pinned cases, $changed changed"
+  if [ $changed -ne 0 ]; then
+    paste -d'|' $input $expected $valid | awk -F'|' '$2 != $3 {print "  "$1": "$2" -> "$3}'
+    failed=1
+  fi
+
+  cat $DATA/smith.tsv $DATA/pubchem.tsv $DATA/chembl24.tsv $DATA/chemspider.tsv | cut -f1 > $input
+  $READ -ovalid -f $input 2> $smiles.log | cut -f1 > $valid
+  $READ -osmi -f $input 2> /dev/null > $smiles
+
+  local total=$(wc -l < $input)
+  local invalid=$(grep -vc '^valid$' $valid)
+  local differ=$(paste $valid $smiles | awk -F'\t' '($1 == "valid") != ($2 != "*error*"){n++} END{print n+0}')
+  local counted=$(grep "lines parsed" $smiles.log | awk '{print $4}')
+  echo "$total strings, $invalid invalid, $differ disagree with -osmi, $counted counted as failed"
+  if [ $differ -ne 0 ] || [ "$counted" != "$invalid" ]; then
+    failed=1
+  fi
+
+  rm -f $input $expected $valid $smiles $smiles.log
+  if [ $failed -ne 0 ]; then
+    exit 1
+  fi
+}
+
+process_arguments "$@"
+main
+exit 0